@@ -0,0 +1,137 @@
+#pragma once
+#include "BandPassFilters.h"
+#include <stddef.h>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*******************************************************************
+Runs several BandPassFilter channels over the same input signal.
+Coefficients and state are stored as struct-of-arrays, one row per
+section with the channels side by side, so one AVX2 instruction
+advances four channels at once. Channels with a lower order than the
+largest are padded with pass-through sections. Each channel produces
+exactly the same values as a standalone BandPassFilter.
+*******************************************************************/
+class BandPassFilterBank
+{
+public:
+    BandPassFilterBank() : _channels(0), _sections(0), _groups(0) {}
+
+    // Designs a channel with BandPassFilter( fc, bw, order ) and returns its
+    // index. Resets the state of all channels.
+    int add_channel( double fc, double bw, int order ) {
+        BandPassFilter bp( fc, bw, order );
+        _design.push_back( bp.sections() );
+        build();
+        return _channels-1;
+    }
+
+    // Advances every channel by one sample
+    void add( double sig ) {
+#ifdef __AVX2__
+        __m256d xs = _mm256_set1_pd( sig );
+        for ( size_t g=0; g<_groups; ++g ) {
+            __m256d xin = xs;
+            for ( size_t s=0; s<_sections; ++s ) {
+                size_t k = (s*_groups + g)*4;
+                __m256d x1 = _mm256_loadu_pd( &_x1[k] );
+                __m256d x2 = _mm256_loadu_pd( &_x2[k] );
+                __m256d y1 = _mm256_loadu_pd( &_y1[k] );
+                __m256d y2 = _mm256_loadu_pd( &_y2[k] );
+                __m256d y0 = _mm256_add_pd(
+                    _mm256_add_pd(
+                        _mm256_add_pd( _mm256_mul_pd( x2, _mm256_loadu_pd( &_b2[k] ) ),
+                                       _mm256_mul_pd( xin, _mm256_loadu_pd( &_b0[k] ) ) ),
+                        _mm256_mul_pd( y2, _mm256_loadu_pd( &_a2[k] ) ) ),
+                    _mm256_mul_pd( y1, _mm256_loadu_pd( &_a1[k] ) ) );
+                _mm256_storeu_pd( &_x2[k], x1 );
+                _mm256_storeu_pd( &_x1[k], xin );
+                _mm256_storeu_pd( &_y2[k], y1 );
+                _mm256_storeu_pd( &_y1[k], y0 );
+                xin = y0;
+            }
+        }
+#else
+        for ( size_t g=0; g<_groups; ++g ) {
+            double xin[4] = { sig, sig, sig, sig };
+            for ( size_t s=0; s<_sections; ++s ) {
+                size_t k = (s*_groups + g)*4;
+                for ( size_t l=0; l<4; ++l, ++k ) {
+                    double y0 = (_x2[k] * _b2[k]) + (xin[l] * _b0[k]) + (_y2[k] * _a2[k]) + (_y1[k] * _a1[k]);
+                    _x2[k] = _x1[k];
+                    _x1[k] = xin[l];
+                    _y2[k] = _y1[k];
+                    _y1[k] = y0;
+                    xin[l] = y0;
+                }
+            }
+        }
+#endif
+    }
+
+    // Output of channel c after the last add()
+    double value( int c ) const {
+        if ( _sections==0 ) return 0;
+        return _y1[((_sections-1)*_groups + c/4)*4 + c%4];
+    }
+
+    // Filters n samples; out receives n rows of channels() values
+    void process( const double* in, double* out, size_t n ) {
+        for ( size_t j=0; j<n; ++j ) {
+            add( in[j] );
+            for ( int c=0; c<_channels; ++c ) *out++ = value( c );
+        }
+    }
+
+    void reset() {
+        for ( size_t k=0; k<_x1.size(); ++k ) {
+            _x1[k] = _x2[k] = _y1[k] = _y2[k] = 0;
+        }
+    }
+
+    int channels() const {
+        return _channels;
+    }
+
+private:
+    typedef std::vector<BandPassFilter::SOSBandPass> Sections;
+
+    void build() {
+        _channels = _design.size();
+        _sections = 0;
+        for ( const Sections& d : _design ) {
+            if ( d.size()>_sections ) _sections = d.size();
+        }
+        _groups = (_channels+3)/4;
+        size_t total = _sections*_groups*4;
+        // Pass-through section: y = x
+        _b0.assign( total, 1.0 );
+        _b2.assign( total, 0.0 );
+        _a1.assign( total, 0.0 );
+        _a2.assign( total, 0.0 );
+        _x1.assign( total, 0.0 );
+        _x2.assign( total, 0.0 );
+        _y1.assign( total, 0.0 );
+        _y2.assign( total, 0.0 );
+        for ( int c=0; c<_channels; ++c ) {
+            const Sections& d( _design[c] );
+            for ( size_t s=0; s<d.size(); ++s ) {
+                size_t k = (s*_groups + c/4)*4 + c%4;
+                _b0[k] = d[s].b[0];
+                _b2[k] = d[s].b[2];
+                _a1[k] = d[s].a[1];
+                _a2[k] = d[s].a[2];
+            }
+        }
+    }
+
+    int _channels;
+    size_t _sections;
+    size_t _groups;
+    std::vector< Sections > _design;
+    // Index: (section*groups + channel/4)*4 + channel%4
+    std::vector<double> _b0, _b2, _a1, _a2;
+    std::vector<double> _x1, _x2, _y1, _y2;
+};
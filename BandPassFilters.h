@@ -1,8 +1,189 @@
 #pragma once
 #include <math.h>
+#include <stddef.h>
+#include <array>
 #include <vector>
+#include "ConstMath.h"
+#include "Profiler.h"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
-struct BandPassFilter
+// Q of the pole pairs of the Butterworth prototypes of order 2..16, one
+// row per order, shared by the band pass filters below
+constexpr double BUTTERWORTH_Q[8][8] = {
+    {0.71, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00},
+    {0.54, 1.31, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00},
+    {0.52, 0.71, 1.93, 0.00, 0.00, 0.00, 0.00, 0.00},
+    {0.51, 0.60, 0.90, 2.56, 0.00, 0.00, 0.00, 0.00},
+    {0.51, 0.56, 0.71, 1.10, 3.20, 0.00, 0.00, 0.00},
+    {0.50, 0.54, 0.63, 0.82, 1.31, 3.83, 0.00, 0.00},
+    {0.50, 0.53, 0.59, 0.71, 0.94, 1.51, 4.47, 0.00},
+    {0.50, 0.52, 0.57, 0.65, 0.79, 1.06, 1.72, 5.10} };
+
+/*******************************************************************
+The block kernel shared by the band pass filters: a cascade of second
+order sections held in rows of per section state, one lane per section.
+The rows are padded to a whole number of 32 byte registers, 4 lanes of
+double or 8 of float. Padding lanes have zero coefficients and stay at
+zero.
+*******************************************************************/
+template< typename T >
+struct SOSWavefront
+{
+    enum { B0, B2, A1, A2, X1, X2, Y1, Y2, NROWS };
+    enum { LANES = 32/sizeof(T) };
+
+    // Runs the N sections as a wavefront. On step t section k filters sample
+    // t-2k, taking as input what section k-1 produced two steps earlier (its
+    // y2). The N updates of a step are independent of each other and run
+    // side by side, and the two step lag keeps the hand-over between sections
+    // off the critical path. Each section evaluates the same expression as
+    // SOSBandPass::add() in the same order, hence the results are identical.
+    template< int N, int NP >
+    static void run( T (&s)[NROWS][NP], const T* in, T* out, size_t n ) {
+        const size_t LAG = 2*(N-1);
+        size_t steps = n + LAG;
+        size_t t = 0;
+        for ( ; (t<LAG) && (t<steps); ++t ) edge<N,NP>( s, in, out, n, t );
+        if ( t<n ) {
+            steady<N,NP>( s, in+t, out+t-LAG, n-t );
+            t = n;
+        }
+        for ( ; t<steps; ++t ) edge<N,NP>( s, in, out, n, t );
+    }
+
+private:
+    // Pipeline fill/drain step: only sections lo..hi hold a sample. A section
+    // that was idle on the previous step has its last output in y1, not y2.
+    template< int N, int NP >
+    static void edge( T (&s)[NROWS][NP], const T* in, T* out, size_t n, size_t t ) {
+        const size_t LAG = 2*(N-1);
+        int lo = t>=n ? int((t-n)/2+1) : 0;
+        int hi = t<LAG ? int(t/2) : N-1;
+        for ( int k=hi; k>=lo; --k ) {
+            T xin;
+            if ( k==0 ) xin = in[t];
+            else xin = (t+1-2*k < n) ? s[Y2][k-1] : s[Y1][k-1];
+            T y0 = (s[X2][k] * s[B2][k]) + (xin * s[B0][k]) + (s[Y2][k] * s[A2][k]) + (s[Y1][k] * s[A1][k]);
+            s[X2][k] = s[X1][k];
+            s[X1][k] = xin;
+            s[Y2][k] = s[Y1][k];
+            s[Y1][k] = y0;
+        }
+        if ( (t>=LAG) && (t-LAG<n) ) out[t-LAG] = s[Y1][N-1];
+    }
+
+#ifdef __AVX2__
+    // Steady state, every section busy, four sections per register of double
+    template< int N, int NP >
+    static void steady( double (&s)[NROWS][NP], const double* in, double* out, size_t n ) {
+        enum { V = NP/4 };
+        __m256d b0[V], b2[V], a1[V], a2[V], x1[V], x2[V], y1[V], y2[V];
+        for ( int v=0; v<V; ++v ) {
+            b0[v] = _mm256_load_pd( &s[B0][4*v] ); b2[v] = _mm256_load_pd( &s[B2][4*v] );
+            a1[v] = _mm256_load_pd( &s[A1][4*v] ); a2[v] = _mm256_load_pd( &s[A2][4*v] );
+            x1[v] = _mm256_load_pd( &s[X1][4*v] ); x2[v] = _mm256_load_pd( &s[X2][4*v] );
+            y1[v] = _mm256_load_pd( &s[Y1][4*v] ); y2[v] = _mm256_load_pd( &s[Y2][4*v] );
+        }
+        for ( size_t t=0; t<n; ++t ) {
+            // Shift y2 up one section, feeding the new sample into section 0
+            __m256d xin[V];
+            __m256d carry = _mm256_broadcast_sd( &in[t] );
+            for ( int v=0; v<V; ++v ) {
+                __m256d r = _mm256_permute4x64_pd( y2[v], _MM_SHUFFLE(2,1,0,3) );
+                xin[v] = _mm256_blend_pd( r, carry, 1 );
+                carry = r;
+            }
+            for ( int v=0; v<V; ++v ) {
+                __m256d y0 = _mm256_add_pd(
+                    _mm256_add_pd(
+                        _mm256_add_pd( _mm256_mul_pd( x2[v], b2[v] ), _mm256_mul_pd( xin[v], b0[v] ) ),
+                        _mm256_mul_pd( y2[v], a2[v] ) ),
+                    _mm256_mul_pd( y1[v], a1[v] ) );
+                x2[v] = x1[v];
+                x1[v] = xin[v];
+                y2[v] = y1[v];
+                y1[v] = y0;
+            }
+            _mm_store_sd( &out[t], _mm256_castpd256_pd128(
+                _mm256_permute4x64_pd( y1[(N-1)/4], (N-1)%4 ) ) );
+        }
+        for ( int v=0; v<V; ++v ) {
+            _mm256_store_pd( &s[X1][4*v], x1[v] ); _mm256_store_pd( &s[X2][4*v], x2[v] );
+            _mm256_store_pd( &s[Y1][4*v], y1[v] ); _mm256_store_pd( &s[Y2][4*v], y2[v] );
+        }
+    }
+
+    // Steady state for float, eight sections per register
+    template< int N, int NP >
+    static void steady( float (&s)[NROWS][NP], const float* in, float* out, size_t n ) {
+        enum { V = NP/8 };
+        __m256 b0[V], b2[V], a1[V], a2[V], x1[V], x2[V], y1[V], y2[V];
+        for ( int v=0; v<V; ++v ) {
+            b0[v] = _mm256_load_ps( &s[B0][8*v] ); b2[v] = _mm256_load_ps( &s[B2][8*v] );
+            a1[v] = _mm256_load_ps( &s[A1][8*v] ); a2[v] = _mm256_load_ps( &s[A2][8*v] );
+            x1[v] = _mm256_load_ps( &s[X1][8*v] ); x2[v] = _mm256_load_ps( &s[X2][8*v] );
+            y1[v] = _mm256_load_ps( &s[Y1][8*v] ); y2[v] = _mm256_load_ps( &s[Y2][8*v] );
+        }
+        const __m256i up = _mm256_setr_epi32( 7, 0, 1, 2, 3, 4, 5, 6 );
+        const __m256i last = _mm256_set1_epi32( (N-1)%8 );
+        for ( size_t t=0; t<n; ++t ) {
+            __m256 xin[V];
+            __m256 carry = _mm256_broadcast_ss( &in[t] );
+            for ( int v=0; v<V; ++v ) {
+                __m256 r = _mm256_permutevar8x32_ps( y2[v], up );
+                xin[v] = _mm256_blend_ps( r, carry, 1 );
+                carry = r;
+            }
+            for ( int v=0; v<V; ++v ) {
+                __m256 y0 = _mm256_add_ps(
+                    _mm256_add_ps(
+                        _mm256_add_ps( _mm256_mul_ps( x2[v], b2[v] ), _mm256_mul_ps( xin[v], b0[v] ) ),
+                        _mm256_mul_ps( y2[v], a2[v] ) ),
+                    _mm256_mul_ps( y1[v], a1[v] ) );
+                x2[v] = x1[v];
+                x1[v] = xin[v];
+                y2[v] = y1[v];
+                y1[v] = y0;
+            }
+            _mm_store_ss( &out[t], _mm256_castps256_ps128(
+                _mm256_permutevar8x32_ps( y1[(N-1)/8], last ) ) );
+        }
+        for ( int v=0; v<V; ++v ) {
+            _mm256_store_ps( &s[X1][8*v], x1[v] ); _mm256_store_ps( &s[X2][8*v], x2[v] );
+            _mm256_store_ps( &s[Y1][8*v], y1[v] ); _mm256_store_ps( &s[Y2][8*v], y2[v] );
+        }
+    }
+#endif
+
+    // Steady state, every section busy, plain code the compiler may vectorize
+    template< int N, int NP, typename U >
+    static void steady( U (&s)[NROWS][NP], const U* in, U* out, size_t n ) {
+        U xin[NP];
+        for ( size_t t=0; t<n; ++t ) {
+            xin[0] = in[t];
+            for ( int k=1; k<NP; ++k ) xin[k] = s[Y2][k-1];
+            for ( int k=0; k<NP; ++k ) {
+                U y0 = (s[X2][k] * s[B2][k]) + (xin[k] * s[B0][k]) + (s[Y2][k] * s[A2][k]) + (s[Y1][k] * s[A1][k]);
+                s[X2][k] = s[X1][k];
+                s[X1][k] = xin[k];
+                s[Y2][k] = s[Y1][k];
+                s[Y1][k] = y0;
+            }
+            out[t] = s[Y1][N-1];
+        }
+    }
+};
+
+/*******************************************************************
+Band pass filter as a cascade of second order sections, templated on
+the sample type T. The sections are designed in double and their
+coefficients rounded to T. process() runs the cascade as a wavefront
+across SIMD lanes; with float a register holds twice the sections.
+*******************************************************************/
+template< typename T >
+struct BandPassFilterT
 {
     struct SOSBandPass 
     {
@@ -27,7 +208,7 @@ struct BandPassFilter
 	    reset();
         }
         
-        double add(double sig) {
+        T add(T sig) {
             x[0] = sig;
             // b[1] = 0, so don't worry about it
             y[0] = (x[2] * b[2]) + (x[0] * b[0]) + (y[2] * a[2]) + (y[1] * a[1]);
@@ -49,39 +230,22 @@ struct BandPassFilter
             y[2] = 0.0;
         }
         
-        double value() {
+        T value() {
             return y[0];
         }
         
-        double a[3];
-        double b[3];
-        double y[3];
-        double x[3];
+        T a[3];
+        T b[3];
+        T y[3];
+        T x[3];
     };
     
-    struct Poles {
-        int order;
-        int len;
-        double Q[9];
-    };
-    typedef struct Poles Poles;
-
-    Poles q_poles[8] = {
-    {2,  1, {0.71, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00}},
-    {4,  2, {0.54, 1.31, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00}},
-    {6,  3, {0.52, 0.71, 1.93, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00}},
-    {8,  4, {0.51, 0.60, 0.90, 2.56, 0.00, 0.00, 0.00, 0.00, 0.00}},
-    {10, 5, {0.51, 0.56, 0.71, 1.10, 3.20, 0.00, 0.00, 0.00, 0.00}},
-    {12, 6, {0.50, 0.54, 0.63, 0.82, 1.31, 3.83, 0.00, 0.00, 0.00}},
-    {14, 7, {0.50, 0.53, 0.59, 0.71, 0.94, 1.51, 4.47, 0.00, 0.00}},
-    {16, 8, {0.50, 0.52, 0.57, 0.65, 0.79, 1.06, 1.72, 5.10, 0.00}} };
-    
     static inline double warp(double fc)
     {
         return 2.0*tan(0.5*2.0*M_PI*fc);
     }
 
-    BandPassFilter( double fc, double bw, int filter_order ) 
+    BandPassFilterT( double fc, double bw, int filter_order ) 
     : order(filter_order) 
     {
         if (order % 2 || order < 2) order = 2;
@@ -92,11 +256,11 @@ struct BandPassFilter
         double D = 2.0;
         filters.resize(order);
         double q_lp, a, b, q, wo1, wo2, A1, B1, C1, A2, B2, C2;
-        Poles& poles( q_poles[order/2-1] );
+        const double* poles( BUTTERWORTH_Q[order/2-1] );
         int k=0;
-        for (int n = 0; n < poles.len; n++)
+        for (int n = 0; n < order/2; n++)
         {
-            q_lp = poles.Q[n];
+            q_lp = poles[n];
 
             a = 1.0/q_lp;
             b = 1.0;
@@ -117,23 +281,217 @@ struct BandPassFilter
             filters[k++].init(A2,B2,C2,D);
         }
     }
-    ~BandPassFilter() {};
+    ~BandPassFilterT() {};
 
-    double add(double sig) {
+    T add(T sig) {
+        PROFILE_SAMPLE( "BandPassFilter.add" );
         for ( auto& f : filters ) sig = f.add(sig);
         return sig;
     }
     
+    // Block version of add(): out[j] is exactly what add(in[j]) would return.
+    // in and out may be the same buffer.
+    void process( const T* in, T* out, size_t n ) {
+        PROFILE_BLOCK( "BandPassFilter.process", n );
+        switch ( order ) {
+        case  2: cascade< 2>( in, out, n ); break;
+        case  4: cascade< 4>( in, out, n ); break;
+        case  6: cascade< 6>( in, out, n ); break;
+        case  8: cascade< 8>( in, out, n ); break;
+        case 10: cascade<10>( in, out, n ); break;
+        case 12: cascade<12>( in, out, n ); break;
+        case 14: cascade<14>( in, out, n ); break;
+        case 16: cascade<16>( in, out, n ); break;
+        default:
+            for ( size_t j=0; j<n; ++j ) out[j] = add( in[j] );
+        }
+    }
+
     void reset() {
         for ( auto& f: filters ) f.reset();
     }
     
-    double value() {
+    T value() {
          return filters[order-1].value();
     }
 
+    const std::vector<SOSBandPass>& sections() const {
+        return filters;
+    }
+
 private:
+    typedef SOSWavefront<T> W;
+
+    // Loads the sections into the wavefront's rows, runs it and stores the
+    // state back, so add() carries on where process() stopped
+    template< int N >
+    void cascade( const T* in, T* out, size_t n ) {
+        enum { NP = (N+W::LANES-1) & ~(W::LANES-1) };
+        T s[W::NROWS][NP] __attribute__((aligned(32)));
+        for ( int k=0; k<NP; ++k ) {
+            if ( k<N ) {
+                const SOSBandPass& f( filters[k] );
+                s[W::B0][k] = f.b[0]; s[W::B2][k] = f.b[2];
+                s[W::A1][k] = f.a[1]; s[W::A2][k] = f.a[2];
+                s[W::X1][k] = f.x[1]; s[W::X2][k] = f.x[2];
+                s[W::Y1][k] = f.y[1]; s[W::Y2][k] = f.y[2];
+            }
+            else {
+                for ( int r=0; r<W::NROWS; ++r ) s[r][k] = 0;
+            }
+        }
+        W::template run<N,NP>( s, in, out, n );
+        for ( int k=0; k<N; ++k ) {
+            SOSBandPass& f( filters[k] );
+            f.x[0] = f.x[1] = s[W::X1][k];
+            f.x[2] = s[W::X2][k];
+            f.y[0] = f.y[1] = s[W::Y1][k];
+            f.y[2] = s[W::Y2][k];
+        }
+    }
+
     int order;
     std::vector<SOSBandPass> filters;
 };
 
+typedef BandPassFilterT<double> BandPassFilter;
+typedef BandPassFilterT<float> BandPassFilterF;
+
+
+/*******************************************************************
+BandPassFilterT with the order fixed at compile time. The sections sit
+in a std::array inside the object, with no allocation, add() is a loop
+of fixed length the compiler unrolls, and process() needs no dispatch
+on the order. The design is the same as BandPassFilterT,
+written as constexpr functions on ConstMath, so a filter declared
+constexpr has its coefficients computed by the compiler:
+
+    constexpr StaticBandPassFilter<8> proto( 0.125, 0.02 );
+    StaticBandPassFilter<8> bp( proto );
+
+Coefficients agree with BandPassFilterT to a few units in the last
+place rather than bit for bit, since ConstMath is not libm. Pole pairs
+with Q 0.50 are the exception: their design takes the square root of
+a difference close to zero, which either way is only good to about
+1E-9, though the response of the pair agrees to rounding.
+*******************************************************************/
+template< int Order, typename T = double >
+class StaticBandPassFilter
+{
+    static_assert( Order>=2 && Order<=16 && Order%2==0, "Order must be even, 2 to 16" );
+
+public:
+    struct Section {
+        T b0, b2, a1, a2;
+        T x1, x2, y1, y2;
+    };
+
+    static const int ORDER = Order;
+
+    constexpr StaticBandPassFilter( double fc, double bw )
+      : StaticBandPassFilter( fc, bw, typename Indices<Order>::type() ) {}
+
+    T add( T sig ) {
+        for ( int k=0; k<Order; ++k ) {
+            // Same expression and order as SOSBandPass::add()
+            Section& s( _s[k] );
+            T y0 = (s.x2 * s.b2) + (sig * s.b0) + (s.y2 * s.a2) + (s.y1 * s.a1);
+            s.x2 = s.x1;
+            s.x1 = sig;
+            s.y2 = s.y1;
+            s.y1 = y0;
+            sig = y0;
+        }
+        return sig;
+    }
+
+    // out[j] is exactly what add(in[j]) would return; in and out may be
+    // the same buffer. Runs the same wavefront as BandPassFilterT.
+    void process( const T* in, T* out, size_t n ) {
+        typedef SOSWavefront<T> W;
+        enum { NP = (Order+W::LANES-1) & ~(W::LANES-1) };
+        T s[W::NROWS][NP] __attribute__((aligned(32)));
+        for ( int k=0; k<NP; ++k ) {
+            if ( k<Order ) {
+                const Section& f( _s[k] );
+                s[W::B0][k] = f.b0; s[W::B2][k] = f.b2;
+                s[W::A1][k] = f.a1; s[W::A2][k] = f.a2;
+                s[W::X1][k] = f.x1; s[W::X2][k] = f.x2;
+                s[W::Y1][k] = f.y1; s[W::Y2][k] = f.y2;
+            }
+            else {
+                for ( int r=0; r<W::NROWS; ++r ) s[r][k] = 0;
+            }
+        }
+        W::template run<Order,NP>( s, in, out, n );
+        for ( int k=0; k<Order; ++k ) {
+            Section& f( _s[k] );
+            f.x1 = s[W::X1][k]; f.x2 = s[W::X2][k];
+            f.y1 = s[W::Y1][k]; f.y2 = s[W::Y2][k];
+        }
+    }
+
+    void reset() {
+        for ( Section& s: _s ) s.x1 = s.x2 = s.y1 = s.y2 = 0;
+    }
+
+    T value() const {
+        return _s[Order-1].y1;
+    }
+
+    const std::array<Section,Order>& sections() const {
+        return _s;
+    }
+
+private:
+    template< int... I > struct List {};
+    template< int N, int... I > struct Indices : Indices< N-1, N-1, I... > {};
+    template< int... I > struct Indices< 0, I... > { typedef List< I... > type; };
+
+    template< int... I >
+    constexpr StaticBandPassFilter( double fc, double bw, List< I... > )
+      : _s{ { section( fc, bw, I )... } } {}
+
+    static constexpr double warp( double fc ) {
+        return 2.0*ConstMath::tan( 0.5*2.0*M_PI*fc );
+    }
+
+    // Section k of the cascade: pole pair k/2 gives two sections, one each
+    // side of the centre frequency
+    static constexpr Section section( double fc, double bw, int k ) {
+        return lowHigh( warp( fc ), warp( fc )/(warp( fc + bw/2.0 ) - warp( fc - bw/2.0 )),
+                        1.0/BUTTERWORTH_Q[Order/2-1][k/2], k%2 );
+    }
+
+    // wc is the warped centre, Q the band pass quality and a = 1/q_lp
+    static constexpr Section lowHigh( double wc, double Q, double a, int high ) {
+        return polePair( wc, Q, quality( Q, a, 2*Q/a + 1.0/(2*a*Q) ), a, high );
+    }
+
+    static constexpr double quality( double Q, double a, double t ) {
+        return ConstMath::sqrt( Q/a * (t + ConstMath::sqrt( t*t - 1 )) );
+    }
+
+    static constexpr Section polePair( double wc, double Q, double q, double a, int high ) {
+        return sos( 1.0/Q * wc, q, wc, high ? 1.0/lowPole( Q, q, a ) : lowPole( Q, q, a ) );
+    }
+
+    static constexpr double lowPole( double Q, double q, double a ) {
+        return a*q/(2*Q) + 0.5*ConstMath::sqrt( 1.0/(Q*Q) - 1/(q*q) );
+    }
+
+    static constexpr Section sos( double A, double q, double wc, double wo ) {
+        return normalize( A*2.0, wo/q * wc, wo*wo * wc*wc );
+    }
+
+    // SOSBandPass::init() with D = 2: va vd, then a0, a1 and a2
+    static constexpr Section normalize( double b0, double B, double C ) {
+        return scale( b0, 2.0*2.0 + B*2.0 + C, 2*C - 2*2.0*2.0, 2.0*2.0 - B*2.0 + C );
+    }
+
+    static constexpr Section scale( double b0, double a0, double a1, double a2 ) {
+        return Section{ T(b0/a0), T(-b0/a0), T(-a1/a0), T(-a2/a0), 0, 0, 0, 0 };
+    }
+
+    std::array<Section,Order> _s;
+};
@@ -0,0 +1,229 @@
+#pragma once
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <complex>
+#include <vector>
+#include "CordicGenerator.h"
+#include "LowPassFilters.h"
+#include "NCO.h"
+#include "Resampler.h"
+
+/*******************************************************************
+Complex baseband front end. The real input is multiplied by a complex
+local oscillator exp(-i 2 pi fc n) from a CordicGenerator, which moves
+the carrier to 0 Hz and its image to -2 fc. The I and Q products are
+low pass filtered and decimated by decim with polyphase filters, which
+remove the image. A tone cos(2 pi fc n + phi) comes out as
+0.5 exp(i phi); tones above the carrier come out at their offset,
+delayed by delay() input samples like any filtered signal.
+
+The defaults put the cutoff at the output Nyquist frequency with a
+short filter: the wide transition band folds back only onto offsets
+the demodulator does not use, and keeps the front end cheap.
+*******************************************************************/
+class BasebandConverter
+{
+public:
+  BasebandConverter( double fc, uint32_t decim, unsigned taps = 10, double cutoff = 1.0 )
+    : _lo( fc ), _decim( decim<1 ? 1 : decim ),
+      _i( _decim, 1, taps, cutoff ), _q( _decim, 1, taps, cutoff ) {}
+
+  uint32_t decim() const {
+    return _decim;
+  }
+
+  // Delay of the filters in input samples
+  double delay() const {
+    return _i.delay();
+  }
+
+  // Most outputs n inputs can produce
+  size_t outputs( size_t n ) const {
+    return _i.outputs( n );
+  }
+
+  // Converts n real samples into out, which must hold outputs(n) values.
+  // Returns the number of values written.
+  size_t process( const double* in, size_t n, std::complex<float>* out ) {
+    if ( _ib.size() < n ) {
+      _ib.resize( n );
+      _qb.resize( n );
+      _io.resize( outputs( n ) );
+      _qo.resize( outputs( n ) );
+    }
+    // CordicGenerator gives sin in real() and cos in imag()
+    _lo.generate( &_qb[0], &_ib[0], n );
+    for ( size_t j=0; j<n; ++j ) {
+      _ib[j] = in[j]*_ib[j];
+      _qb[j] = -in[j]*_qb[j];
+    }
+    size_t m = _i.process( &_ib[0], n, &_io[0] );
+    _q.process( &_qb[0], n, &_qo[0] );
+    for ( size_t k=0; k<m; ++k ) out[k] = std::complex<float>( _io[k], _qo[k] );
+    return m;
+  }
+
+private:
+  CordicGenerator _lo;
+  uint32_t _decim;
+  PolyphaseResampler _i;
+  PolyphaseResampler _q;
+  std::vector<double> _ib, _qb, _io, _qo;
+};
+
+/*******************************************************************
+Costas loop on complex baseband samples. The sample is rotated by the
+loop phase and its in phase and quadrature parts are low pass filtered
+at fcut, which keeps tones at an offset from the carrier out of the
+detector, as ilp and qlp do in CostasLoop. Their product divided by
+their power is the error of a BPSK Costas detector, zero at the phase
+of the carrier or half a turn from it. A proportional plus integral
+filter with natural frequency fnat and damping zeta steers the phase.
+Frequencies are normalized to the baseband rate.
+
+phase is the carrier phase in [0,2pi), with the same convention as
+CostasLoop, freq the smoothed offset in cycles per sample and lock the
+smoothed cos(2 error), close to 1 when locked.
+*******************************************************************/
+class BasebandCostasLoop
+{
+public:
+  BasebandCostasLoop( double fnat = 0.01, double zeta = 1.0/sqrt(2.0), double fcut = 0.05, double tau = 20 )
+    : _lock_rc( tau, 1.0 ), _freq_rc( tau, 1.0 )
+  {
+    double wn = 2*M_PI*fnat;
+    _kp = 2*zeta*wn;
+    _ki = wn*wn;
+    _ilp.init( 1.0/sqrt(2.0), fcut );
+    _qlp.init( 1.0/sqrt(2.0), fcut );
+    reset();
+  }
+
+  void reset() {
+    _theta = 0;
+    _omega = 0;
+    _ilp.reset();
+    _qlp.reset();
+    _lock_rc.reset();
+    _freq_rc.reset();
+    phase = freq = error = lock = 0;
+  }
+
+  void add( std::complex<float> z ) {
+    double sn, cs;
+    SinCosTable::instance().sincos( _theta, sn, cs );
+    double zr = z.real(), zi = z.imag();
+    double i = _ilp.add( zr*cs + zi*sn );
+    double q = _qlp.add( zi*cs - zr*sn );
+    double p = i*i + q*q;
+    error = p > 0 ? i*q/p : 0;
+    lock = _lock_rc.add( p > 0 ? (i*i - q*q)/p : 0 );
+    _omega += _ki*error;
+    _theta += _omega + _kp*error;
+    if ( _theta>=2*M_PI ) _theta -= 2*M_PI;
+    else if ( _theta<0 ) _theta += 2*M_PI;
+    phase = _theta;
+    freq = _freq_rc.add( _omega/(2*M_PI) );
+  }
+
+  void process( const std::complex<float>* z, size_t n ) {
+    for ( size_t j=0; j<n; ++j ) add( z[j] );
+  }
+
+  // Outputs
+  double phase;
+  double freq;
+  double error;
+  double lock;
+
+private:
+  double _kp;
+  double _ki;
+  double _theta;
+  double _omega;
+  BiquadLowPassFilter _ilp;
+  BiquadLowPassFilter _qlp;
+  LowPassFilter _lock_rc;
+  LowPassFilter _freq_rc;
+};
+
+/*******************************************************************
+Baseband counterpart of CordicQueueIntegrator: correlates the last
+num_samples complex samples with a tone at offset (normalized to the
+baseband rate). phase() and level() follow CordicQueueIntegrator, so a
+tone at fc+offset in the passband reads the same on both.
+*******************************************************************/
+class BasebandIntegrator
+{
+public:
+  static const uint32_t RENORMALIZE = 4096;
+
+  BasebandIntegrator( uint32_t num_samples, double offset = 0 )
+    : _num_samples( num_samples<1 ? 1 : num_samples ),
+      _step( cos( 2*M_PI*offset ), -sin( 2*M_PI*offset ) )
+  {
+    _samples.resize( _num_samples );
+    reset();
+  }
+
+  void reset() {
+    _counter = 0;
+    _sum = 0;
+    _sq_sum = 0;
+    _rot = 1;
+    _count = 0;
+    for ( Pair& p: _samples ) {
+      p.value = p.power = 0;
+    }
+    _ready = false;
+  }
+
+  void add( std::complex<float> sample ) {
+    std::complex<double> v = std::complex<double>( sample )*_rot;
+    double power = std::norm( std::complex<double>( sample ) );
+    Pair& s( _samples[_counter] );
+    _sum += v - s.value;
+    _sq_sum += power - s.power;
+    s.value = v;
+    s.power = power;
+    if ( ++_counter >= _num_samples ) {
+      _ready = true;
+      _counter = 0;
+    }
+    _rot *= _step;
+    if ( ++_count==RENORMALIZE ) {
+      _rot /= std::abs( _rot );
+      _count = 0;
+    }
+  }
+
+  double phase() const {
+    double ph = ::atan2( -_sum.imag(), _sum.real() );
+    if ( ph<0 ) ph += 2*M_PI;
+    return ph;
+  }
+
+  double level() const {
+    if ( (_ready || (_counter>0)) && (_sq_sum>0) )
+      return std::norm( _sum )/(_num_samples*_sq_sum);
+    else
+      return 0;
+  }
+
+  bool ready() const {
+    return _ready;
+  }
+
+private:
+  struct Pair { std::complex<double> value; double power; };
+  uint32_t _num_samples;
+  std::complex<double> _step;    // exp(-2 pi i offset)
+  std::complex<double> _rot;
+  std::complex<double> _sum;
+  double _sq_sum;
+  std::vector< Pair > _samples;
+  uint32_t _counter;
+  uint32_t _count;
+  bool _ready;
+};
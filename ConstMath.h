@@ -0,0 +1,45 @@
+#pragma once
+
+/*******************************************************************
+The few math functions filter design needs, written as C++11
+constexpr functions so coefficients can be computed by the compiler.
+Each is a single recursive return, as C++11 requires. Results agree
+with libm to a few units in the last place over the ranges filter
+design uses, not bit for bit.
+*******************************************************************/
+struct ConstMath
+{
+  // Newton iterations from x (or 1 below 1), a fixed number of them as
+  // the last steps may alternate between two neighbours
+  static constexpr double sqrt( double x ) {
+    return x<=0 ? 0 : sqrtIter( x, x<1 ? 1 : x, 0 );
+  }
+
+  // Taylor series; accurate for |x| up to about pi
+  static constexpr double sin( double x ) {
+    return sinTerms( x*x, x, 0, 1 );
+  }
+
+  static constexpr double cos( double x ) {
+    return cosTerms( x*x, 1, 0, 1 );
+  }
+
+  static constexpr double tan( double x ) {
+    return sin( x )/cos( x );
+  }
+
+private:
+  static constexpr double sqrtIter( double x, double g, int n ) {
+    return n==64 ? g : sqrtIter( x, 0.5*(g + x/g), n+1 );
+  }
+
+  // term is x^(2n-1)/(2n-1)! with its sign
+  static constexpr double sinTerms( double x2, double term, double sum, int n ) {
+    return n==30 ? sum : sinTerms( x2, -term*x2/((2*n)*(2*n+1)), sum + term, n+1 );
+  }
+
+  // term is x^(2n-2)/(2n-2)! with its sign
+  static constexpr double cosTerms( double x2, double term, double sum, int n ) {
+    return n==30 ? sum : cosTerms( x2, -term*x2/((2*n-1)*(2*n)), sum + term, n+1 );
+  }
+};
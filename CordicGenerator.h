@@ -1,36 +1,126 @@
 #pragma once
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <complex>
 
-
-class CordicGenerator
+// Quadrature rotator in the sample type T. The step is computed in
+// double and rounded to T; with float the rotator leaves the unit
+// circle sooner, so call normalize() more often.
+template< typename T >
+class CordicGeneratorT
 {
     public:
-    CordicGenerator() {}
-    CordicGenerator( double fc ) { init(fc); }
+    // generate() works on blocks of LANES samples and puts the rotator
+    // back on the unit circle every RENORMALIZE samples
+    static const uint32_t LANES = 8;
+    static const uint32_t RENORMALIZE = 512;
+
+    CordicGeneratorT() {}
+    CordicGeneratorT( double fc ) { init(fc); }
     void init( double fc ) { 
         set_freq( fc );
         _x = 0;
         _y = 1;
+        _count = 0;
     }
     void advance() {     
-        double tx = _x*_cs + _y*_sn;
-        double ty = _y*_cs - _x*_sn;
+        T tx = _x*_cs + _y*_sn;
+        T ty = _y*_cs - _x*_sn;
         _x = tx;
         _y = ty;
     }
+    // Puts the rotator back on the unit circle, which rounding slowly
+    // moves it off
+    void normalize() {
+        T r = T(1.0)/sqrt(_x*_x + _y*_y);
+        _x *= r;
+        _y *= r;
+    }
     void set_freq( double fc ) {
+        _fc = fc;
         _sn = sin(2*M_PI*fc);
         _cs = cos(2*M_PI*fc);        
+        _table_fc = -1;
     }
-    double real() {
+    T real() {
         return _x;
     }
-    double imag() { 
+    T imag() { 
         return _y;
     }
-    std::complex<double> value() { 
-        return std::complex<double>(_x,_y);
+    std::complex<T> value() { 
+        return std::complex<T>(_x,_y);
+    }
+
+    // Same as n times storing real() in re and imag() in im and calling
+    // advance(), up to rounding; im may be NULL. Each block of LANES
+    // samples is the rotator turned by a table of exact offsets 0 to
+    // LANES-1 steps, so the samples of a block are independent of each
+    // other and the only serial dependency left is one turn of LANES
+    // steps per block. The rotator runs in double whatever T is, and
+    // the periodic renormalization keeps its magnitude within a few
+    // rounding errors of 1 however many samples are generated.
+    void generate( T* re, T* im, size_t n ) {
+        if ( _table_fc!=_fc ) table();
+        double x = _x, y = _y;
+        size_t j = 0;
+        for ( ; j+LANES<=n; j+=LANES ) {
+            for ( uint32_t k=0; k<LANES; ++k ) re[j+k] = x*_lc[k] + y*_ls[k];
+            if ( im ) {
+                for ( uint32_t k=0; k<LANES; ++k ) im[j+k] = y*_lc[k] - x*_ls[k];
+            }
+            double tx = x*_bc + y*_bs;
+            double ty = y*_bc - x*_bs;
+            x = tx;
+            y = ty;
+            _count += LANES;
+            if ( _count >= RENORMALIZE ) renormalize( x, y );
+        }
+        if ( j<n ) {
+            uint32_t m = n-j;
+            for ( uint32_t k=0; k<m; ++k ) re[j+k] = x*_lc[k] + y*_ls[k];
+            if ( im ) {
+                for ( uint32_t k=0; k<m; ++k ) im[j+k] = y*_lc[k] - x*_ls[k];
+            }
+            double tx = x*_lc[m] + y*_ls[m];
+            double ty = y*_lc[m] - x*_ls[m];
+            x = tx;
+            y = ty;
+            _count += m;
+            // Calls shorter than a block only ever come through here
+            if ( _count >= RENORMALIZE ) renormalize( x, y );
+        }
+        _x = x;
+        _y = y;
     }
     
 private:
-    double _sn, _cs, _y, _x;
+    void renormalize( double& x, double& y ) {
+        double r = 1.0/::sqrt(x*x + y*y);
+        x *= r;
+        y *= r;
+        _count = 0;
+    }
+
+    // Offsets of the lanes and the turn of a whole block, from libm rather
+    // than repeated rotation
+    void table() {
+        for ( uint32_t k=0; k<LANES; ++k ) {
+            _lc[k] = cos(2*M_PI*_fc*k);
+            _ls[k] = sin(2*M_PI*_fc*k);
+        }
+        _bc = cos(2*M_PI*_fc*LANES);
+        _bs = sin(2*M_PI*_fc*LANES);
+        _table_fc = _fc;
+    }
+
+    T _sn, _cs, _y, _x;
+    double _fc;
+    double _table_fc;
+    double _lc[LANES], _ls[LANES], _bc, _bs;
+    uint32_t _count;
 };
+
+typedef CordicGeneratorT<double> CordicGenerator;
+typedef CordicGeneratorT<float> CordicGeneratorF;
@@ -1,12 +1,21 @@
 #pragma once
 
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
 #include "Integrators.h"
 #include "CordicGenerator.h"
+#include "Profiler.h"
+#include "EventLog.h"
 
-class CordicQueueIntegrator
+// Sliding window correlation with the tone fc, in the sample type T
+template< typename T >
+class CordicQueueIntegratorT
 {
 public: 
-  CordicQueueIntegrator( uint32_t num_samples, double fc )
+  CordicQueueIntegratorT( uint32_t num_samples, double fc )
   {
     _cordic.init( fc );
     _num_samples = num_samples;
@@ -25,9 +34,10 @@ public:
     _ready = false;
   }
   
-  void add( double sample ) {
-    double sinval = _cordic.real()*sample;
-    double cosval = _cordic.imag()*sample;
+  void add( T sample ) {
+    PROFILE_SAMPLE( "CordicQueueIntegrator.add" );
+    T sinval = _cordic.real()*sample;
+    T cosval = _cordic.imag()*sample;
     Pair& s( _samples[_counter] );
     _sin_sum += sinval - s.sin;
     _cos_sum += cosval - s.cos;
@@ -41,6 +51,34 @@ public:
     }
     _cordic.advance();
   }
+
+  // Same as add() on each of the n samples, up to rounding, with the
+  // tone made a block at a time by CordicGenerator::generate()
+  void process( const T* x, size_t n ) {
+    PROFILE_BLOCK( "CordicQueueIntegrator.process", n );
+    const size_t BLOCK = 256;
+    T sn[BLOCK], cs[BLOCK];
+    for ( size_t j=0; j<n; j+=BLOCK ) {
+      size_t m = n-j < BLOCK ? n-j : BLOCK;
+      _cordic.generate( sn, cs, m );
+      for ( size_t k=0; k<m; ++k ) {
+        T sample = x[j+k];
+        T sinval = sn[k]*sample;
+        T cosval = cs[k]*sample;
+        Pair& s( _samples[_counter] );
+        _sin_sum += sinval - s.sin;
+        _cos_sum += cosval - s.cos;
+        _sq_sum += sample*sample - s.value*s.value;
+        s.sin = sinval;
+        s.cos = cosval;
+        s.value = sample;
+        if ( ++_counter >= _num_samples ) { 
+          _ready = true; 
+          _counter = 0;
+        }
+      }
+    }
+  }
   
   double phase() const {
     double ph = ::atan2( _sin_sum, _cos_sum );
@@ -59,21 +97,171 @@ public:
       return _ready;
   }
 private:
-  CordicGenerator _cordic;
-  double _sin_sum;
-  double _cos_sum;
-  double _sq_sum;
-  struct Pair { double value; double sin; double cos; };
+  CordicGeneratorT<T> _cordic;
+  T _sin_sum;
+  T _cos_sum;
+  T _sq_sum;
+  struct Pair { T value; T sin; T cos; };
   std::vector< Pair > _samples;
   uint32_t _counter;
   bool _ready;
   uint32_t _num_samples;
 };
 
+typedef CordicQueueIntegratorT<double> CordicQueueIntegrator;
+typedef CordicQueueIntegratorT<float> CordicQueueIntegratorF;
+
+
+/*******************************************************************
+Several CordicQueueIntegrators on one signal and tone, sharing the
+mixer and the sample history. phase(w) and level(w) are those of a
+CordicQueueIntegrator with window( w ) samples.
 
-struct CordicIntegrator
+The history is a ring of prefix sums of the mixed sin and cos values
+and of the power, three float arrays, so a window sum is the current
+prefix less one entry whatever the window. Prefixes count from the
+start of an epoch of as many samples as the longest window, and the
+running sums restart from zero every epoch. Every window then reaches
+back at most into the previous epoch, the stored values never grow
+beyond one epoch's worth and the rounding does not build up however
+long the integrator runs.
+*******************************************************************/
+class MultiWindowIntegrator
 {
-  CordicIntegrator( double fc )
+public:
+  MultiWindowIntegrator( const std::vector<uint32_t>& windows, double fc )
+    : _windows( windows ), _epoch( 1 )
+  {
+    for ( uint32_t& w: _windows ) {
+      if ( w<1 ) w = 1;
+      if ( w>_epoch ) _epoch = w;
+    }
+    _fc = fc;
+    _sin.resize( _epoch+1 );
+    _cos.resize( _epoch+1 );
+    _sq.resize( _epoch+1 );
+    reset();
+  }
+
+  void reset() {
+    _cordic.init( _fc );
+    std::fill( _sin.begin(), _sin.end(), 0.0f );
+    std::fill( _cos.begin(), _cos.end(), 0.0f );
+    std::fill( _sq.begin(), _sq.end(), 0.0f );
+    _sin_acc = _cos_acc = _sq_acc = 0;
+    _sin_prev = _cos_prev = _sq_prev = 0;
+    _pos = 0;
+    _in_epoch = 0;
+    _total = 0;
+  }
+
+  void add( double sample ) {
+    double sn, cs;
+    _cordic.generate( &sn, &cs, 1 );
+    push( sample, sn, cs );
+  }
+
+  // Same as add() on each of the n samples, with the tone made a block
+  // at a time
+  void process( const double* x, size_t n ) {
+    const size_t BLOCK = 256;
+    double sn[BLOCK], cs[BLOCK];
+    for ( size_t j=0; j<n; j+=BLOCK ) {
+      size_t m = n-j < BLOCK ? n-j : BLOCK;
+      _cordic.generate( sn, cs, m );
+      for ( size_t k=0; k<m; ++k ) push( x[j+k], sn[k], cs[k] );
+    }
+  }
+
+  size_t windows() const {
+    return _windows.size();
+  }
+
+  uint32_t window( unsigned w ) const {
+    return _windows[w];
+  }
+
+  double phase( unsigned w ) const {
+    double s, c, q;
+    sums( w, s, c, q );
+    double ph = ::atan2( s, c );
+    if ( ph<0 ) ph += 2*M_PI;
+    return ph;
+  }
+
+  double level( unsigned w ) const {
+    double s, c, q;
+    sums( w, s, c, q );
+    if ( (_total>0) && (q>0) )
+      return 2*(s*s + c*c)/(_windows[w]*q);
+    else
+      return 0;
+  }
+
+  bool ready( unsigned w ) const {
+    return _total >= _windows[w];
+  }
+
+private:
+  void push( double sample, double sn, double cs ) {
+    if ( _in_epoch==_epoch ) {
+      // New epoch: the prefixes of the last one now count back from here
+      _sin_prev = _sin_acc;
+      _cos_prev = _cos_acc;
+      _sq_prev = _sq_acc;
+      _sin_acc = _cos_acc = _sq_acc = 0;
+      _in_epoch = 0;
+    }
+    _sin_acc += sn*sample;
+    _cos_acc += cs*sample;
+    _sq_acc += sample*sample;
+    _sin[_pos] = _sin_acc;
+    _cos[_pos] = _cos_acc;
+    _sq[_pos] = _sq_acc;
+    if ( ++_pos > _epoch ) _pos = 0;
+    _in_epoch++;
+    _total++;
+  }
+
+  // Sums over the last window( w ) samples: the current prefix less the
+  // one just before the window, which is zero at the start of this epoch
+  // and relative to the previous epoch before it
+  void sums( unsigned w, double& s, double& c, double& q ) const {
+    uint32_t len = _windows[w];
+    s = _sin_acc;
+    c = _cos_acc;
+    q = _sq_acc;
+    if ( _in_epoch > len ) {
+      size_t j = (_pos + _epoch - len) % (_epoch+1);
+      s -= _sin[j];
+      c -= _cos[j];
+      q -= _sq[j];
+    }
+    else if ( _in_epoch < len ) {
+      size_t j = (_pos + _epoch - len) % (_epoch+1);
+      s += _sin_prev - _sin[j];
+      c += _cos_prev - _cos[j];
+      q += _sq_prev - _sq[j];
+    }
+  }
+
+  std::vector<uint32_t> _windows;
+  uint32_t _epoch;
+  double _fc;
+  CordicGenerator _cordic;
+  std::vector<float> _sin, _cos, _sq;
+  double _sin_acc, _cos_acc, _sq_acc;
+  double _sin_prev, _cos_prev, _sq_prev;
+  size_t _pos;
+  uint32_t _in_epoch;
+  uint64_t _total;
+};
+
+
+template< typename T >
+struct CordicIntegratorT
+{
+  CordicIntegratorT( double fc )
   {
     _cordic.init( fc );
     reset();
@@ -86,15 +274,15 @@ struct CordicIntegrator
     _sq_sum = 0;
   }
   
-  void add( double sample ) {
-    double sinval = _cordic.real()*sample;
-    double cosval = _cordic.imag()*sample;
+  void add( T sample ) {
+    T sinval = _cordic.real()*sample;
+    T cosval = _cordic.imag()*sample;
     _sin_sum += sinval;
     _cos_sum += cosval;
     _sq_sum += sample*sample;
     ++_counter;
     _cordic.advance();
-    printf( "-- count:%d sample:%f sin:%f cos:%f sq:%f\n", _counter, sample, _sin_sum, _cos_sum, _sq_sum );
+    EventLog::instance().log( EVENT_INTEGRATOR, _counter, 0, sample, _sin_sum, _cos_sum, _sq_sum );
   }
   
   uint32_t count() const {
@@ -113,9 +301,12 @@ struct CordicIntegrator
   }
   
 private:
-  CordicGenerator _cordic;
-  double _sin_sum;
-  double _cos_sum;
-  double _sq_sum;
+  CordicGeneratorT<T> _cordic;
+  T _sin_sum;
+  T _cos_sum;
+  T _sq_sum;
   uint32_t _counter;
 };
+
+typedef CordicIntegratorT<double> CordicIntegrator;
+typedef CordicIntegratorT<float> CordicIntegratorF;
@@ -2,12 +2,20 @@
 #include "Integrators.h"
 #include "LowPassFilters.h"
 #include "LockDetector.h"
+#include "NCO.h"
+#include "Profiler.h"
+#include "EventLog.h"
 
 //https://arxiv.org/pdf/1511.04435.pdf
 
-struct CostasLoop 
+// The filters and the detector run in the sample type T. The phase
+// integrators and the oscillator stay in double or wider, as the
+// phase they carry grows with every sample. So does flp: its cutoff is
+// low enough that float coefficients would move its DC gain by 1E-4.
+template< typename T >
+struct CostasLoopT 
 {
-    CostasLoop( 
+    CostasLoopT( 
         double fc_hz,          // Carrier frequency (normalized for fs=1)
         double qual = -1,      // Quality factor of in and out of phase low pass filters
         double fcut = -1,      // Cutoff frequency for the in and out of phase lpf [Hz] 
@@ -18,6 +26,7 @@ struct CostasLoop
         double zeta = -1       // Damping ratio of this control system
     ) 
     : fc(fc_hz), 
+      nco(false),
       amp(1.0), vco(1.0),
       lock_detector(fc_hz),
       lock_rc(0.01*fc_hz,1.0)
@@ -37,6 +46,8 @@ struct CostasLoop
         G = 4.0*M_PI*zeta*fnat;
         a = fnat*M_PI/zeta;
         inc = 2.0*M_PI*fc;
+        inc_cos = cos(inc);
+        inc_sin = sin(inc);
     
         // Variables to help generate measure frequency
         last_vco_phase = 0.0;
@@ -47,54 +58,102 @@ struct CostasLoop
         reset();
     }   
     
-    double add( double input ) {
+    T add( T input ) {
+        PROFILE_SPLITS();
         // Phase Generator
         // vco_phase is a constantly increasing phase value
         double vco_phase = vco.value();
 
         // Oscillator
-        double cos_vco = cos(vco_phase);
-        double sin_vco =-sin(vco_phase);
+        T cos_vco, sin_vco;
+        if ( nco ) {
+            if ( nco_count==0 ) {
+                // Keep the phase in [0,2pi), carrying the same whole turns
+                // out of every phase accumulator so the outputs don't move,
+                // and restart the rotator from the table
+                if ( vco_phase>=2*M_PI || vco_phase<0 ) {
+                    double turns = 2*M_PI*::floor(vco_phase/(2*M_PI));
+                    vco.shift(-turns);
+                    vco_phase = vco.value();
+                    free_phase -= turns;
+                    last_vco_phase -= turns;
+                }
+                SinCosTable::instance().sincos(vco_phase, nco_sin, nco_cos);
+                nco_count = NCO_RESYNC;
+            }
+            cos_vco = nco_cos;
+            sin_vco =-nco_sin;
+        }
+        else {
+            cos_vco = cos(vco_phase);
+            sin_vco =-sin(vco_phase);
+        }
+        PROFILE_SPLIT( "CostasLoop.nco" );
 
         // Error Generator
-        double in_phase = 2.0*ilp.add(input*cos_vco);
-        double qu_phase = 2.0*qlp.add(input*sin_vco);
+        T in_phase = T(2.0)*ilp.add(input*cos_vco);
+        T qu_phase = T(2.0)*qlp.add(input*sin_vco);
+        PROFILE_SPLIT( "CostasLoop.mixer" );
 
         // Update Loop Integrators
-        double s2 = in_phase*qu_phase;
+        T s2 = in_phase*qu_phase;
         double s3 = G * s2;
         double s4 = a * s3;
         double s5 = amp.add(s4);
         double s6 = s3 + s5;
         error = s2;
         vco.add(inc + s6);
+        if ( nco ) {
+            // The vco integrator advances by inc+s6; rotate the oscillator
+            // by the same angle. s6 is the small loop correction, applied
+            // with a short series. Larger steps resync from the table.
+            if ( (s6 > NCO_MAX_STEP) || (s6 < -NCO_MAX_STEP) ) {
+                nco_count = 0;
+            }
+            else {
+                double e2 = s6*s6;
+                double se = s6*(1.0 - e2*(1.0/6 - e2*(1.0/120)));
+                double ce = 1.0 - e2*(0.5 - e2*(1.0/24 - e2*(1.0/720)));
+                double c = nco_cos*ce - nco_sin*se;
+                double s = nco_sin*ce + nco_cos*se;
+                nco_cos = c*inc_cos - s*inc_sin;
+                nco_sin = s*inc_cos + c*inc_sin;
+                nco_count--;
+            }
+        }
 	free_phase += inc;
 	phase = vco_phase - free_phase;
 	if ( phase>=2*M_PI ) {
 	  uint64_t n = phase/(2*M_PI);
 	  phase -= n*2*M_PI;
 	  free_phase += n*2*M_PI;
-	  printf( "Adjusting forward %ld periods\n", n );
+	  EventLog::instance().log( EVENT_PHASE_ADJUST, n, 0, phase );
 	}
 	else if ( phase<0 ) {
 	  uint64_t n = -phase/(2*M_PI) + 1;
 	  phase += n*2*M_PI;
 	  free_phase -= n*2*M_PI;
-	  printf( "Adjusting backward %ld periods\n", n );
+	  EventLog::instance().log( EVENT_PHASE_ADJUST, -int64_t(n), 0, phase );
 	}
 	
 	  
-	int64_t n = (phase-M_PI)/M_PI;
-	if ( n<0 || n>=2 ) { 
-	  phase -= n*M_PI;
-	  free_phase += n*2*M_PI;
+	// n can only be nonzero near 0 or past 2pi, skip the divide otherwise
+	if ( phase<1.0 || phase>=2*M_PI ) {
+	  int64_t n = (phase-M_PI)/M_PI;
+	  if ( n<0 || n>=2 ) { 
+	    phase -= n*M_PI;
+	    free_phase += n*2*M_PI;
+	  }
 	}
+        PROFILE_SPLIT( "CostasLoop.loop" );
 
-        double lockval = lock_detector.add(in_phase, qu_phase);
+        T lockval = lock_detector.add(in_phase, qu_phase);
         lock = lock_rc.add(lockval);        
+        PROFILE_SPLIT( "CostasLoop.lock" );
 
         double phase_derivative = (vco_phase - last_vco_phase) * HZ_PER_RAD;
         freq = flp.add(phase_derivative);
+        PROFILE_SPLIT( "CostasLoop.freq" );
 
 	//printf( "Input:%7.3f vco:%5.0f  s/c:%8.6f %8.6f  Phase: %7.6f %7.6f\n",
 	//	input, vco_phase*180/M_PI, cos_vco, sin_vco, in_phase, qu_phase );
@@ -107,6 +166,7 @@ struct CostasLoop
     
     void reset() {
         last_vco_phase = 0.0;
+        nco_count = 0;
         ilp.reset();
         qlp.reset();
         vco.reset();
@@ -129,14 +189,28 @@ struct CostasLoop
     double freq;
     double phase;
     double free_phase;
+
+    // Use a quadrature rotator, resynchronized from the table in NCO.h
+    // and wrapped every NCO_RESYNC samples, instead of libm sin/cos
+    bool nco;
+    static const uint32_t NCO_RESYNC = 256;
+    static constexpr double NCO_MAX_STEP = 0.02;
     
     // State
     double last_vco_phase;
+    double inc_cos;
+    double inc_sin;
+    double nco_cos;
+    double nco_sin;
+    uint32_t nco_count;
     Integrator amp;
     Integrator vco;
-    BiquadLowPassFilter ilp;
-    BiquadLowPassFilter qlp;
+    BiquadLowPassFilterT<T> ilp;
+    BiquadLowPassFilterT<T> qlp;
     BiquadLowPassFilter flp;
-    LockDetector lock_detector;
-    LowPassFilter lock_rc;
+    LockDetectorT<T> lock_detector;
+    LowPassFilterT<T> lock_rc;
 };
+
+typedef CostasLoopT<double> CostasLoop;
+typedef CostasLoopT<float> CostasLoopF;
@@ -0,0 +1,304 @@
+#pragma once
+#include "LowPassFilters.h"
+#include "NCO.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#ifdef __SSE4_1__
+#include <immintrin.h>
+#endif
+
+/*******************************************************************
+Runs many independent Costas loops, one per input stream, in lockstep.
+The same algorithm as CostasLoop in NCO mode, but the state of every
+filter, integrator and oscillator is kept as struct-of-arrays in blocks
+of LANES streams, and one vector instruction advances a whole block.
+A single loop is bound by the latency of its feedback path; across
+streams the work is independent, so the bank is bound by throughput.
+
+The integrators carry double instead of long double sums, so results
+agree with CostasLoop to rounding, not bit for bit.
+*******************************************************************/
+class CostasLoopBank
+{
+public:
+    // One block is one vector register wide
+#if defined(__AVX512F__)
+    static const size_t LANES = 8;
+#elif defined(__AVX__)
+    static const size_t LANES = 4;
+#else
+    static const size_t LANES = 2;
+#endif
+    typedef double vec __attribute__((vector_size(8*LANES), aligned(8)));
+    typedef int64_t mask __attribute__((vector_size(8*LANES), aligned(8)));
+
+    // One loop per entry of fc_hz, the other parameters as in CostasLoop
+    // and scaled the same way by each stream's carrier
+    CostasLoopBank(
+        const std::vector<double>& fc_hz,
+        double qual = -1,
+        double fcut = -1,
+        double fnat = -1,
+        double lpcut = -1,
+        double zeta = -1
+    )
+    : phase( fc_hz.size() ),
+      freq( fc_hz.size() ),
+      lock( fc_hz.size() ),
+      error( fc_hz.size() ),
+      _streams( fc_hz.size() ),
+      _blocks( (fc_hz.size()+LANES-1)/LANES )
+    {
+        _bank.resize( _blocks );
+        for ( size_t s=0; s<_blocks*LANES; ++s ) {
+            // Padding lanes run a copy of the last stream on zero input
+            double fc = fc_hz[ s<_streams ? s : _streams-1 ];
+            double q = qual<0 ? 1.0/sqrt(2.0) : qual;
+            double z = zeta<0 ? 1.0/sqrt(2.0) : zeta;
+            double fcu = fcut<0 ? 0.6*fc : fcut;
+            double fn = fnat<0 ? 0.2*fc : fnat;
+            double lpc = lpcut<0 ? 0.1*fc : lpcut;
+
+            Block& b = _bank[s/LANES];
+            size_t l = s%LANES;
+            b.ilp.init( l, BiquadLowPassFilter( q, fcu ) );
+            b.qlp.init( l, BiquadLowPassFilter( q, fcu ) );
+            b.flp.init( l, BiquadLowPassFilter( q, lpc ) );
+            b.lip.init( l, BiquadLowPassFilter( 0.707106, fc ) );
+            b.lqp.init( l, BiquadLowPassFilter( 0.707106, fc ) );
+            b.G[l] = 4.0*M_PI*z*fn;
+            b.a[l] = fn*M_PI/z;
+            b.inc[l] = 2.0*M_PI*fc;
+            b.inc_cos[l] = cos( b.inc[l] );
+            b.inc_sin[l] = sin( b.inc[l] );
+            b.tau_fs[l] = 0.01*fc*1.0;
+        }
+        reset();
+    }
+
+    void reset() {
+        for ( size_t k=0; k<_blocks; ++k ) {
+            Block& b = _bank[k];
+            b.ilp.reset();
+            b.qlp.reset();
+            b.flp.reset();
+            b.lip.reset();
+            b.lqp.reset();
+            b.amp_sum = b.vco_sum = b.free_phase = b.last_vco_phase = b.lock_rc = zero();
+            b.nco_cos = b.nco_sin = b.count = zero();
+            b.phase = b.freq = b.lock = b.error = zero();
+        }
+        publish( 0, _blocks );
+    }
+
+    size_t size() const {
+        return _streams;
+    }
+
+    // Advances every loop by one sample, input[s] going to stream s
+    void add( const double* input ) {
+        process( input, 1 );
+    }
+
+    // Runs n samples per stream. input holds n rows of size() samples, one
+    // per stream. When given, phase_out and freq_out receive the outputs in
+    // the same layout; the arrays below always hold those of the last row.
+    void process( const double* input, size_t n, double* phase_out = NULL, double* freq_out = NULL ) {
+        for ( size_t k=0; k<_blocks; ++k ) {
+            size_t first = k*LANES;
+            size_t cnt = _streams-first < LANES ? _streams-first : LANES;
+            Block b = _bank[k];
+            for ( size_t t=0; t<n; ++t ) {
+                vec x = zero();
+                memcpy( &x, input + t*_streams + first, cnt*sizeof(double) );
+                step( b, x );
+                if ( phase_out ) memcpy( phase_out + t*_streams + first, &b.phase, cnt*sizeof(double) );
+                if ( freq_out ) memcpy( freq_out + t*_streams + first, &b.freq, cnt*sizeof(double) );
+            }
+            _bank[k] = b;
+        }
+        publish( 0, _blocks );
+    }
+
+    // Outputs of the last sample, one entry per stream
+    std::vector<double> phase;
+    std::vector<double> freq;
+    std::vector<double> lock;
+    std::vector<double> error;
+
+private:
+    struct Biquads {
+        vec b0, b1, b2, a1, a2;
+        vec x1, x2, y1, y2;
+
+        void init( size_t l, const BiquadLowPassFilter& f ) {
+            double c[5];
+            f.coefficients( c );
+            b0[l] = c[0];
+            b1[l] = c[1];
+            b2[l] = c[2];
+            a1[l] = c[3];
+            a2[l] = c[4];
+        }
+
+        void reset() {
+            x1 = x2 = y1 = y2 = zero();
+        }
+
+        vec add( vec x0 ) {
+            vec y0 = b0 * x0 + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = y0;
+            return y0;
+        }
+    };
+
+    struct Block {
+        // Constants
+        Biquads ilp, qlp, flp, lip, lqp;
+        vec G, a, inc, inc_cos, inc_sin, tau_fs;
+        // State
+        vec amp_sum, vco_sum, free_phase, last_vco_phase, lock_rc;
+        vec nco_cos, nco_sin, count;
+        // Outputs
+        vec phase, freq, lock, error;
+    };
+
+    static vec zero() {
+        vec v;
+        for ( size_t l=0; l<LANES; ++l ) v[l] = 0;
+        return v;
+    }
+
+    static vec splat( double x ) {
+        return zero() + x;
+    }
+
+    static bool any( mask m ) {
+        int64_t r = 0;
+        for ( size_t l=0; l<LANES; ++l ) r |= m[l];
+        return r!=0;
+    }
+
+    static vec trunc( vec x ) {
+#if defined(__AVX512F__)
+        return (vec)_mm512_roundscale_pd( (__m512d)x, _MM_FROUND_TO_ZERO );
+#elif defined(__AVX__)
+        return (vec)_mm256_round_pd( (__m256d)x, _MM_FROUND_TO_ZERO );
+#elif defined(__SSE4_1__)
+        return (vec)_mm_round_pd( (__m128d)x, _MM_FROUND_TO_ZERO );
+#else
+        for ( size_t l=0; l<LANES; ++l ) x[l] = ::trunc( x[l] );
+        return x;
+#endif
+    }
+
+    // Wraps the phase accumulators and restarts the rotator from the table
+    // on the lanes whose count ran out, as CostasLoop does every NCO_RESYNC
+    static void resync( Block& b ) {
+        for ( size_t l=0; l<LANES; ++l ) {
+            if ( b.count[l]!=0 ) continue;
+            double vco_phase = b.vco_sum[l]*0.5;
+            if ( vco_phase>=2*M_PI || vco_phase<0 ) {
+                double turns = 2*M_PI*::floor(vco_phase/(2*M_PI));
+                b.vco_sum[l] += -turns*2.0;
+                vco_phase = b.vco_sum[l]*0.5;
+                b.free_phase[l] -= turns;
+                b.last_vco_phase[l] -= turns;
+            }
+            double s, c;
+            SinCosTable::instance().sincos( vco_phase, s, c );
+            b.nco_sin[l] = s;
+            b.nco_cos[l] = c;
+            b.count[l] = RESYNC;
+        }
+    }
+
+    static void step( Block& b, vec input ) {
+        const double TWO_PI = 2*M_PI;
+        const double HZ_PER_RAD = 1.0/2.0/M_PI;
+        const vec ZERO = zero();
+        const vec ONE = splat( 1.0 );
+
+        if ( any( b.count==ZERO ) ) resync( b );
+        vec vco_phase = b.vco_sum*0.5;
+        vec cos_vco = b.nco_cos;
+        vec sin_vco = -b.nco_sin;
+
+        // Error Generator
+        vec in_phase = 2.0*b.ilp.add( input*cos_vco );
+        vec qu_phase = 2.0*b.qlp.add( input*sin_vco );
+
+        // Loop Integrators, both with fs=1
+        vec s2 = in_phase*qu_phase;
+        vec s3 = b.G * s2;
+        vec s4 = b.a * s3;
+        vec out = s4 + b.amp_sum;
+        b.amp_sum = s4 + out;
+        vec s5 = out*0.5;
+        vec s6 = s3 + s5;
+        b.error = s2;
+        vec step = b.inc + s6;
+        b.vco_sum = step + (step + b.vco_sum);
+
+        // Rotate the oscillator by the same angle, large steps resync
+        mask big = (s6 > MAX_STEP) | (s6 < -MAX_STEP);
+        vec e2 = s6*s6;
+        vec se = s6*(1.0 - e2*(1.0/6 - e2*(1.0/120)));
+        vec ce = 1.0 - e2*(0.5 - e2*(1.0/24 - e2*(1.0/720)));
+        vec c = b.nco_cos*ce - b.nco_sin*se;
+        vec s = b.nco_sin*ce + b.nco_cos*se;
+        b.nco_cos = c*b.inc_cos - s*b.inc_sin;
+        b.nco_sin = s*b.inc_cos + c*b.inc_sin;
+        b.count = big ? ZERO : b.count - 1.0;
+
+        // Phase relative to the free running carrier, kept in [0,2pi)
+        b.free_phase += b.inc;
+        vec phase = vco_phase - b.free_phase;
+        vec n = phase>=TWO_PI ? trunc( phase/TWO_PI ) :
+                phase<0 ? -(trunc( -phase/TWO_PI ) + 1.0) : ZERO;
+        phase -= n*TWO_PI;
+        b.free_phase += n*TWO_PI;
+        n = trunc( (phase-M_PI)/M_PI );
+        n = (n<0) | (n>=2) ? n : ZERO;
+        phase -= n*M_PI;
+        b.free_phase += n*TWO_PI;
+        b.phase = phase;
+
+        // Lock Detector
+        vec li = b.lip.add( in_phase*in_phase );
+        vec lq = b.lqp.add( qu_phase*qu_phase );
+        vec lockval = (li > LOCK_THRESH) & (lq < LOCK_THRESH) ? ONE : ZERO;
+        b.lock_rc = (lockval + b.tau_fs * b.lock_rc)/(1.0 + b.tau_fs);
+        b.lock = b.lock_rc;
+
+        vec phase_derivative = (vco_phase - b.last_vco_phase) * HZ_PER_RAD;
+        b.freq = b.flp.add( phase_derivative );
+        b.last_vco_phase = vco_phase;
+    }
+
+    // Copies the outputs of blocks [k0,k1) to the public arrays
+    void publish( size_t k0, size_t k1 ) {
+        for ( size_t k=k0; k<k1; ++k ) {
+            size_t first = k*LANES;
+            size_t cnt = _streams-first < LANES ? _streams-first : LANES;
+            memcpy( &phase[first], &_bank[k].phase, cnt*sizeof(double) );
+            memcpy( &freq[first], &_bank[k].freq, cnt*sizeof(double) );
+            memcpy( &lock[first], &_bank[k].lock, cnt*sizeof(double) );
+            memcpy( &error[first], &_bank[k].error, cnt*sizeof(double) );
+        }
+    }
+
+    static constexpr double RESYNC = 256;
+    static constexpr double MAX_STEP = 0.02;
+    static constexpr double LOCK_THRESH = 0.5;
+
+    size_t _streams;
+    size_t _blocks;
+    std::vector<Block> _bank;
+};
@@ -4,11 +4,14 @@
 #include <stdint.h>
 #include <math.h>
 
-class DCT
+// Sums are in the sample type T. The phase keeps counting up for as
+// long as samples come in, so it stays in double whatever T is.
+template< typename T >
+class DCTT
 {
 public:
-  DCT() {};
-  DCT( double freq_norm ) { init( freq_norm ); }
+  DCTT() {};
+  DCTT( double freq_norm ) { init( freq_norm ); }
   void init(  double fc ) {
     _fc = fc;
     _phase_inc = 2*_fc*M_PI;
@@ -19,9 +22,9 @@ public:
     _counter = 0;
     _phase = 0;
   }
-  void add( double value ) {
-    _sum_s += value * sin( _phase );
-    _sum_c += value * cos( _phase );
+  void add( T value ) {
+    _sum_s += value * T( sin( _phase ) );
+    _sum_c += value * T( cos( _phase ) );
     _phase += _phase_inc;
     _counter++;
   }
@@ -32,19 +35,23 @@ public:
     return ::atan2( _sum_s, _sum_c );
   }
   double _fc;
-  double _sum_s;
-  double _sum_c;
+  T _sum_s;
+  T _sum_c;
   double _phase;
   double _phase_inc;
   uint32_t _counter;
 };
 
+typedef DCTT<double> DCT;
+typedef DCTT<float> DCTF;
 
-class DCTArray
+
+template< typename T >
+class DCTArrayT
 {
 public:
- DCTArray( unsigned N ) : _dct(N) {}
-  DCTArray( const std::vector<double>& freqs ) {
+ DCTArrayT( unsigned N ) : _dct(N) {}
+  DCTArrayT( const std::vector<double>& freqs ) {
     init( freqs );
   }
   void init( const std::vector<double>& freqs ) {
@@ -54,14 +61,17 @@ public:
       _dct[j].init( freqs[j] );
     }
   }
-  void add( double value ) {
-    for ( DCT& d : _dct ) {
+  void add( T value ) {
+    for ( DCTT<T>& d : _dct ) {
       d.add( value );      
     }
   }
-  DCT& operator []( unsigned j ) {
+  DCTT<T>& operator []( unsigned j ) {
     return _dct[j];
   }
 private:
-  std::vector<DCT> _dct;
+  std::vector< DCTT<T> > _dct;
 };
+
+typedef DCTArrayT<double> DCTArray;
+typedef DCTArrayT<float> DCTArrayF;
@@ -0,0 +1,256 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// What the fields of an Event hold, by type
+enum EventType
+{
+  EVENT_CYCLE = 1,        // id cycle; v freq [Hz], phase [degrees], error, lock
+  EVENT_PHASE_ADJUST,     // id whole periods taken out of the loop phase, negative backward; v phase after
+  EVENT_LOCK_IN,          // id cycle; v carrier, clock phase [degrees], slow, fast lock level
+  EVENT_LOCK_OUT,         // same as EVENT_LOCK_IN
+  EVENT_SYMBOL,           // id symbol, aux clock state; v data phase, level, fast carrier phase, clock phase, level
+  EVENT_INVALID_SYMBOL,   // id constellation point, aux clock state; v data phase, clock phase
+  EVENT_TRANSITION,       // id cycle, aux clock state; v previous clock state
+  EVENT_INTEGRATOR        // id samples so far; v sample, sin sum, cos sum, square sum
+};
+
+// One fixed size record, as held in the ring and written to the file
+struct Event
+{
+  uint16_t type;
+  uint16_t thread;        // order in which the threads logged their first event
+  int32_t aux;
+  int64_t id;
+  uint64_t time;          // ticks, see EventLogHeader
+  double v[5];
+};
+
+// Start of an event file, followed by Event records to the end
+struct EventLogHeader
+{
+  char magic[8];          // "WAVEVT1"
+  uint32_t record_size;   // sizeof(Event)
+  uint32_t reserved;
+  uint64_t start;         // time of the first tick, in ticks
+  double ticks_per_ns;    // measured over the whole log
+};
+
+/*******************************************************************
+Binary event log, so the decode path never formats text or waits on a
+terminal. Producers on any thread copy fixed size records into a
+bounded lock free ring (one sequence number per slot, claimed with a
+compare and swap on the head). A background thread drains the ring to
+the file in batches. Until open() is called, log() drops every record
+after one relaxed load. A full ring makes producers wait for the
+drain rather than lose records; waits() counts how often that happened.
+WavEventDump renders the file as text.
+*******************************************************************/
+class EventLog
+{
+public:
+  static const size_t CAPACITY = 1<<16;      // records in the ring
+  static const size_t BATCH = 1024;          // records per write
+
+  static EventLog& instance() {
+    static EventLog log;
+    return log;
+  }
+
+  bool open( const std::string& filename ) {
+    close();
+    _file = fopen( filename.c_str(), "wb" );
+    if ( !_file ) {
+      printf( "Could not open file [%s] for writing\n", filename.c_str() );
+      return false;
+    }
+    _filename = filename;
+    if ( !_slots ) _slots = new Slot[CAPACITY];
+    for ( size_t k=0; k<CAPACITY; ++k ) _slots[k].seq.store( k, std::memory_order_relaxed );
+    _head.store( 0 );
+    _tail = 0;
+    _written = 0;
+    _waits = 0;
+    _start = ticks();
+    _start_ns = nanoseconds();
+    header();
+    _closing.store( false );
+    _drain = std::thread( &EventLog::drain, this );
+    _enabled.store( true, std::memory_order_release );
+    return true;
+  }
+
+  // Waits for every record logged so far to be written, then closes.
+  // Records logged while it runs may be lost.
+  bool close() {
+    if ( !_file ) return true;
+    _enabled.store( false, std::memory_order_release );
+    _closing.store( true, std::memory_order_release );
+    _drain.join();
+    header();
+    bool ok = ferror( _file )==0;
+    if ( fclose( _file )!=0 ) ok = false;
+    _file = NULL;
+    printf( "Logged %lu events to %s\n", _written, _filename.c_str() );
+    return ok;
+  }
+
+  bool enabled() const {
+    return _enabled.load( std::memory_order_relaxed );
+  }
+
+  void log( uint16_t type, int64_t id, int32_t aux = 0, double v0 = 0, double v1 = 0, double v2 = 0,
+            double v3 = 0, double v4 = 0 ) {
+    if ( !enabled() ) return;
+    Event e;
+    e.type = type;
+    e.thread = thread();
+    e.aux = aux;
+    e.id = id;
+    e.time = ticks();
+    e.v[0] = v0;
+    e.v[1] = v1;
+    e.v[2] = v2;
+    e.v[3] = v3;
+    e.v[4] = v4;
+    push( e );
+  }
+
+  uint64_t waits() const {
+    return _waits.load();
+  }
+
+  static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return nanoseconds();
+#endif
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<uint64_t> seq;
+    Event event;
+  };
+
+  // The ring is only allocated by open(), so a log that is never opened
+  // costs nothing
+  EventLog() : _slots( NULL ), _head( 0 ), _tail( 0 ), _enabled( false ), _closing( false ),
+               _file( NULL ), _written( 0 ), _waits( 0 ) {}
+
+  ~EventLog() {
+    close();
+    delete[] _slots;
+  }
+
+  static uint64_t nanoseconds() {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+  }
+
+  // Small ids, in the order threads first log
+  static uint16_t thread() {
+    static std::atomic<uint16_t> next( 0 );
+    static thread_local int id = -1;
+    if ( id<0 ) id = next.fetch_add( 1 );
+    return id;
+  }
+
+  // A slot is free for position pos when its sequence is pos, and holds
+  // the record for pos once its sequence is pos+1
+  void push( const Event& e ) {
+    uint64_t pos = _head.load( std::memory_order_relaxed );
+    Slot* s;
+    bool waited = false;
+    for ( ;; ) {
+      s = &_slots[pos & (CAPACITY-1)];
+      uint64_t seq = s->seq.load( std::memory_order_acquire );
+      int64_t diff = int64_t( seq ) - int64_t( pos );
+      if ( diff==0 ) {
+        if ( _head.compare_exchange_weak( pos, pos+1, std::memory_order_relaxed ) ) break;
+      }
+      else if ( diff<0 ) {
+        // Full: the drain has not freed this slot yet. Once close() has
+        // begun it may never, so the record is dropped
+        if ( _closing.load( std::memory_order_acquire ) ) return;
+        // One wait per record held up, however many yields it takes
+        if ( !waited ) _waits.fetch_add( 1, std::memory_order_relaxed );
+        waited = true;
+        std::this_thread::yield();
+        pos = _head.load( std::memory_order_relaxed );
+      }
+      else pos = _head.load( std::memory_order_relaxed );
+    }
+    s->event = e;
+    s->seq.store( pos+1, std::memory_order_release );
+  }
+
+  // The one consumer: copies out up to BATCH records that are ready
+  size_t pop( Event* out ) {
+    size_t n = 0;
+    while ( n<BATCH ) {
+      Slot& s( _slots[_tail & (CAPACITY-1)] );
+      if ( s.seq.load( std::memory_order_acquire )!=_tail+1 ) break;
+      out[n++] = s.event;
+      s.seq.store( _tail + CAPACITY, std::memory_order_release );
+      _tail++;
+    }
+    return n;
+  }
+
+  void drain() {
+    Event batch[BATCH];
+    for ( ;; ) {
+      // Read the flag first: whatever was logged before close() is in
+      // the ring by then
+      bool closing = _closing.load( std::memory_order_acquire );
+      size_t n = pop( batch );
+      if ( n>0 ) {
+        _written += fwrite( batch, sizeof(Event), n, _file );
+        continue;
+      }
+      if ( closing ) break;
+      std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
+  }
+
+  // Written at open() and again, with the tick rate, at close()
+  void header() {
+    EventLogHeader h;
+    memset( &h, 0, sizeof(h) );
+    memcpy( h.magic, "WAVEVT1", 8 );
+    h.record_size = sizeof(Event);
+    h.start = _start;
+    uint64_t ns = nanoseconds() - _start_ns;
+    h.ticks_per_ns = ns>0 ? double( ticks() - _start )/ns : 1;
+    fseek( _file, 0, SEEK_SET );
+    fwrite( &h, sizeof(h), 1, _file );
+    fseek( _file, 0, SEEK_END );
+  }
+
+  Slot* _slots;
+  alignas(64) std::atomic<uint64_t> _head;
+  alignas(64) uint64_t _tail;
+  std::atomic<bool> _enabled;
+  std::atomic<bool> _closing;
+  std::thread _drain;
+  FILE* _file;
+  std::string _filename;
+  uint64_t _written;
+  std::atomic<uint64_t> _waits;
+  uint64_t _start;
+  uint64_t _start_ns;
+};
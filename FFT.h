@@ -0,0 +1,222 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+/*******************************************************************
+Radix-2 FFT on split real and imaginary arrays. Twiddles are computed
+once, stage by stage, so the inner loop of every pass reads them
+contiguously and runs over plain arrays the compiler vectorizes.
+real() transforms n real samples through one complex FFT of n/2,
+inverse() takes such a spectrum back to the samples.
+Forward transform, X[k] = sum of x[m] exp(-2 pi i k m / n).
+*******************************************************************/
+class FFT
+{
+public:
+  FFT( unsigned n ) {
+    init( n );
+  }
+
+  // n must be a power of two, at least 2
+  void init( unsigned n ) {
+    _n = n;
+    _h = n/2;
+    // Stage with half size m keeps its twiddles at [m,2m)
+    _wr.resize( _h>1 ? _h : 2 );
+    _wi.resize( _h>1 ? _h : 2 );
+    for ( unsigned m=1; m<_h; m*=2 ) {
+      for ( unsigned j=0; j<m; ++j ) {
+        _wr[m+j] = cos( M_PI*j/m );
+        _wi[m+j] = -sin( M_PI*j/m );
+      }
+    }
+    _rev.resize( _h );
+    unsigned bits = 0;
+    while ( (1u<<bits) < _h ) bits++;
+    for ( unsigned j=0; j<_h; ++j ) {
+      unsigned r = 0;
+      for ( unsigned b=0; b<bits; ++b ) r |= ((j>>b)&1) << (bits-1-b);
+      _rev[j] = r;
+    }
+    _rr.resize( _h );
+    _ri.resize( _h );
+    for ( unsigned k=0; k<_h; ++k ) {
+      _rr[k] = cos( 2*M_PI*k/n );
+      _ri[k] = -sin( 2*M_PI*k/n );
+    }
+    _zr.resize( _h );
+    _zi.resize( _h );
+  }
+
+  unsigned size() const {
+    return _n;
+  }
+
+  // In place complex FFT of size n/2
+  void complex( double* re, double* im ) const {
+    unsigned n = _h;
+    for ( unsigned j=0; j<n; ++j ) {
+      unsigned r = _rev[j];
+      if ( r > j ) {
+        double t = re[j]; re[j] = re[r]; re[r] = t;
+        t = im[j]; im[j] = im[r]; im[r] = t;
+      }
+    }
+    for ( unsigned m=1; m<n; m*=2 ) {
+      for ( unsigned k=0; k<n; k+=2*m ) {
+        pass( re+k, im+k, re+k+m, im+k+m, &_wr[m], &_wi[m], m );
+      }
+    }
+  }
+
+  // Transform of n real samples into bins 0..n/2, re and im of n/2+1
+  void real( const double* in, double* re, double* im ) {
+    unsigned h = _h;
+    double* zr = &_zr[0];
+    double* zi = &_zi[0];
+    for ( unsigned j=0; j<h; ++j ) {
+      zr[j] = in[2*j];
+      zi[j] = in[2*j+1];
+    }
+    complex( zr, zi );
+    // Split the transforms of the even and odd samples and combine them
+    re[0] = zr[0] + zi[0];
+    im[0] = 0;
+    re[h] = zr[0] - zi[0];
+    im[h] = 0;
+    for ( unsigned k=1; k<h; ++k ) {
+      double ar = zr[k], ai = zi[k];
+      double br = zr[h-k], bi = -zi[h-k];
+      double er = 0.5*(ar + br), ei = 0.5*(ai + bi);
+      double orr = 0.5*(ai - bi), oi = -0.5*(ar - br);
+      re[k] = er + orr*_rr[k] - oi*_ri[k];
+      im[k] = ei + orr*_ri[k] + oi*_rr[k];
+    }
+  }
+
+  // Inverse of real(): n samples back from bins 0..n/2, scaled so that
+  // inverse( real( x ) ) is x
+  void inverse( const double* re, const double* im, double* out ) {
+    unsigned h = _h;
+    double* zr = &_zr[0];
+    double* zi = &_zi[0];
+    double s = 0.5/h;
+    // Rebuild the transforms of the even and odd samples, packed as one
+    // complex spectrum, and conjugate it so the forward FFT inverts it
+    for ( unsigned k=0; k<h; ++k ) {
+      double ar = re[k], ai = im[k];
+      double br = re[h-k], bi = -im[h-k];
+      double er = s*(ar + br), ei = s*(ai + bi);
+      double dr = s*(ar - br), di = s*(ai - bi);
+      double orr = dr*_rr[k] + di*_ri[k];
+      double oi = di*_rr[k] - dr*_ri[k];
+      zr[k] = er - oi;
+      zi[k] = -(ei + orr);
+    }
+    complex( zr, zi );
+    for ( unsigned j=0; j<h; ++j ) {
+      out[2*j] = zr[j];
+      out[2*j+1] = -zi[j];
+    }
+  }
+
+private:
+  static void pass( double* __restrict ar, double* __restrict ai,
+                    double* __restrict br, double* __restrict bi,
+                    const double* __restrict wr, const double* __restrict wi, unsigned m ) {
+    for ( unsigned j=0; j<m; ++j ) {
+      double tr = br[j]*wr[j] - bi[j]*wi[j];
+      double ti = br[j]*wi[j] + bi[j]*wr[j];
+      br[j] = ar[j] - tr;
+      bi[j] = ai[j] - ti;
+      ar[j] = ar[j] + tr;
+      ai[j] = ai[j] + ti;
+    }
+  }
+
+  unsigned _n;
+  unsigned _h;
+  std::vector<double> _wr, _wi;   // exp(-pi i j/m) for every stage
+  std::vector<double> _rr, _ri;   // exp(-2 pi i k/n) for real()
+  std::vector<unsigned> _rev;
+  std::vector<double> _zr, _zi;
+};
+
+/*******************************************************************
+Short time Fourier transform. Frames of size() samples, Hann windowed,
+start every hop samples, at least one; each produces size()/2+1
+magnitudes in dB. Samples are pushed in blocks of any size, frames are
+handed to the callback as soon as they are complete.
+*******************************************************************/
+class Spectrogram
+{
+public:
+  Spectrogram( unsigned n, unsigned hop )
+    : _fft( n ), _hop( hop<1 ? 1 : hop ), _frame( 0 ), _skip( 0 )
+  {
+    _window.resize( n );
+    double sum = 0;
+    for ( unsigned j=0; j<n; ++j ) {
+      _window[j] = 0.5 - 0.5*cos( 2*M_PI*j/n );
+      sum += _window[j];
+    }
+    // Full scale sine reads 0 dB
+    _scale = 2/sum;
+    _buf.reserve( 2*n );
+    _x.resize( n );
+    _re.resize( n/2+1 );
+    _im.resize( n/2+1 );
+    _db.resize( n/2+1 );
+  }
+
+  unsigned size() const { return _fft.size(); }
+  unsigned bins() const { return _fft.size()/2+1; }
+  unsigned hop() const { return _hop; }
+
+  // frame(index, db) is called for every completed frame
+  template< typename Frame >
+  void add( const double* samples, size_t n, Frame frame ) {
+    unsigned N = _fft.size();
+    while ( n>0 ) {
+      if ( _skip>0 ) {
+        // Frames further apart than their size skip the gap
+        size_t s = _skip < n ? _skip : n;
+        samples += s;
+        n -= s;
+        _skip -= s;
+        continue;
+      }
+      size_t take = N - _buf.size() < n ? N - _buf.size() : n;
+      _buf.insert( _buf.end(), samples, samples + take );
+      samples += take;
+      n -= take;
+      if ( _buf.size() < N ) break;
+      for ( unsigned j=0; j<N; ++j ) _x[j] = _buf[j]*_window[j];
+      _fft.real( &_x[0], &_re[0], &_im[0] );
+      for ( unsigned k=0; k<_re.size(); ++k ) {
+        double p = (_re[k]*_re[k] + _im[k]*_im[k])*(_scale*_scale);
+        _db[k] = 10*log10( p + 1E-30 );
+      }
+      frame( _frame++, _db );
+      if ( _hop < N ) _buf.erase( _buf.begin(), _buf.begin() + _hop );
+      else {
+        _buf.clear();
+        _skip = _hop - N;
+      }
+    }
+  }
+
+private:
+  FFT _fft;
+  unsigned _hop;
+  uint64_t _frame;
+  size_t _skip;
+  double _scale;
+  std::vector<double> _window;
+  std::vector<double> _buf;
+  std::vector<double> _x, _re, _im;
+  std::vector<double> _db;
+};
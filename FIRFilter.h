@@ -0,0 +1,192 @@
+#pragma once
+#include "FFT.h"
+#include <math.h>
+#include <stddef.h>
+#include <vector>
+
+/*******************************************************************
+Linear phase FIR filter with the add()/process() interface of
+BandPassFilter. add() evaluates the taps directly; process() uses
+overlap-save fast convolution, so long filters cost O(log N) per
+sample instead of O(N).
+
+The input is kept as the last N-1 samples followed by the chunk being
+filled, M samples in all. Once the chunk is full its outputs are the
+last B = M-N+1 points of the circular convolution of those M samples
+with the taps, one real FFT, a product with the transform of the taps
+and one inverse FFT. M is the power of two that makes this cheapest
+per output sample. Both paths agree to rounding.
+*******************************************************************/
+class FIRFilter
+{
+public:
+    // Band pass from fc-bw/2 to fc+bw/2, normalized frequencies, with unit
+    // gain at fc. An odd ntaps puts the delay on a whole sample.
+    FIRFilter( double fc, double bw, unsigned ntaps )
+    : FIRFilter( design( fc, bw, ntaps ) ) {}
+
+    FIRFilter( const std::vector<double>& taps )
+    : _taps( taps.empty() ? std::vector<double>( 1, 1.0 ) : taps ), _fft( fftSize( _taps.size() ) )
+    {
+        size_t N = _taps.size();
+        _M = _fft.size();
+        _B = _M - (N-1);
+        _rev.resize( N );
+        for ( size_t j=0; j<N; ++j ) _rev[j] = _taps[N-1-j];
+        _buf.resize( _M );
+        _y.resize( _M );
+        _re.resize( _M/2+1 );
+        _im.resize( _M/2+1 );
+        _hre.resize( _M/2+1 );
+        _him.resize( _M/2+1 );
+        std::vector<double> padded( _M, 0.0 );
+        for ( size_t j=0; j<N; ++j ) padded[j] = _taps[j];
+        _fft.real( &padded[0], &_hre[0], &_him[0] );
+        reset();
+    }
+
+    // Blackman windowed difference of two sincs
+    static std::vector<double> design( double fc, double bw, unsigned ntaps ) {
+        if ( ntaps<1 ) ntaps = 1;
+        std::vector<double> h( ntaps );
+        double f1 = fc - bw/2.0;
+        double f2 = fc + bw/2.0;
+        double c = 0.5*(ntaps-1);
+        for ( unsigned m=0; m<ntaps; ++m ) {
+            double t = m - c;
+            double w = ntaps>1 ? 0.42 - 0.5*cos( 2*M_PI*m/(ntaps-1) ) + 0.08*cos( 4*M_PI*m/(ntaps-1) ) : 1.0;
+            double v = t==0 ? 2*(f2-f1) : (sin( 2*M_PI*f2*t ) - sin( 2*M_PI*f1*t ))/(M_PI*t);
+            h[m] = w*v;
+        }
+        // Response at fc, measured at the center of the filter
+        double re = 0, im = 0;
+        for ( unsigned m=0; m<ntaps; ++m ) {
+            re += h[m]*cos( 2*M_PI*fc*(m-c) );
+            im -= h[m]*sin( 2*M_PI*fc*(m-c) );
+        }
+        double g = sqrt( re*re + im*im );
+        if ( g>0 ) for ( unsigned m=0; m<ntaps; ++m ) h[m] /= g;
+        return h;
+    }
+
+    double add( double sig ) {
+        size_t N = _taps.size();
+        _buf[N-1+_fill] = sig;
+        _value = dot( &_rev[0], &_buf[_fill], N );
+        if ( ++_fill==_B ) shift();
+        return _value;
+    }
+
+    // Block version of add(), same outputs to rounding. in and out may be
+    // the same buffer.
+    void process( const double* in, double* out, size_t n ) {
+        size_t N = _taps.size();
+        while ( n>0 ) {
+            size_t r = _B - _fill;
+            if ( n>=r ) {
+                for ( size_t j=0; j<r; ++j ) _buf[N-1+_fill+j] = in[j];
+                convolve( _fill, r, out );
+                shift();
+            }
+            else if ( n*N > 4*_M ) {
+                // Long tail: convolve with the rest of the chunk at zero
+                r = n;
+                for ( size_t j=0; j<r; ++j ) _buf[N-1+_fill+j] = in[j];
+                for ( size_t j=N-1+_fill+r; j<_M; ++j ) _buf[j] = 0;
+                convolve( _fill, r, out );
+                _fill += r;
+            }
+            else {
+                r = n;
+                for ( size_t j=0; j<r; ++j ) out[j] = add( in[j] );
+            }
+            in += r;
+            out += r;
+            n -= r;
+        }
+    }
+
+    void reset() {
+        for ( size_t j=0; j<_buf.size(); ++j ) _buf[j] = 0;
+        _fill = 0;
+        _value = 0;
+    }
+
+    double value() const {
+        return _value;
+    }
+
+    const std::vector<double>& taps() const {
+        return _taps;
+    }
+
+    // Group delay in samples of symmetric taps
+    double delay() const {
+        return 0.5*(_taps.size()-1);
+    }
+
+    // Transform size used for N taps: minimizes M log2(M) / (M-N+1)
+    static unsigned fftSize( size_t N ) {
+        unsigned best = 0;
+        double best_cost = 0;
+        unsigned m = 2;
+        while ( m < 2*N ) m *= 2;
+        for ( int k=0; k<5; ++k, m*=2 ) {
+            double cost = m*log2( double(m) )/(m - N + 1);
+            if ( (best==0) || (cost<best_cost) ) {
+                best = m;
+                best_cost = cost;
+            }
+        }
+        return best;
+    }
+
+private:
+    static double dot( const double* __restrict a, const double* __restrict b, size_t n ) {
+        // Four partial sums so the loop vectorizes without reassociation
+        double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        size_t j = 0;
+        for ( ; j+4<=n; j+=4 ) {
+            s0 += a[j]*b[j];
+            s1 += a[j+1]*b[j+1];
+            s2 += a[j+2]*b[j+2];
+            s3 += a[j+3]*b[j+3];
+        }
+        for ( ; j<n; ++j ) s0 += a[j]*b[j];
+        return (s0 + s1) + (s2 + s3);
+    }
+
+    // Writes the outputs for chunk positions [first, first+count)
+    void convolve( size_t first, size_t count, double* out ) {
+        size_t N = _taps.size();
+        _fft.real( &_buf[0], &_re[0], &_im[0] );
+        for ( size_t k=0; k<_re.size(); ++k ) {
+            double r = _re[k]*_hre[k] - _im[k]*_him[k];
+            double i = _re[k]*_him[k] + _im[k]*_hre[k];
+            _re[k] = r;
+            _im[k] = i;
+        }
+        _fft.inverse( &_re[0], &_im[0], &_y[0] );
+        for ( size_t j=0; j<count; ++j ) out[j] = _y[N-1+first+j];
+        if ( count>0 ) _value = out[count-1];
+    }
+
+    // Chunk is full: its last N-1 samples become the history
+    void shift() {
+        size_t N = _taps.size();
+        for ( size_t j=0; j+1<N; ++j ) _buf[j] = _buf[_B+j];
+        _fill = 0;
+    }
+
+    std::vector<double> _taps;
+    std::vector<double> _rev;          // taps in reverse order for add()
+    FFT _fft;
+    size_t _M;
+    size_t _B;
+    size_t _fill;                      // samples in the current chunk
+    double _value;
+    std::vector<double> _buf;          // N-1 history samples, then the chunk
+    std::vector<double> _y;
+    std::vector<double> _re, _im;
+    std::vector<double> _hre, _him;    // transform of the taps
+};
@@ -0,0 +1,398 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "FileUtils.h"
+#include "LowPassFilters.h"
+#include "Resampler.h"
+#include "SoundDecoder.h"
+
+/*******************************************************************
+Fixed point version of the baseband decoder, fed 16 bit samples
+straight from a SampleArray.
+
+Formats and headroom:
+ - Samples, the local oscillator, the mixer outputs, the filter taps
+   and the baseband samples are Q15 (int16, full scale 1). The mixer
+   rounds like _mm256_mulhrs_epi16. The oscillator stops at 32767, so
+   no product overflows.
+ - The decimating filter sums Q30 products in int32 lanes. Its taps
+   add up to 1 and their magnitudes to well under 2, so the sums
+   stay below 2^31. The result is rounded to Q15 and saturated; only
+   a full scale input that happens to match the filter's signs can
+   clip.
+ - The loop rotates each baseband sample by a Q15 sine and cosine
+   into Q30; |i| and |q| stay below 1.52*2^30. It then drops 8 bits
+   (Q22) before the biquads, whose Q30 coefficients and int64 sums
+   then have more than 6 bits of headroom. Error and lock are Q15.
+ - Phase is a uint32, 2^32 per turn, so it wraps for free. The
+   frequency integrator carries 16 more fractional bits in an int64.
+
+Noise: the mixer and filter each add half an LSB of rounding, about
+-101 dBFS. The 4096 entry sine table puts at most 0.044 degrees of
+error on the loop's reference. testFixedPoint runs the same recording
+through this decoder and BasebandSoundDecoder and reports how far
+apart their phases and frequencies are.
+
+With AVX2 the mixer and filter work on 16 int16 lanes at a time, and
+the scalar loops compute exactly the same integers.
+*******************************************************************/
+
+static inline int16_t saturate16( int32_t v )
+{
+  return v > 32767 ? 32767 : (v < -32768 ? -32768 : int16_t(v));
+}
+
+static inline int32_t saturate32( int64_t v )
+{
+  return v > INT32_MAX ? INT32_MAX : (v < INT32_MIN ? INT32_MIN : int32_t(v));
+}
+
+// Q15 product rounded to Q15, as _mm256_mulhrs_epi16
+static inline int16_t mulQ15( int16_t a, int16_t b )
+{
+  return int16_t( (int32_t(a)*b + 0x4000) >> 15 );
+}
+
+/*******************************************************************
+Biquad with Q30 coefficients on int32 samples, the sums kept in int64.
+The coefficients are b0, b1, b2, a1, a2 as BiquadLowPassFilter gives
+them.
+*******************************************************************/
+struct FixedBiquad
+{
+  FixedBiquad() {}
+  FixedBiquad( const double c[5] ) { init( c ); }
+
+  void init( const double c[5] ) {
+    for ( int j=0; j<5; ++j ) k[j] = int32_t( lrint( c[j]*(1<<30) ) );
+    reset();
+  }
+
+  int32_t add( int32_t x0 ) {
+    int64_t acc = int64_t(k[0])*x0 + int64_t(k[1])*x1 + int64_t(k[2])*x2
+                - int64_t(k[3])*y1 - int64_t(k[4])*y2;
+    int32_t y0 = saturate32( (acc + (1<<29)) >> 30 );
+    x2 = x1;
+    x1 = x0;
+    y2 = y1;
+    y1 = y0;
+    return y0;
+  }
+
+  void reset() {
+    x1 = x2 = y1 = y2 = 0;
+  }
+
+  int32_t k[5];
+  int32_t x1, x2, y1, y2;
+};
+
+/*******************************************************************
+LowPassFilter in fixed point: the step towards the input is scaled by
+1/(1+tau) in Q22, and the state keeps 16 bits below the input's LSB.
+Inputs must stay below 2^23 in magnitude.
+*******************************************************************/
+struct FixedLowPass
+{
+  FixedLowPass( double tau ) {
+    k = int64_t( llrint( 4194304.0/(1.0 + tau) ) );
+    reset();
+  }
+
+  int32_t add( int32_t x ) {
+    int64_t d = (int64_t(x) << 16) - y;
+    y += (d*k) >> 22;
+    return int32_t( y >> 16 );
+  }
+
+  void reset() {
+    y = 0;
+  }
+
+  int64_t k;
+  int64_t y;
+};
+
+/*******************************************************************
+Decimation by D of Q15 samples with the taps of PolyphaseResampler( D,
+1, taps, cutoff ) in Q15, so it keeps the same outputs at the same
+delay. The taps are padded at the old end to a multiple of 16.
+*******************************************************************/
+class FixedDecimator
+{
+public:
+  FixedDecimator( uint32_t decim, unsigned taps = 10, double cutoff = 1.0 ) {
+    PolyphaseResampler ref( decim, 1, taps, cutoff );
+    _D = ref.down();
+    const std::vector<double>& h( ref.taps() );
+    size_t K = h.size();
+    _K = (K + 15) & ~size_t(15);
+    _h.assign( _K, 0 );
+    for ( size_t j=0; j<K; ++j ) _h[_K-K+j] = saturate16( int32_t( lrint( h[j]*32768 ) ) );
+    _delay = ref.delay();
+    reset();
+  }
+
+  void reset() {
+    _buf.assign( _K-1, 0 );
+    _next = _K-1;
+  }
+
+  uint32_t decim() const { return _D; }
+  double delay() const { return _delay; }
+
+  size_t outputs( size_t n ) const {
+    return n/_D + 1;
+  }
+
+  // Decimates n samples into out, which must hold outputs(n) values.
+  // Returns the number of values written.
+  size_t process( const int16_t* in, size_t n, int16_t* out ) {
+    _buf.insert( _buf.end(), in, in+n );
+    size_t count = 0;
+    size_t size = _buf.size();
+    const int16_t* buf = &_buf[0];
+    while ( _next < size ) {
+      int32_t acc = dot( &_h[0], buf + _next+1 - _K, _K );
+      out[count++] = saturate16( (acc + (1<<14)) >> 15 );
+      _next += _D;
+    }
+    size_t drop = _next+1 - _K;
+    if ( drop>size ) drop = size;
+    _buf.erase( _buf.begin(), _buf.begin() + drop );
+    _next -= drop;
+    return count;
+  }
+
+private:
+  // n is a multiple of 16
+  static int32_t dot( const int16_t* a, const int16_t* b, size_t n ) {
+#ifdef __AVX2__
+    __m256i acc = _mm256_setzero_si256();
+    for ( size_t j=0; j<n; j+=16 ) {
+      __m256i va = _mm256_loadu_si256( (const __m256i*)(a+j) );
+      __m256i vb = _mm256_loadu_si256( (const __m256i*)(b+j) );
+      acc = _mm256_add_epi32( acc, _mm256_madd_epi16( va, vb ) );
+    }
+    __m128i s = _mm_add_epi32( _mm256_castsi256_si128( acc ), _mm256_extracti128_si256( acc, 1 ) );
+    s = _mm_add_epi32( s, _mm_shuffle_epi32( s, 0x4E ) );
+    s = _mm_add_epi32( s, _mm_shuffle_epi32( s, 0xB1 ) );
+    return _mm_cvtsi128_si32( s );
+#else
+    int32_t acc = 0;
+    for ( size_t j=0; j<n; ++j ) acc += int32_t(a[j])*b[j];
+    return acc;
+#endif
+  }
+
+  uint32_t _D;
+  size_t _K;
+  double _delay;
+  std::vector<int16_t> _h;
+  std::vector<int16_t> _buf;
+  size_t _next;
+};
+
+/*******************************************************************
+BasebandConverter in fixed point. The oscillator is a table over one
+period of the carrier, carrier_hz/sample_hz in lowest terms, extended
+by 16 entries so a block of 16 never wraps.
+*******************************************************************/
+class FixedBasebandConverter
+{
+public:
+  FixedBasebandConverter( uint32_t carrier_hz, uint32_t sample_hz, uint32_t decim, unsigned taps = 10, double cutoff = 1.0 )
+    : _i( decim, taps, cutoff ), _q( decim, taps, cutoff ), _pos( 0 )
+  {
+    uint32_t a = sample_hz, b = carrier_hz;
+    while ( b!=0 ) {
+      uint32_t t = a % b;
+      a = b;
+      b = t;
+    }
+    _period = sample_hz/(a==0 ? 1 : a);
+    _cos.resize( _period+16 );
+    _nsin.resize( _period+16 );
+    for ( uint32_t j=0; j<_period+16; ++j ) {
+      double w = 2*M_PI*(double(carrier_hz)*(j % _period) / sample_hz);
+      _cos[j] = int16_t( lrint( 32767*cos( w ) ) );
+      _nsin[j] = int16_t( lrint( -32767*sin( w ) ) );
+    }
+  }
+
+  uint32_t decim() const { return _i.decim(); }
+  double delay() const { return _i.delay(); }
+
+  size_t outputs( size_t n ) const {
+    return _i.outputs( n );
+  }
+
+  // Converts n samples into out_i and out_q, which must hold outputs(n)
+  // values each. Returns the number of values written.
+  size_t process( const int16_t* in, size_t n, int16_t* out_i, int16_t* out_q ) {
+    if ( _ib.size() < n+16 ) {
+      _ib.resize( n+16 );
+      _qb.resize( n+16 );
+    }
+    size_t j = 0;
+#ifdef __AVX2__
+    for ( ; j+16<=n; j+=16 ) {
+      __m256i x = _mm256_loadu_si256( (const __m256i*)(in+j) );
+      __m256i c = _mm256_loadu_si256( (const __m256i*)(&_cos[_pos]) );
+      __m256i s = _mm256_loadu_si256( (const __m256i*)(&_nsin[_pos]) );
+      _mm256_storeu_si256( (__m256i*)(&_ib[j]), _mm256_mulhrs_epi16( x, c ) );
+      _mm256_storeu_si256( (__m256i*)(&_qb[j]), _mm256_mulhrs_epi16( x, s ) );
+      _pos = (_pos + 16) % _period;
+    }
+#endif
+    for ( ; j<n; ++j ) {
+      _ib[j] = mulQ15( in[j], _cos[_pos] );
+      _qb[j] = mulQ15( in[j], _nsin[_pos] );
+      if ( ++_pos==_period ) _pos = 0;
+    }
+    size_t m = _i.process( &_ib[0], n, out_i );
+    _q.process( &_qb[0], n, out_q );
+    return m;
+  }
+
+private:
+  FixedDecimator _i;
+  FixedDecimator _q;
+  uint32_t _period;
+  uint32_t _pos;
+  std::vector<int16_t> _cos, _nsin;
+  std::vector<int16_t> _ib, _qb;
+};
+
+/*******************************************************************
+BasebandCostasLoop in fixed point, with the same parameters. The
+outputs are converted to the units of BasebandCostasLoop.
+*******************************************************************/
+class FixedCostasLoop
+{
+public:
+  static const unsigned TABLE_BITS = 12;
+  static const unsigned TABLE_SIZE = 1u<<TABLE_BITS;
+
+  FixedCostasLoop( double fnat = 0.01, double zeta = 1.0/sqrt(2.0), double fcut = 0.05, double tau = 20 )
+    : _lock_rc( tau ), _freq_rc( tau )
+  {
+    double wn = 2*M_PI*fnat;
+    // Phase steps in 2^32 per turn for a Q15 error, the frequency with
+    // 16 more bits
+    _kp = int64_t( llrint( 2*zeta*wn/(2*M_PI)*4294967296.0 ) );
+    _ki = int64_t( llrint( wn*wn/(2*M_PI)*4294967296.0*65536.0 ) );
+    BiquadLowPassFilter lp( 1.0/sqrt(2.0), fcut );
+    double c[5];
+    lp.coefficients( c );
+    _ilp.init( c );
+    _qlp.init( c );
+    _cos.resize( TABLE_SIZE );
+    _sin.resize( TABLE_SIZE );
+    for ( unsigned j=0; j<TABLE_SIZE; ++j ) {
+      _cos[j] = int16_t( lrint( 32767*cos( 2*M_PI*j/TABLE_SIZE ) ) );
+      _sin[j] = int16_t( lrint( 32767*sin( 2*M_PI*j/TABLE_SIZE ) ) );
+    }
+    reset();
+  }
+
+  void reset() {
+    _theta = 0;
+    _omega = 0;
+    _ilp.reset();
+    _qlp.reset();
+    _lock_rc.reset();
+    _freq_rc.reset();
+    phase = freq = error = lock = 0;
+  }
+
+  void add( int16_t zr, int16_t zi ) {
+    unsigned t = ((_theta + (1u<<(31-TABLE_BITS))) >> (32-TABLE_BITS)) & (TABLE_SIZE-1);
+    int32_t cs = _cos[t], sn = _sin[t];
+    int32_t i = _ilp.add( (zr*cs + zi*sn) >> 8 );
+    int32_t q = _qlp.add( (zi*cs - zr*sn) >> 8 );
+    // One divide for both: |i q| <= p/2 and |i^2-q^2| <= p, so neither
+    // product with 2^62/p overflows, and the reciprocal is good to 2^-15
+    int64_t p = int64_t(i)*i + int64_t(q)*q;
+    int64_t inv = p > 0 ? (int64_t(1)<<62)/p : 0;
+    int32_t e = int32_t( (int64_t(i)*q*inv) >> 47 );
+    int32_t l = int32_t( ((int64_t(i)*i - int64_t(q)*q)*inv) >> 47 );
+    _omega += _ki*e >> 15;
+    _theta += uint32_t( (_omega >> 16) + (_kp*e >> 15) );
+    error = e*(1.0/32768);
+    lock = _lock_rc.add( l )*(1.0/32768);
+    phase = _theta*(2*M_PI/4294967296.0);
+    freq = _freq_rc.add( int32_t( _omega >> 24 ) )*(1.0/16777216.0);
+  }
+
+  void process( const int16_t* zr, const int16_t* zi, size_t n ) {
+    for ( size_t j=0; j<n; ++j ) add( zr[j], zi[j] );
+  }
+
+  // Outputs
+  double phase;
+  double freq;
+  double error;
+  double lock;
+
+private:
+  int64_t _kp;
+  int64_t _ki;
+  uint32_t _theta;
+  int64_t _omega;
+  FixedBiquad _ilp;
+  FixedBiquad _qlp;
+  FixedLowPass _lock_rc;
+  FixedLowPass _freq_rc;
+  std::vector<int16_t> _cos, _sin;
+};
+
+/*******************************************************************
+BasebandSoundDecoder in fixed point, fed 16 bit samples.
+*******************************************************************/
+class FixedBasebandDecoder
+{
+public:
+  FixedBasebandDecoder( uint32_t sample_hz, FILE* out = stdout )
+    : _front( SoundDecoder::CARRIER_HZ, sample_hz, sample_hz/SoundDecoder::CARRIER_HZ ),
+      _cycle( 0 ),
+      _out( out ) {}
+
+  void add( const int16_t* wav, size_t n ) {
+    if ( _zr.size() < _front.outputs( n ) ) {
+      _zr.resize( _front.outputs( n ) );
+      _zi.resize( _front.outputs( n ) );
+    }
+    size_t m = _front.process( wav, n, &_zr[0], &_zi[0] );
+    for ( size_t k=0; k<m; ++k ) {
+      _loop.add( _zr[k], _zi[k] );
+      DecodedCycle c;
+      c.cycle = _cycle++;
+      c.freq = (1 + _loop.freq)*SoundDecoder::CARRIER_HZ;
+      c.phase = _loop.phase*180/M_PI;
+      c.error = _loop.error;
+      c.lock = _loop.lock;
+      if ( _out ) SoundDecoder::print( _out, c );
+      else cycles.push_back( c );
+    }
+  }
+
+  void add( const SampleArray& wav ) {
+    if ( !wav.empty() ) add( &wav[0], wav.size() );
+  }
+
+  std::vector<DecodedCycle> cycles;
+
+private:
+  FixedBasebandConverter _front;
+  FixedCostasLoop _loop;
+  std::vector<int16_t> _zr, _zi;
+  uint32_t _cycle;
+  FILE* _out;
+};
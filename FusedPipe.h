@@ -0,0 +1,217 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "CostasLoop.h"
+#include "SoundDecoder.h"
+
+/*******************************************************************
+Compile time composition of per sample stages. pipe( a, b, c ) builds
+one object whose add() and process() run every sample through a, b
+and c in a single inner loop the compiler can inline end to end, with
+no buffers between the stages. A stage is any of:
+
+  - a filter, with U add( V ), such as BandPassFilter or CostasLoop;
+    what it returns goes on to the next stage
+  - a sink, with void add( V ), such as CordicQueueIntegrator or
+    GoertzelArray; nothing after it is fed
+  - a lambda or other callable, a filter or sink by what it returns
+  - a stage with template< typename Next > void push( V, Next& ) that
+    calls next( u ) as often as it has outputs, none to several per
+    input: Decimator and CycleSlicer below
+
+process() cuts the input into tiles of TILE samples. The leading
+stages that also have a block void process( const T*, T*, size_t ),
+such as BandPassFilter, run over whole tiles held on the stack, which
+lets them use their faster block paths; the rest of the chain runs
+per sample from there. Lvalue stages are held by reference, so their
+state can be read after the pipe has run; temporaries are moved in.
+*******************************************************************/
+
+namespace fused {
+
+template< unsigned N > struct Priority : Priority<N-1> {};
+template<> struct Priority<0> {};
+
+// The overload taken is the first of these that compiles for the stage
+template< typename S, typename V, typename Next >
+auto step( S& s, V v, Next& next, Priority<4> ) -> decltype( s.push( v, next ), void() ) {
+  s.push( v, next );
+}
+template< typename S, typename V, typename Next >
+auto step( S& s, V v, Next& next, Priority<3> ) -> decltype( next( s.add( v ) ), void() ) {
+  next( s.add( v ) );
+}
+template< typename S, typename V, typename Next >
+auto step( S& s, V v, Next&, Priority<2> ) -> decltype( s.add( v ), void() ) {
+  s.add( v );
+}
+template< typename S, typename V, typename Next >
+auto step( S& s, V v, Next& next, Priority<1> ) -> decltype( next( s( v ) ), void() ) {
+  next( s( v ) );
+}
+template< typename S, typename V, typename Next >
+auto step( S& s, V v, Next&, Priority<0> ) -> decltype( s( v ), void() ) {
+  s( v );
+}
+
+// Whether S has a block process( const T*, T*, size_t )
+template< typename S, typename T >
+struct HasBlock
+{
+  template< typename U >
+  static char test( decltype( std::declval<U&>().process( (const T*)0, (T*)0, size_t( 0 ) ) )* );
+  template< typename U >
+  static long test( ... );
+  static const bool value = sizeof( test<S>( 0 ) )==1;
+};
+
+}
+
+template< typename T, typename... S >
+class FusedPipe
+{
+public:
+  static const size_t TILE = 256;
+
+  FusedPipe( S&&... stages ) : _stages( std::forward<S>( stages )... ) {}
+
+  void add( T x ) {
+    feed<0>( x );
+  }
+
+  void process( const T* x, size_t n ) {
+    for ( size_t m=0; m<n; m+=TILE ) tile<0>( x+m, n-m < TILE ? n-m : TILE );
+  }
+
+  template< size_t I >
+  using Stage = typename std::remove_reference<typename std::tuple_element<I, std::tuple<S...> >::type>::type;
+
+  // Stage I, to read its state
+  template< size_t I >
+  Stage<I>& stage() {
+    return std::get<I>( _stages );
+  }
+
+private:
+  static const size_t N = sizeof...(S);
+
+  // Whether stage I exists and runs on whole tiles
+  template< size_t I, bool = (I<N) >
+  struct Block { static const bool value = false; };
+  template< size_t I >
+  struct Block<I, true> { static const bool value = fused::HasBlock<Stage<I>, T>::value; };
+
+  // Feeds stage I, or drops what the last stage put out
+  template< size_t I >
+  struct Next
+  {
+    FusedPipe* pipe;
+    template< typename V >
+    void operator()( V v ) const { pipe->template feed<I>( v ); }
+  };
+
+  template< size_t I, typename V >
+  typename std::enable_if<(I<N)>::type feed( V v ) {
+    Next<I+1> next = { this };
+    fused::step( std::get<I>( _stages ), v, next, fused::Priority<4>() );
+  }
+  template< size_t I, typename V >
+  typename std::enable_if<(I>=N)>::type feed( V ) {}
+
+  template< size_t I >
+  typename std::enable_if<Block<I>::value>::type tile( const T* in, size_t n ) {
+    T out[TILE];
+    std::get<I>( _stages ).process( in, out, n );
+    tile<I+1>( out, n );
+  }
+  template< size_t I >
+  typename std::enable_if<(I<N) && !Block<I>::value>::type tile( const T* in, size_t n ) {
+    for ( size_t k=0; k<n; ++k ) feed<I>( in[k] );
+  }
+  template< size_t I >
+  typename std::enable_if<(I>=N)>::type tile( const T*, size_t ) {}
+
+  std::tuple<S...> _stages;
+};
+
+// pipe<float>( ... ) for a float input
+template< typename T = double, typename... S >
+FusedPipe<T, S...> pipe( S&&... stages )
+{
+  return FusedPipe<T, S...>( std::forward<S>( stages )... );
+}
+
+/*******************************************************************
+Keeps one sample in factor: the mean of each factor inputs, which
+takes out what would alias from the band the carrier is in, at the
+cost of a sinc droop on it.
+*******************************************************************/
+template< typename T >
+class DecimatorT
+{
+public:
+  DecimatorT( uint32_t factor ) : _factor( factor<1 ? 1 : factor ), _count( 0 ), _sum( 0 ) {}
+
+  template< typename Next >
+  void push( T x, Next& next ) {
+    _sum += x;
+    if ( ++_count >= _factor ) {
+      next( _sum/T(_factor) );
+      _count = 0;
+      _sum = 0;
+    }
+  }
+
+private:
+  uint32_t _factor;
+  uint32_t _count;
+  T _sum;
+};
+
+typedef DecimatorT<double> Decimator;
+typedef DecimatorT<float> DecimatorF;
+
+/*******************************************************************
+Follows a CostasLoop that runs in the stage before it and puts out a
+DecodedCycle at the end of every carrier cycle, read off the loop the
+way SoundDecoder does. sample_hz is the rate the loop runs at.
+*******************************************************************/
+template< typename T >
+class CycleSlicerT
+{
+public:
+  CycleSlicerT( const CostasLoopT<T>& loop, double sample_hz )
+    : _loop( loop ),
+      _sample_hz( sample_hz ),
+      _carrier_samples( sample_hz/SoundDecoder::CARRIER_HZ ),
+      _counter( 0 ),
+      _cycle( 0 )
+  {}
+
+  template< typename Next >
+  void push( T, Next& next ) {
+    if ( ++_counter >= _carrier_samples ) {
+      _counter -= _carrier_samples;
+      DecodedCycle c;
+      c.cycle = _cycle++;
+      c.freq = _loop.freq*_sample_hz;
+      c.phase = _loop.phase*180/M_PI;
+      c.error = _loop.error;
+      c.lock = _loop.lock;
+      next( c );
+    }
+  }
+
+private:
+  const CostasLoopT<T>& _loop;
+  double _sample_hz;
+  uint32_t _carrier_samples;
+  uint32_t _counter;
+  uint32_t _cycle;
+};
+
+typedef CycleSlicerT<double> CycleSlicer;
+typedef CycleSlicerT<float> CycleSlicerF;
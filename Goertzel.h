@@ -0,0 +1,256 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+/*******************************************************************
+Tone analysis over many frequencies, with the same mag() and phase()
+as DCTArray but without trig per sample. State is kept as arrays with
+one entry per bin, so the loops over bins vectorize.
+
+Whole-block mode (window==0) correlates everything since reset() with
+the Goertzel recurrence, two adds and a multiply per bin and sample.
+Every FLUSH samples the recurrence is folded into the running sums and
+restarted, which keeps its rounding error from growing with length.
+
+Sliding mode (window>0) correlates the last window samples, with the
+phase measured at the oldest of them, using a sliding DFT. The sums
+are recomputed from the kept samples once per window so rotation
+errors do not accumulate.
+*******************************************************************/
+class GoertzelArray
+{
+public:
+  static const uint32_t FLUSH = 1024;
+
+  // mag() and phase() of one bin
+  class Bin
+  {
+  public:
+    Bin( const GoertzelArray& arr, unsigned j ) : _arr( arr ), _j( j ) {}
+    double mag() const { return _arr.mag( _j ); }
+    double phase() const { return _arr.phase( _j ); }
+  private:
+    const GoertzelArray& _arr;
+    unsigned _j;
+  };
+
+  GoertzelArray( const std::vector<double>& freqs, uint32_t window = 0 ) {
+    init( freqs, window );
+  }
+
+  void init( const std::vector<double>& freqs, uint32_t window = 0 ) {
+    size_t N = freqs.size();
+    _window = window;
+    _w.resize( N );
+    _coef.resize( N );
+    _rot_re.resize( N );
+    _rot_im.resize( N );
+    _last_re.resize( N );
+    _last_im.resize( N );
+    for ( size_t j=0; j<N; ++j ) {
+      _w[j] = 2*M_PI*freqs[j];
+      _coef[j] = 2*cos( _w[j] );
+      _rot_re[j] = cos( _w[j] );
+      _rot_im[j] = sin( _w[j] );
+      _last_re[j] = cos( _w[j]*(window>0 ? window-1 : 0) );
+      _last_im[j] = -sin( _w[j]*(window>0 ? window-1 : 0) );
+    }
+    _s1.resize( N );
+    _s2.resize( N );
+    _re.resize( N );
+    _im.resize( N );
+    _p_re.resize( N );
+    _p_im.resize( N );
+    _ring.resize( window );
+    reset();
+  }
+
+  void reset() {
+    for ( size_t j=0; j<_w.size(); ++j ) {
+      _s1[j] = _s2[j] = 0;
+      _re[j] = _im[j] = 0;
+      _p_re[j] = 1;
+      _p_im[j] = 0;
+    }
+    for ( size_t j=0; j<_ring.size(); ++j ) _ring[j] = 0;
+    _counter = 0;
+    _block = 0;
+    _pos = 0;
+  }
+
+  size_t size() const {
+    return _w.size();
+  }
+
+  void add( double value ) {
+    if ( _window==0 ) {
+      goertzel( &value, 1 );
+    }
+    else {
+      slide( value );
+    }
+  }
+
+  // Same as calling add() for every value, faster in whole-block mode
+  void add( const double* values, size_t n ) {
+    if ( _window==0 ) {
+      while ( n>0 ) {
+        size_t len = FLUSH - _block < n ? FLUSH - _block : n;
+        goertzel( values, len );
+        values += len;
+        n -= len;
+      }
+    }
+    else {
+      for ( size_t j=0; j<n; ++j ) slide( values[j] );
+    }
+  }
+
+  double mag( unsigned j ) const {
+    double re, im;
+    sums( j, re, im );
+    uint64_t n = (_window>0) && (_counter>_window) ? _window : _counter;
+    return ::sqrt( (re*re + im*im)/n );
+  }
+
+  double phase( unsigned j ) const {
+    double re, im;
+    sums( j, re, im );
+    // 0-im keeps a zero sine sum positive, as in DCT
+    return ::atan2( 0.0 - im, re );
+  }
+
+  Bin operator []( unsigned j ) const {
+    return Bin( *this, j );
+  }
+
+private:
+  // Runs the recurrence over n values, all in the current block unless
+  // the ring is being recomputed
+  void goertzel( const double* values, size_t n, bool block = true ) {
+    size_t N = _w.size();
+    const double* coef = &_coef[0];
+    double* s1 = &_s1[0];
+    double* s2 = &_s2[0];
+    for ( size_t k=0; k<n; ++k ) {
+      double x = values[k];
+      for ( size_t j=0; j<N; ++j ) {
+        double s0 = x + coef[j]*s1[j] - s2[j];
+        s2[j] = s1[j];
+        s1[j] = s0;
+      }
+    }
+    if ( !block ) return;
+    _counter += n;
+    _block += n;
+    if ( _block==FLUSH ) flush();
+  }
+
+  // Value of the pending block: sum of x[m] exp(-i w m) over its samples
+  void pending( size_t j, double& re, double& im ) const {
+    if ( _block==0 ) {
+      re = im = 0;
+      return;
+    }
+    // exp(-i w (n-1)) ( s1 - exp(-i w) s2 ), n the index after the block
+    double yr = _s1[j] - _rot_re[j]*_s2[j];
+    double yi = _rot_im[j]*_s2[j];
+    double a = _w[j]*double(_counter-1);
+    double c = cos( a ), s = -sin( a );
+    re = yr*c - yi*s;
+    im = yr*s + yi*c;
+  }
+
+  void flush() {
+    for ( size_t j=0; j<_w.size(); ++j ) {
+      double re, im;
+      pending( j, re, im );
+      _re[j] += re;
+      _im[j] += im;
+      _s1[j] = _s2[j] = 0;
+    }
+    _block = 0;
+  }
+
+  void slide( double value ) {
+    size_t N = _w.size();
+    double* re = &_re[0];
+    double* im = &_im[0];
+    if ( _counter < _window ) {
+      // Filling up: the oldest sample is sample 0
+      double* pr = &_p_re[0];
+      double* pi = &_p_im[0];
+      const double* rr = &_rot_re[0];
+      const double* ri = &_rot_im[0];
+      for ( size_t j=0; j<N; ++j ) {
+        re[j] += value*pr[j];
+        im[j] += value*pi[j];
+        double r = pr[j]*rr[j] + pi[j]*ri[j];
+        pi[j] = pi[j]*rr[j] - pr[j]*ri[j];
+        pr[j] = r;
+      }
+    }
+    else {
+      // Drop the oldest sample, move the reference to the next one and
+      // add the new sample at the far end
+      double old = _ring[_pos];
+      const double* rr = &_rot_re[0];
+      const double* ri = &_rot_im[0];
+      const double* lr = &_last_re[0];
+      const double* li = &_last_im[0];
+      for ( size_t j=0; j<N; ++j ) {
+        double a = re[j] - old;
+        double b = im[j];
+        re[j] = a*rr[j] - b*ri[j] + value*lr[j];
+        im[j] = a*ri[j] + b*rr[j] + value*li[j];
+      }
+    }
+    _ring[_pos] = value;
+    _counter++;
+    if ( ++_pos==_window ) {
+      _pos = 0;
+      recompute();
+    }
+  }
+
+  // Exact sums over the ring, oldest sample first, with the recurrence
+  void recompute() {
+    size_t N = _w.size();
+    for ( size_t j=0; j<N; ++j ) _s1[j] = _s2[j] = 0;
+    goertzel( &_ring[_pos], _window - _pos, false );
+    goertzel( &_ring[0], _pos, false );
+    for ( size_t j=0; j<N; ++j ) {
+      double yr = _s1[j] - _rot_re[j]*_s2[j];
+      double yi = _rot_im[j]*_s2[j];
+      _re[j] = yr*_last_re[j] - yi*_last_im[j];
+      _im[j] = yr*_last_im[j] + yi*_last_re[j];
+    }
+  }
+
+  // Sum of x[m] exp(-i w m) with m counted from the reference sample
+  void sums( size_t j, double& re, double& im ) const {
+    re = _re[j];
+    im = _im[j];
+    if ( _window==0 ) {
+      double pr, pi;
+      pending( j, pr, pi );
+      re += pr;
+      im += pi;
+    }
+  }
+
+  uint32_t _window;
+  uint64_t _counter;
+  uint32_t _block;
+  uint32_t _pos;
+  std::vector<double> _w, _coef;
+  std::vector<double> _rot_re, _rot_im;    // exp(i w)
+  std::vector<double> _last_re, _last_im;  // exp(-i w (window-1))
+  std::vector<double> _s1, _s2;
+  std::vector<double> _re, _im;
+  std::vector<double> _p_re, _p_im;        // exp(-i w m) while filling up
+  std::vector<double> _ring;
+};
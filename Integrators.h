@@ -1,28 +1,41 @@
 #pragma once
 #include <stdint.h>
+#include <math.h>
 
 struct Integrator {
     Integrator(double fs) {
         sum = 0.0;
         twofs = 2.0 * fs;
+        // Dividing by a power of two is the same as multiplying by its
+        // exact reciprocal, which keeps the divider off the loop's path
+        int e;
+        pow2 = ::frexp(twofs, &e) == 0.5;
+        inv_twofs = 1.0/twofs;
     }
 
     double add(double input) {
         long double out = input + sum;
         sum = input + out;
-        return out/twofs;
+        return pow2 ? out*inv_twofs : out/twofs;
     }
 
     double value() {
-        return (double) (sum/twofs);
+        return (double) (pow2 ? sum*inv_twofs : sum/twofs);
     }
 
     void reset() {
         sum = 0;
     }
 
+    // Moves value() by delta without touching the dynamics
+    void shift(double delta) {
+        sum += (long double) delta * twofs;
+    }
+
 private:
     long double sum;
     double twofs;
+    double inv_twofs;
+    bool pow2;
 };
 
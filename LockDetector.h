@@ -1,8 +1,9 @@
 #pragma once
 #include "LowPassFilters.h"
 
-struct LockDetector {
-    LockDetector( double fc, double threshold = 0.5 ) 
+template< typename T >
+struct LockDetectorT {
+    LockDetectorT( double fc, double threshold = 0.5 ) 
       : in_phase_lp(0.707106, fc),
         qu_phase_lp(0.707106, fc)
     {
@@ -14,7 +15,7 @@ struct LockDetector {
         qu_phase_lp.reset();
     }
 
-    bool add( double in_phase, double qu_phase) {
+    bool add( T in_phase, T qu_phase) {
         in_phase = in_phase_lp.add(in_phase*in_phase);
         qu_phase = qu_phase_lp.add(qu_phase*qu_phase);
 	//printf( "   lock in:%f qu:%f\n", in_phase, qu_phase );
@@ -24,7 +25,10 @@ struct LockDetector {
     }
 
 private:
-    BiquadLowPassFilter in_phase_lp;
-    BiquadLowPassFilter qu_phase_lp;
-    double thresh;
+    BiquadLowPassFilterT<T> in_phase_lp;
+    BiquadLowPassFilterT<T> qu_phase_lp;
+    T thresh;
 };
+
+typedef LockDetectorT<double> LockDetector;
+typedef LockDetectorT<float> LockDetectorF;
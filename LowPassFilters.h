@@ -3,18 +3,25 @@
 #include <stdio.h>
 #include <math.h>
 
-struct LowPassFilter {
-    LowPassFilter( double tau, double fs ) {
+/*******************************************************************
+The filters below are templated on the sample type T. Coefficients
+are designed in double and rounded to T once; state and arithmetic
+are in T. The double instantiations keep the original names.
+*******************************************************************/
+
+template< typename T >
+struct LowPassFilterT {
+    LowPassFilterT( double tau, double fs ) {
         tau_fs = tau*fs;
         last = 0.0;
     }
 
-    double add(double sig) {
-        last = (sig + tau_fs * last)/(1.0 + tau_fs);
+    T add(T sig) {
+        last = (sig + tau_fs * last)/(T(1.0) + tau_fs);
         return last;
     }
 
-    double value() {
+    T value() {
         return last;
     }
 
@@ -22,17 +29,22 @@ struct LowPassFilter {
         last = 0.0;
     }
     
-    double tau_fs;
-    double last;
+    T tau_fs;
+    T last;
 };
 
+typedef LowPassFilterT<double> LowPassFilter;
+typedef LowPassFilterT<float> LowPassFilterF;
+
 
-struct BiquadLowPassFilter 
+template< typename T >
+struct BiquadLowPassFilterT 
 {
-    BiquadLowPassFilter() {}
+    BiquadLowPassFilterT() {}
 
-    BiquadLowPassFilter(double Q, double fc ) {
+    BiquadLowPassFilterT(double Q, double fc ) {
         init( Q, fc );
+        reset();
     }
     
     void init( double Q, double fc ) {
@@ -43,16 +55,18 @@ struct BiquadLowPassFilter
         double alpha = sn/(2.0*Q);
         double beta = sqrt(A+A);
 
-        init_priv(A, omega, sn, cs, alpha, beta);
-        b0 /= a0;
-        b1 /= a0;
-        b2 /= a0;
-        a1 /= a0;
-        a2 /= a0;
+        double c[6];
+        init_priv(c, A, omega, sn, cs, alpha, beta);
+        b0 = c[0] / c[3];
+        b1 = c[1] / c[3];
+        b2 = c[2] / c[3];
+        a0 = c[3];
+        a1 = c[4] / c[3];
+        a2 = c[5] / c[3];
     }
     
-    double add( double x0 ) {
-        double y0 = b0 * x0 + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+    T add( T x0 ) {
+        T y0 = b0 * x0 + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
         x2 = x1;
         x1 = x0;
         y2 = y1;
@@ -67,16 +81,28 @@ struct BiquadLowPassFilter
         y1 = 0;
     }
 
-    void init_priv(double A, double omega, double sn, double cs, double alpha, double beta) {
-        b0 = (1.0 - cs) / 2.0;
-        b1 =  1.0 - cs;
-        b2 = (1.0 - cs) / 2.0;
-        a0 =  1.0 + alpha;
-        a1 = -2.0 * cs;
-        a2 =  1.0 - alpha;
+    // Normalized coefficients b0, b1, b2, a1, a2
+    void coefficients( double c[5] ) const {
+        c[0] = b0;
+        c[1] = b1;
+        c[2] = b2;
+        c[3] = a1;
+        c[4] = a2;
+    }
+
+    // Unnormalized b0, b1, b2, a0, a1, a2
+    static void init_priv(double c[6], double A, double omega, double sn, double cs, double alpha, double beta) {
+        c[0] = (1.0 - cs) / 2.0;
+        c[1] =  1.0 - cs;
+        c[2] = (1.0 - cs) / 2.0;
+        c[3] =  1.0 + alpha;
+        c[4] = -2.0 * cs;
+        c[5] =  1.0 - alpha;
     }
   
 private:
-    double a0,a1,a2,b0,b1,b2,x1,x2,y1,y2;
+    T a0,a1,a2,b0,b1,b2,x1,x2,y1,y2;
 };
 
+typedef BiquadLowPassFilterT<double> BiquadLowPassFilter;
+typedef BiquadLowPassFilterT<float> BiquadLowPassFilterF;
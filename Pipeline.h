@@ -0,0 +1,256 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "Timing.h"
+
+/*******************************************************************
+What a ring saw, for the report. The producer side fields are only
+written by the producer and the consumer side ones by the consumer,
+each side's on its own cache line; read them once both have finished.
+*******************************************************************/
+class PipelineRing
+{
+public:
+  PipelineRing( const std::string& name, size_t capacity )
+    : name( name ), capacity( capacity ), blocks( 0 ), occupancy( 0 ), most( 0 ),
+      full_waits( 0 ), full_seconds( 0 ), empty_waits( 0 ), empty_seconds( 0 ) {}
+  virtual ~PipelineRing() {}
+
+  std::string name;
+  size_t capacity;
+  alignas(64) uint64_t blocks;            // published
+  uint64_t occupancy;                     // sum over blocks published of the blocks then queued
+  uint64_t most;
+  uint64_t full_waits;                    // claims that found the ring full: backpressure
+  double full_seconds;
+  alignas(64) uint64_t empty_waits;       // fronts that found it empty: starved
+  double empty_seconds;
+
+protected:
+  // Spins briefly, then gives the core away: with fewer cores than
+  // stages the other side has to run for the wait to end
+  static void pause( unsigned& spins ) {
+    if ( ++spins < 64 ) {
+#if defined(__x86_64__) || defined(__i386__)
+      _mm_pause();
+#endif
+    }
+    else std::this_thread::yield();
+  }
+};
+
+/*******************************************************************
+Lock free single producer single consumer ring of preallocated blocks.
+Blocks are filled and read in place, so nothing is copied or allocated
+once the ring is built. The producer claim()s the next free block,
+fills it and publish()es it; the consumer takes front() and release()s
+it when done. claim() waits while the ring is full, which holds a fast
+producer back to the pace of its consumer. Head and tail sit on their
+own cache lines, each next to the copy of the other index its owner
+last read, so neither side touches the other's line until its copy
+runs out.
+*******************************************************************/
+template< typename Block >
+class SpscRing : public PipelineRing
+{
+public:
+  // capacity is rounded up to a power of two
+  SpscRing( const std::string& name, size_t capacity, const Block& prototype = Block() )
+    : PipelineRing( name, round( capacity ) ),
+      _slots( this->capacity, prototype ),
+      _mask( this->capacity-1 ),
+      _head( 0 ), _tail_seen( 0 ), _tail( 0 ), _head_seen( 0 ), _closed( false )
+  {}
+
+  // Next block to fill, waiting for room
+  Block* claim() {
+    uint64_t head = _head.load( std::memory_order_relaxed );
+    if ( head - _tail_seen == capacity ) {
+      _tail_seen = _tail.load( std::memory_order_acquire );
+      if ( head - _tail_seen == capacity ) {
+        full_waits++;
+        double t0 = now();
+        unsigned spins = 0;
+        do {
+          pause( spins );
+          _tail_seen = _tail.load( std::memory_order_acquire );
+        } while ( head - _tail_seen == capacity );
+        full_seconds += now() - t0;
+      }
+    }
+    return &_slots[head & _mask];
+  }
+
+  // Hands the claimed block to the consumer. The occupancy is counted
+  // against the tail claim() last read, which the consumer may since
+  // have moved on: an upper bound, and no read of the consumer's line
+  void publish() {
+    uint64_t head = _head.load( std::memory_order_relaxed ) + 1;
+    _head.store( head, std::memory_order_release );
+    uint64_t queued = head - _tail_seen;
+    blocks++;
+    occupancy += queued;
+    if ( queued > most ) most = queued;
+  }
+
+  // No more blocks: front() returns NULL once the ring is drained
+  void close() {
+    _closed.store( true, std::memory_order_release );
+  }
+
+  // Oldest published block, waiting for one; NULL at the end
+  Block* front() {
+    uint64_t tail = _tail.load( std::memory_order_relaxed );
+    if ( tail == _head_seen ) {
+      _head_seen = _head.load( std::memory_order_acquire );
+      if ( tail == _head_seen ) {
+        empty_waits++;
+        double t0 = now();
+        unsigned spins = 0;
+        for ( ;; ) {
+          // Read the flag first: every block published before close()
+          // is visible by then
+          bool closed = _closed.load( std::memory_order_acquire );
+          _head_seen = _head.load( std::memory_order_acquire );
+          if ( tail != _head_seen ) break;
+          if ( closed ) {
+            empty_seconds += now() - t0;
+            return NULL;
+          }
+          pause( spins );
+        }
+        empty_seconds += now() - t0;
+      }
+    }
+    return &_slots[tail & _mask];
+  }
+
+  // Gives the block from front() back to the producer
+  void release() {
+    _tail.store( _tail.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+  }
+
+private:
+  static size_t round( size_t n ) {
+    size_t p = 1;
+    while ( p < n ) p <<= 1;
+    return p;
+  }
+
+  alignas(64) std::vector<Block> _slots;        // off the line of the consumer's counters
+  size_t _mask;
+  alignas(64) std::atomic<uint64_t> _head;
+  uint64_t _tail_seen;                          // producer's copy of _tail
+  alignas(64) std::atomic<uint64_t> _tail;
+  uint64_t _head_seen;                          // consumer's copy of _head
+  alignas(64) std::atomic<bool> _closed;
+};
+
+/*******************************************************************
+Runs the stages of a pipeline, one thread each, optionally pinned to
+successive cores. Stages hand blocks on through rings the pipeline
+owns; a stage closes its output ring when it is done and returns when
+its input is drained. report() prints how long each stage ran and how
+full each ring was: a ring that is mostly full feeds a stage that is
+the bottleneck, one that is mostly empty follows one.
+*******************************************************************/
+class Pipeline
+{
+public:
+  typedef std::function<void()> Stage;
+
+  Pipeline( bool pin = false ) : _pin( pin ) {}
+
+  ~Pipeline() {
+    for ( size_t j=0; j<_rings.size(); ++j ) {
+      void* memory = dynamic_cast<void*>( _rings[j] );
+      _rings[j]->~PipelineRing();
+      free( memory );
+    }
+  }
+
+  // Rings are aligned to cache lines, which plain new does not promise
+  // before C++17, so they are built in memory from posix_memalign
+  template< typename Block >
+  SpscRing<Block>& ring( const std::string& name, size_t capacity, const Block& prototype = Block() ) {
+    void* memory = NULL;
+    if ( posix_memalign( &memory, alignof(SpscRing<Block>), sizeof(SpscRing<Block>) )!=0 ) throw std::bad_alloc();
+    SpscRing<Block>* r;
+    try {
+      r = new (memory) SpscRing<Block>( name, capacity, prototype );
+    }
+    catch ( ... ) {
+      free( memory );
+      throw;
+    }
+    _rings.push_back( r );
+    return *r;
+  }
+
+  void stage( const std::string& name, const Stage& body ) {
+    _names.push_back( name );
+    _stages.push_back( body );
+  }
+
+  // Runs every stage to the end
+  void run() {
+    _seconds.assign( _stages.size(), 0 );
+    // hardware_concurrency() is 0 where it cannot tell
+    unsigned cores = std::max( 1u, std::thread::hardware_concurrency() );
+    std::vector<std::thread> threads;
+    for ( size_t j=0; j<_stages.size(); ++j ) {
+      threads.push_back( std::thread( [this,j]() {
+        double t0 = now();
+        _stages[j]();
+        _seconds[j] = now() - t0;
+      } ) );
+      if ( _pin ) {
+        cpu_set_t cpus;
+        CPU_ZERO( &cpus );
+        CPU_SET( j % cores, &cpus );
+        if ( pthread_setaffinity_np( threads.back().native_handle(), sizeof(cpus), &cpus )!=0 ) {
+          fprintf( stderr, "Could not pin stage %s\n", _names[j].c_str() );
+        }
+      }
+    }
+    for ( size_t j=0; j<threads.size(); ++j ) threads[j].join();
+  }
+
+  void report( FILE* out ) const {
+    fprintf( out, "%-12s %10s\n", "stage", "seconds" );
+    for ( size_t j=0; j<_stages.size(); ++j ) fprintf( out, "%-12s %10.3f\n", _names[j].c_str(), _seconds[j] );
+    fprintf( out, "%-12s %8s %10s %8s %6s %10s %8s %10s %8s\n", "ring", "capacity", "blocks", "mean", "most",
+             "full", "[s]", "empty", "[s]" );
+    for ( size_t j=0; j<_rings.size(); ++j ) {
+      const PipelineRing& r( *_rings[j] );
+      fprintf( out, "%-12s %8lu %10lu %8.2f %6lu %10lu %8.3f %10lu %8.3f\n", r.name.c_str(), r.capacity, r.blocks,
+               r.blocks ? double( r.occupancy )/r.blocks : 0.0, r.most, r.full_waits, r.full_seconds,
+               r.empty_waits, r.empty_seconds );
+    }
+  }
+
+  const std::vector<PipelineRing*>& rings() const {
+    return _rings;
+  }
+
+private:
+  bool _pin;
+  std::vector<std::string> _names;
+  std::vector<Stage> _stages;
+  std::vector<double> _seconds;
+  std::vector<PipelineRing*> _rings;
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <vector>
+#include "Pipeline.h"
+#include "Resampler.h"
+#include "SoundDecoder.h"
+#include "StreamingDecoder.h"
+
+// Samples in flight between the stages; n of them are valid
+struct SampleBlock
+{
+  SampleBlock( size_t size = 0 ) : samples( size ), n( 0 ) {}
+  std::vector<double> samples;
+  size_t n;
+};
+
+// The cycles of one block of samples, each with its level
+struct CycleBlock
+{
+  std::vector<DecodedCycle> cycles;
+  std::vector<double> levels;
+};
+
+/*******************************************************************
+The streaming decode split into pipeline stages. stages() adds read,
+which fills blocks from source, resample, only when hz differs from
+the input rate, loop, the Costas loop with the cycle levels, and
+slice, the lock and symbol timing. The callbacks run on the slice
+thread: onCycle gets every cycle with its level, onLock and onSymbol
+are the SymbolSlicer's, and onBlock follows the cycles of each block.
+The decoder has to outlive Pipeline::run().
+*******************************************************************/
+class PipelinedDecoder
+{
+public:
+  static const size_t BLOCK = 4096;             // input samples per block
+  static const size_t RING_BLOCKS = 8;
+
+  PipelinedDecoder( uint32_t input_hz, uint32_t hz = 0 )
+    : _hz( hz>0 ? hz : input_hz ), _resampler( NULL )
+  {
+    if ( _hz!=input_hz ) _resampler = new PolyphaseResampler( input_hz, _hz );
+  }
+
+  ~PipelinedDecoder() {
+    delete _resampler;
+  }
+
+  std::function<void( const DecodedCycle&, double )> onCycle;
+  std::function<void( const LockEvent& )> onLock;
+  std::function<void( const SymbolTiming& )> onSymbol;
+  std::function<void()> onBlock;
+
+  typedef std::function<size_t( double*, size_t )> Source;
+
+  // source( samples, max ) puts up to max input samples in samples and
+  // returns how many, 0 at the end
+  void stages( Pipeline& pipeline, const Source& source ) {
+    SpscRing<SampleBlock>& read = pipeline.ring( "read", RING_BLOCKS, SampleBlock( BLOCK ) );
+    SpscRing<SampleBlock>* resampled = &read;
+    if ( _resampler ) {
+      resampled = &pipeline.ring( "resample", RING_BLOCKS, SampleBlock( _resampler->outputs( BLOCK ) ) );
+    }
+    SpscRing<CycleBlock>& loop = pipeline.ring<CycleBlock>( "loop", RING_BLOCKS );
+
+    pipeline.stage( "read", [source,&read]() {
+      for ( ;; ) {
+        SampleBlock* b = read.claim();
+        b->n = source( &b->samples[0], b->samples.size() );
+        if ( b->n==0 ) break;
+        read.publish();
+      }
+      read.close();
+    } );
+    if ( _resampler ) {
+      PolyphaseResampler* resampler = _resampler;
+      pipeline.stage( "resample", [&read,resampled,resampler]() {
+        while ( SampleBlock* in = read.front() ) {
+          SampleBlock* out = resampled->claim();
+          out->n = resampler->process( &in->samples[0], in->n, &out->samples[0] );
+          read.release();
+          resampled->publish();
+        }
+        resampled->close();
+      } );
+    }
+    uint32_t hz = _hz;
+    pipeline.stage( "loop", [hz,resampled,&loop]() {
+      SoundDecoder decoder( hz, NULL );
+      CycleLevelMeter meter( decoder.carrierSamples() );
+      while ( SampleBlock* in = resampled->front() ) {
+        decoder.add( &in->samples[0], in->n );
+        meter.add( &in->samples[0], in->n );
+        resampled->release();
+        CycleBlock* out = loop.claim();
+        out->cycles.swap( decoder.cycles );
+        out->levels.swap( meter.levels );
+        decoder.cycles.clear();
+        meter.levels.clear();
+        loop.publish();
+      }
+      loop.close();
+    } );
+    pipeline.stage( "slice", [this,hz,&loop]() {
+      SymbolSlicer slicer( SoundDecoder( hz, NULL ).carrierSamples() );
+      slicer.onLock = [this]( const LockEvent& e ) { if ( onLock ) onLock( e ); };
+      slicer.onSymbol = [this]( const SymbolTiming& s ) { if ( onSymbol ) onSymbol( s ); };
+      while ( CycleBlock* in = loop.front() ) {
+        for ( size_t j=0; j<in->cycles.size(); ++j ) {
+          if ( onCycle ) onCycle( in->cycles[j], in->levels[j] );
+          slicer.add( in->cycles[j], in->levels[j] );
+        }
+        loop.release();
+        if ( onBlock ) onBlock();
+      }
+    } );
+  }
+
+private:
+  // Owns the resampler
+  PipelinedDecoder( const PipelinedDecoder& );
+  PipelinedDecoder& operator=( const PipelinedDecoder& );
+
+  uint32_t _hz;
+  PolyphaseResampler* _resampler;
+};
@@ -0,0 +1,266 @@
+#pragma once
+
+/*******************************************************************
+Per stage cycle accounting for the decode path. Probes are macros that
+expand to nothing unless WAVDECODER_PROFILE is defined, which the
+WAVDECODER_PROFILE cmake setting does:
+
+  BLOCK (1)   PROFILE_BLOCK times every call of a block function, such
+              as SoundDecoder::add( const T*, n ) or the WavReader loop.
+              One probe per block of thousands of samples costs well
+              under 1%.
+  SAMPLE (2)  Also PROFILE_SAMPLE and PROFILE_SPLIT inside the per
+              sample add() functions. Those run too often to time every
+              call: one call in SAMPLING is timed and the totals are
+              scaled up. The other calls cost a countdown each.
+
+Each stage keeps its ticks, samples and a histogram of the ticks per
+sample of each timed call, in log2 bins. The report is printed to
+stderr when the program exits. Ticks come from the time stamp counter
+where there is one, which runs at the nominal clock, else from
+clock_gettime in nanoseconds. The cost of reading the clock is measured
+once and taken off every timed call. Nested stages are timed
+independently, so an outer stage includes its inner ones.
+*******************************************************************/
+
+#ifdef WAVDECODER_PROFILE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <mutex>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// One named stage. Timed calls from any thread add up here.
+struct ProfileStage
+{
+  static const unsigned BINS = 32;
+
+  void record( uint64_t dt, uint64_t n ) {
+    timed.fetch_add( 1, std::memory_order_relaxed );
+    ticks.fetch_add( dt, std::memory_order_relaxed );
+    samples.fetch_add( n, std::memory_order_relaxed );
+    uint64_t per = n>0 ? dt/n : dt;
+    unsigned bin = 0;
+    while ( per>1 && bin<BINS-1 ) {
+      per >>= 1;
+      bin++;
+    }
+    hist[bin].fetch_add( 1, std::memory_order_relaxed );
+  }
+
+  const char* name;
+  bool sampled;                       // one call in Profiler::SAMPLING timed
+  std::atomic<uint64_t> timed;        // calls timed
+  std::atomic<uint64_t> ticks;        // in the calls timed
+  std::atomic<uint64_t> samples;      // in the calls timed
+  std::atomic<uint64_t> hist[BINS];   // ticks per sample in [2^k,2^(k+1))
+};
+
+class Profiler
+{
+public:
+  static const uint32_t SAMPLING = 256;
+  static const unsigned MAX_STAGES = 64;
+
+  static Profiler& instance() {
+    static Profiler profiler;
+    return profiler;
+  }
+
+  static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+#endif
+  }
+
+  // Ticks of one back to back pair of ticks() calls
+  uint64_t overhead() const {
+    return _overhead;
+  }
+
+  // The stage called name, created on first use. Stages of the same name
+  // from different probes, say the float and double instantiations of a
+  // template, are the same stage.
+  ProfileStage& stage( const char* name, bool sampled ) {
+    std::lock_guard<std::mutex> lock( _mutex );
+    for ( unsigned k=0; k<_count; ++k ) {
+      if ( strcmp( _stages[k].name, name )==0 ) return _stages[k];
+    }
+    if ( _count==MAX_STAGES ) return _stages[MAX_STAGES];
+    ProfileStage& s( _stages[_count++] );
+    s.name = name;
+    s.sampled = sampled;
+    return s;
+  }
+
+  // Calls, samples and ticks per sample of every stage, the last two
+  // scaled up to all calls for the sampled stages
+  void report( FILE* out ) {
+    std::lock_guard<std::mutex> lock( _mutex );
+    uint64_t most = 0;
+    for ( unsigned k=0; k<_count; ++k ) {
+      uint64_t t = total( _stages[k] );
+      if ( t > most ) most = t;
+    }
+    if ( most==0 ) return;
+    fprintf( out, "Profile, ticks per sample of each stage (%s, %lu a probe taken off):\n",
+#if defined(__x86_64__) || defined(__i386__)
+             "time stamp counter",
+#else
+             "nanoseconds",
+#endif
+             _overhead );
+    fprintf( out, "%-28s %12s %14s %12s %10s %6s\n", "stage", "calls", "samples", "Mticks", "ticks/smp", "share" );
+    for ( unsigned k=0; k<_count; ++k ) {
+      ProfileStage& s( _stages[k] );
+      uint64_t timed = s.timed.load();
+      if ( timed==0 ) continue;
+      uint64_t scale = s.sampled ? SAMPLING : 1;
+      uint64_t samples = s.samples.load()*scale;
+      fprintf( out, "%-28s %12lu %14lu %12.1f %10.2f %5.1f%%%s\n", s.name, timed*scale, samples, 1E-6*total( s ),
+               double( s.ticks.load() )/s.samples.load(), 100.0*total( s )/most, s.sampled ? "  sampled" : "" );
+      fprintf( out, "    " );
+      for ( unsigned b=0; b<ProfileStage::BINS; ++b ) {
+        double pct = 100.0*s.hist[b].load()/timed;
+        if ( pct >= 0.5 ) fprintf( out, " [%lu,%lu) %.0f%%", 1UL<<b, 2UL<<b, pct );
+      }
+      fprintf( out, "\n" );
+    }
+  }
+
+private:
+  Profiler() : _count( 0 ) {
+    for ( unsigned k=0; k<=MAX_STAGES; ++k ) {
+      ProfileStage& s( _stages[k] );
+      s.name = "(too many stages)";
+      s.sampled = false;
+      s.timed = s.ticks = s.samples = 0;
+      for ( unsigned b=0; b<ProfileStage::BINS; ++b ) s.hist[b] = 0;
+    }
+    _overhead = ~0ULL;
+    for ( unsigned k=0; k<1000; ++k ) {
+      uint64_t t0 = ticks();
+      uint64_t t1 = ticks();
+      if ( t1 - t0 < _overhead ) _overhead = t1 - t0;
+    }
+  }
+
+  ~Profiler() {
+    report( stderr );
+  }
+
+  static uint64_t total( const ProfileStage& s ) {
+    return s.ticks.load()*(s.sampled ? SAMPLING : 1);
+  }
+
+  std::mutex _mutex;
+  ProfileStage _stages[MAX_STAGES+1];
+  unsigned _count;
+  uint64_t _overhead;
+};
+
+// Times its scope, every call
+class ProfileBlockProbe
+{
+public:
+  ProfileBlockProbe( ProfileStage& stage, uint64_t n ) : samples( n ), _stage( stage ), _t0( Profiler::ticks() ) {}
+  ~ProfileBlockProbe() {
+    uint64_t dt = Profiler::ticks() - _t0;
+    uint64_t o = Profiler::instance().overhead();
+    _stage.record( dt>o ? dt-o : 0, samples );
+  }
+  uint64_t samples;
+
+private:
+  ProfileStage& _stage;
+  uint64_t _t0;
+};
+
+// Times one call in SAMPLING, as consecutive splits: each split() ends
+// a stage and starts the next
+class ProfileSampler
+{
+public:
+  ProfileSampler( uint32_t& countdown ) : _t0( 0 ) {
+    if ( countdown-- == 0 ) {
+      countdown = Profiler::SAMPLING-1;
+      _t0 = Profiler::ticks();
+    }
+  }
+  void split( ProfileStage& stage ) {
+    if ( _t0 ) {
+      uint64_t dt = Profiler::ticks() - _t0;
+      uint64_t o = Profiler::instance().overhead();
+      stage.record( dt>o ? dt-o : 0, 1 );
+      _t0 = Profiler::ticks();
+    }
+  }
+
+private:
+  uint64_t _t0;
+};
+
+// A sampled probe on a whole scope
+class ProfileSampleProbe : public ProfileSampler
+{
+public:
+  ProfileSampleProbe( ProfileStage& stage, uint32_t& countdown ) : ProfileSampler( countdown ), _stage( stage ) {}
+  ~ProfileSampleProbe() { split( _stage ); }
+
+private:
+  ProfileStage& _stage;
+};
+
+#define PROFILE_CAT2( a, b ) a##b
+#define PROFILE_CAT( a, b ) PROFILE_CAT2( a, b )
+
+// Times the rest of the scope, counting n samples. PROFILE_SAMPLES( n )
+// changes the count once it is known, for a block read say.
+#define PROFILE_BLOCK( name, n ) \
+    static ProfileStage& PROFILE_CAT( _profile_stage_, __LINE__ ) = Profiler::instance().stage( name, false ); \
+    ProfileBlockProbe _profile_block( PROFILE_CAT( _profile_stage_, __LINE__ ), n )
+#define PROFILE_SAMPLES( n ) _profile_block.samples = (n)
+
+#endif
+
+#if WAVDECODER_PROFILE >= 2
+
+// Times the rest of the scope, one sample, one call in SAMPLING
+#define PROFILE_SAMPLE( name ) \
+    static ProfileStage& PROFILE_CAT( _profile_stage_, __LINE__ ) = Profiler::instance().stage( name, true ); \
+    static thread_local uint32_t PROFILE_CAT( _profile_countdown_, __LINE__ ) = 0; \
+    ProfileSampleProbe PROFILE_CAT( _profile_probe_, __LINE__ )( PROFILE_CAT( _profile_stage_, __LINE__ ), \
+                                                                PROFILE_CAT( _profile_countdown_, __LINE__ ) )
+
+// PROFILE_SPLITS starts the clock, one call in SAMPLING. Each
+// PROFILE_SPLIT charges the time since the last split to a stage.
+#define PROFILE_SPLITS() \
+    static thread_local uint32_t _profile_countdown = 0; \
+    ProfileSampler _profile_splits( _profile_countdown )
+#define PROFILE_SPLIT( name ) \
+    do { \
+        static ProfileStage& _profile_stage = Profiler::instance().stage( name, true ); \
+        _profile_splits.split( _profile_stage ); \
+    } while ( 0 )
+
+#else
+
+#define PROFILE_SAMPLE( name )
+#define PROFILE_SPLITS()
+#define PROFILE_SPLIT( name )
+
+#endif
+
+#ifndef WAVDECODER_PROFILE
+#define PROFILE_BLOCK( name, n )
+#define PROFILE_SAMPLES( n )
+#endif
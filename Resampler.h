@@ -0,0 +1,131 @@
+#pragma once
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/*******************************************************************
+Rational sample rate converter, out_hz/in_hz = L/M in lowest terms.
+Conceptually the input is upsampled by L, low pass filtered and
+downsampled by M; the polyphase form only evaluates the outputs that
+are kept, each one a dot product of taps_per_phase input samples with
+one of the L branches of the filter. Decimation by M is the case L=1.
+
+The filter is a Blackman windowed sinc with its cutoff at cutoff times
+the lower Nyquist frequency, taps samples long at the lower of the two
+rates, so its transition band is the same fraction of the output band
+whatever the ratio. Samples are pushed in blocks of any size;
+the outputs do not depend on how the input is split.
+*******************************************************************/
+class PolyphaseResampler
+{
+public:
+  PolyphaseResampler( uint32_t in_hz, uint32_t out_hz, unsigned taps = 64, double cutoff = 0.8 ) {
+    uint32_t g = gcd( in_hz, out_hz );
+    _L = out_hz/g;
+    _M = in_hz/g;
+    // Input samples under the filter
+    _K = _M>_L ? unsigned( (uint64_t(taps)*_M + _L-1)/_L ) : taps;
+    if ( _K<1 ) _K = 1;
+    // Prototype at the upsampled rate, gain L to make up for the zeros
+    size_t N = size_t(_L)*_K;
+    double fc = cutoff*0.5/(_L>_M ? _L : _M);
+    double c = 0.5*(N-1);
+    std::vector<double> h( N );
+    for ( size_t j=0; j<N; ++j ) {
+      double t = j - c;
+      double w = N>1 ? 0.42 - 0.5*cos( 2*M_PI*j/(N-1) ) + 0.08*cos( 4*M_PI*j/(N-1) ) : 1.0;
+      h[j] = w*(t==0 ? 2*fc : sin( 2*M_PI*fc*t )/(M_PI*t));
+    }
+    // Unit DC gain on every branch
+    _poly.resize( N );
+    for ( uint32_t p=0; p<_L; ++p ) {
+      double sum = 0;
+      for ( unsigned k=0; k<_K; ++k ) sum += h[p + size_t(k)*_L];
+      // Branch p, oldest sample first, so it lines up with the history
+      for ( unsigned k=0; k<_K; ++k ) {
+        _poly[size_t(p)*_K + _K-1-k] = sum!=0 ? h[p + size_t(k)*_L]/sum : 0;
+      }
+    }
+    _delay = c/_L;
+    reset();
+  }
+
+  void reset() {
+    _buf.assign( _K-1, 0.0 );
+    _next = _K-1;
+    _phase = 0;
+  }
+
+  uint32_t up() const { return _L; }
+  uint32_t down() const { return _M; }
+
+  // The L branches of the filter, taps().size()/up() taps each, every
+  // branch ordered oldest input sample first
+  const std::vector<double>& taps() const {
+    return _poly;
+  }
+
+  // Delay of the filter in input samples
+  double delay() const {
+    return _delay;
+  }
+
+  // Most outputs n inputs can produce
+  size_t outputs( size_t n ) const {
+    return (uint64_t(n)*_L)/_M + 1;
+  }
+
+  // Resamples n inputs into out, which must hold outputs(n) values.
+  // Returns the number of values written.
+  size_t process( const double* in, size_t n, double* out ) {
+    _buf.insert( _buf.end(), in, in+n );
+    size_t count = 0;
+    size_t size = _buf.size();
+    const double* buf = &_buf[0];
+    while ( _next < size ) {
+      out[count++] = dot( &_poly[size_t(_phase)*_K], buf + _next+1 - _K, _K );
+      _phase += _M;
+      _next += _phase/_L;
+      _phase %= _L;
+    }
+    // Keep the K-1 samples before the next output's newest sample
+    size_t drop = _next+1 - _K;
+    if ( drop>size ) drop = size;
+    _buf.erase( _buf.begin(), _buf.begin() + drop );
+    _next -= drop;
+    return count;
+  }
+
+private:
+  static uint32_t gcd( uint32_t a, uint32_t b ) {
+    while ( b!=0 ) {
+      uint32_t t = a % b;
+      a = b;
+      b = t;
+    }
+    return a==0 ? 1 : a;
+  }
+
+  static double dot( const double* __restrict a, const double* __restrict b, size_t n ) {
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t j = 0;
+    for ( ; j+4<=n; j+=4 ) {
+      s0 += a[j]*b[j];
+      s1 += a[j+1]*b[j+1];
+      s2 += a[j+2]*b[j+2];
+      s3 += a[j+3]*b[j+3];
+    }
+    for ( ; j<n; ++j ) s0 += a[j]*b[j];
+    return (s0 + s1) + (s2 + s3);
+  }
+
+  uint32_t _L;
+  uint32_t _M;
+  unsigned _K;
+  double _delay;
+  std::vector<double> _poly;   // L branches of K taps
+  std::vector<double> _buf;    // K-1 history samples, then new input
+  size_t _next;                // newest input sample of the next output
+  uint32_t _phase;             // branch of the next output
+};
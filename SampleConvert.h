@@ -0,0 +1,275 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*******************************************************************
+Converts interleaved WAV sample data into normalized float/double
+blocks, picking one channel out of each frame. Output is scaled so
+that digital full scale maps to [-1,1), times an optional gain.
+
+Supported codes (the AudioFormat field of WAV_HEADER):
+  1 = PCM 8 (unsigned), 16, 24 or 32 bits
+  3 = IEEE float 32 or 64 bits
+  6 = G.711 A-law, 7 = G.711 mu-law
+Hot cases (mono and stereo 16 bit, mono 8/24/32 bit, float) have AVX2
+kernels; everything else goes through the scalar loops.
+*******************************************************************/
+
+enum WavAudioFormat {
+    WAV_FORMAT_PCM        = 1,
+    WAV_FORMAT_IEEE_FLOAT = 3,
+    WAV_FORMAT_ALAW       = 6,
+    WAV_FORMAT_MULAW      = 7,
+    WAV_FORMAT_EXTENSIBLE = 0xFFFE
+};
+
+// G.711 expansion to 16 bit linear, as in the ITU reference code
+static int16_t alaw2linear( uint8_t a )
+{
+    a ^= 0x55;
+    int t = (a & 0x0F) << 4;
+    int seg = (a & 0x70) >> 4;
+    if ( seg==0 ) t += 8;
+    else if ( seg==1 ) t += 0x108;
+    else t = (t + 0x108) << (seg-1);
+    return (a & 0x80) ? t : -t;
+}
+
+static int16_t mulaw2linear( uint8_t u )
+{
+    u = ~u;
+    int t = ((u & 0x0F) << 3) + 0x84;
+    t <<= (u & 0x70) >> 4;
+    return (u & 0x80) ? (0x84 - t) : (t - 0x84);
+}
+
+class SampleConverter
+{
+public:
+    SampleConverter() : _format(0), _bits(0), _channels(0), _channel(0), _gain(1), _table_f(), _table_d() {}
+
+    // Returns false if the encoding is not supported
+    bool init( uint16_t format, uint16_t bits, uint16_t channels, uint16_t channel = 0, double gain = 1.0 ) {
+        _format = format;
+        _bits = bits;
+        _channels = channels;
+        _channel = channel;
+        _gain = gain;
+        if ( (channels==0) || (channel>=channels) ) return false;
+        switch ( format ) {
+        case WAV_FORMAT_PCM:
+            return (bits==8) || (bits==16) || (bits==24) || (bits==32);
+        case WAV_FORMAT_IEEE_FLOAT:
+            return (bits==32) || (bits==64);
+        case WAV_FORMAT_ALAW:
+        case WAV_FORMAT_MULAW:
+            if ( bits!=8 ) return false;
+            for ( unsigned j=0; j<256; ++j ) {
+                int16_t v = format==WAV_FORMAT_ALAW ? alaw2linear( j ) : mulaw2linear( j );
+                _table_f[j] = float( v*(gain/32768) );
+                _table_d[j] = v*(gain/32768);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    size_t frameBytes() const {
+        return (_bits/8)*_channels;
+    }
+
+    // Converts n frames starting at src
+    void convert( const uint8_t* src, size_t n, double* dst ) const { run( src, n, dst, _table_d ); }
+    void convert( const uint8_t* src, size_t n, float* dst ) const { run( src, n, dst, _table_f ); }
+
+private:
+    template< typename T >
+    void run( const uint8_t* src, size_t n, T* dst, const T* table ) const {
+        size_t stride = frameBytes();
+        src += (_bits/8)*_channel;
+        size_t j = 0;
+        switch ( _format ) {
+        case WAV_FORMAT_PCM:
+            switch ( _bits ) {
+            case 8: {
+                T scale = _gain/128;
+                j = simd_pcm8( src, n, dst );
+                for ( ; j<n; ++j ) dst[j] = T(int(src[j*stride]) - 128)*scale;
+                break;
+            }
+            case 16: {
+                T scale = _gain/32768;
+                j = simd_pcm16( src, n, dst );
+                for ( ; j<n; ++j ) dst[j] = T(load16( src + j*stride ))*scale;
+                break;
+            }
+            case 24: {
+                T scale = _gain/8388608;
+                j = simd_pcm24( src, n, dst );
+                for ( ; j<n; ++j ) dst[j] = T(load24( src + j*stride ))*scale;
+                break;
+            }
+            case 32: {
+                T scale = _gain/2147483648.0;
+                j = simd_pcm32( src, n, dst );
+                for ( ; j<n; ++j ) dst[j] = T(load32( src + j*stride ))*scale;
+                break;
+            }
+            }
+            break;
+        case WAV_FORMAT_IEEE_FLOAT: {
+            T gain = _gain;
+            if ( _bits==32 ) {
+                j = simd_float( src, n, dst );
+                for ( ; j<n; ++j ) {
+                    float v;
+                    memcpy( &v, src + j*stride, sizeof(v) );
+                    dst[j] = T(v)*gain;
+                }
+            }
+            else {
+                for ( ; j<n; ++j ) {
+                    double v;
+                    memcpy( &v, src + j*stride, sizeof(v) );
+                    dst[j] = T(v)*gain;
+                }
+            }
+            break;
+        }
+        case WAV_FORMAT_ALAW:
+        case WAV_FORMAT_MULAW:
+            for ( ; j<n; ++j ) dst[j] = table[src[j*stride]];
+            break;
+        }
+    }
+
+    static int16_t load16( const uint8_t* p ) {
+        int16_t v;
+        memcpy( &v, p, sizeof(v) );
+        return v;
+    }
+    static int32_t load24( const uint8_t* p ) {
+        return int32_t( (uint32_t(p[0])<<8) | (uint32_t(p[1])<<16) | (uint32_t(p[2])<<24) ) >> 8;
+    }
+    static int32_t load32( const uint8_t* p ) {
+        int32_t v;
+        memcpy( &v, p, sizeof(v) );
+        return v;
+    }
+
+    // The SIMD kernels convert as many leading frames as they can handle
+    // and return that count; the scalar loops above finish the rest.
+#ifdef __AVX2__
+    // 8 int32 lanes times a scale, stored as double or float
+    static void store8( __m256i v, double scale, double* dst ) {
+        __m256d s = _mm256_set1_pd( scale );
+        _mm256_storeu_pd( dst,   _mm256_mul_pd( _mm256_cvtepi32_pd( _mm256_castsi256_si128( v ) ), s ) );
+        _mm256_storeu_pd( dst+4, _mm256_mul_pd( _mm256_cvtepi32_pd( _mm256_extracti128_si256( v, 1 ) ), s ) );
+    }
+    static void store8( __m256i v, double scale, float* dst ) {
+        _mm256_storeu_ps( dst, _mm256_mul_ps( _mm256_cvtepi32_ps( v ), _mm256_set1_ps( float(scale) ) ) );
+    }
+
+    template< typename T >
+    size_t simd_pcm8( const uint8_t* src, size_t n, T* dst ) const {
+        if ( _channels!=1 ) return 0;
+        T scale = _gain/128;
+        const __m256i bias = _mm256_set1_epi32( 128 );
+        size_t j = 0;
+        for ( ; j+8<=n; j+=8 ) {
+            __m128i b = _mm_loadl_epi64( (const __m128i*)(src+j) );
+            store8( _mm256_sub_epi32( _mm256_cvtepu8_epi32( b ), bias ), scale, dst+j );
+        }
+        return j;
+    }
+
+    template< typename T >
+    size_t simd_pcm16( const uint8_t* src, size_t n, T* dst ) const {
+        T scale = _gain/32768;
+        size_t j = 0;
+        if ( _channels==1 ) {
+            for ( ; j+8<=n; j+=8 ) {
+                __m128i w = _mm_loadu_si128( (const __m128i*)(src+2*j) );
+                store8( _mm256_cvtepi16_epi32( w ), scale, dst+j );
+            }
+        }
+        else if ( _channels==2 ) {
+            // src already points at the wanted channel; keep the low
+            // 16 bits of each 32 bit frame and sign extend them
+            for ( ; j+8<=n && (4*j+32<=4*n-2*_channel); j+=8 ) {
+                __m256i f = _mm256_loadu_si256( (const __m256i*)(src+4*j) );
+                store8( _mm256_srai_epi32( _mm256_slli_epi32( f, 16 ), 16 ), scale, dst+j );
+            }
+        }
+        return j;
+    }
+
+    template< typename T >
+    size_t simd_pcm24( const uint8_t* src, size_t n, T* dst ) const {
+        if ( _channels!=1 ) return 0;
+        T scale = _gain/8388608;
+        // Each 128 bit lane holds 4 samples (12 bytes), moved to the top
+        // 3 bytes of each int32 and shifted back down with sign
+        const __m256i shuf = _mm256_setr_epi8( -1,0,1,2, -1,3,4,5, -1,6,7,8, -1,9,10,11,
+                                               -1,0,1,2, -1,3,4,5, -1,6,7,8, -1,9,10,11 );
+        size_t j = 0;
+        // The loads read 4 bytes past the 8 samples
+        for ( ; j+8<=n && (3*j+28<=3*n); j+=8 ) {
+            __m128i lo = _mm_loadu_si128( (const __m128i*)(src+3*j) );
+            __m128i hi = _mm_loadu_si128( (const __m128i*)(src+3*j+12) );
+            __m256i v = _mm256_inserti128_si256( _mm256_castsi128_si256( lo ), hi, 1 );
+            store8( _mm256_srai_epi32( _mm256_shuffle_epi8( v, shuf ), 8 ), scale, dst+j );
+        }
+        return j;
+    }
+
+    template< typename T >
+    size_t simd_pcm32( const uint8_t* src, size_t n, T* dst ) const {
+        if ( _channels!=1 ) return 0;
+        T scale = _gain/2147483648.0;
+        size_t j = 0;
+        for ( ; j+8<=n; j+=8 ) {
+            store8( _mm256_loadu_si256( (const __m256i*)(src+4*j) ), scale, dst+j );
+        }
+        return j;
+    }
+
+    size_t simd_float( const uint8_t* src, size_t n, float* dst ) const {
+        if ( _channels!=1 ) return 0;
+        __m256 g = _mm256_set1_ps( float(_gain) );
+        size_t j = 0;
+        for ( ; j+8<=n; j+=8 ) {
+            _mm256_storeu_ps( dst+j, _mm256_mul_ps( _mm256_loadu_ps( (const float*)(src+4*j) ), g ) );
+        }
+        return j;
+    }
+    size_t simd_float( const uint8_t* src, size_t n, double* dst ) const {
+        if ( _channels!=1 ) return 0;
+        __m256d g = _mm256_set1_pd( _gain );
+        size_t j = 0;
+        for ( ; j+4<=n; j+=4 ) {
+            __m256d v = _mm256_cvtps_pd( _mm_loadu_ps( (const float*)(src+4*j) ) );
+            _mm256_storeu_pd( dst+j, _mm256_mul_pd( v, g ) );
+        }
+        return j;
+    }
+#else
+    template< typename T > size_t simd_pcm8( const uint8_t*, size_t, T* ) const { return 0; }
+    template< typename T > size_t simd_pcm16( const uint8_t*, size_t, T* ) const { return 0; }
+    template< typename T > size_t simd_pcm24( const uint8_t*, size_t, T* ) const { return 0; }
+    template< typename T > size_t simd_pcm32( const uint8_t*, size_t, T* ) const { return 0; }
+    template< typename T > size_t simd_float( const uint8_t*, size_t, T* ) const { return 0; }
+#endif
+
+    uint16_t _format;
+    uint16_t _bits;
+    uint16_t _channels;
+    uint16_t _channel;
+    double _gain;
+    float _table_f[256];
+    double _table_d[256];
+};
@@ -0,0 +1,151 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include "WavFormat.h"
+#include "SoundDecoder.h"
+
+/*******************************************************************
+Decodes one recording as independent segments of whole carrier cycles,
+so the segments can run on different cores. Each segment first runs
+its loop over warmup cycles before its start, then reports its own
+cycles and overlap cycles past its end. stitch() joins the segments:
+in every overlap it resolves the pi ambiguity of the Costas loop, by
+turning the later segment half a cycle if the locked phases disagree
+by about pi, and hands over at the start of the run of cycles, up to
+the end of the overlap, on which both segments have the same lock
+state and phase. Without such a run the earlier segment is kept until
+the end of the overlap.
+*******************************************************************/
+class SegmentedDecoder
+{
+public:
+  static const size_t BLOCK_SAMPLES = 64*1024;
+  static constexpr double PHASE_TOLERANCE = 10;  // [degrees]
+
+  SegmentedDecoder( const std::string& filename, double segment_seconds,
+                    uint32_t overlap_cycles = 200, uint32_t warmup_cycles = 2000 )
+    : _filename( filename ),
+      _segment_seconds( segment_seconds ),
+      _overlap( overlap_cycles ),
+      _warmup( warmup_cycles ),
+      _frames( 0 ),
+      _sample_hz( 0 ),
+      _carrier_samples( 0 ),
+      _segment_frames( 0 ),
+      _flips( 0 ),
+      _unmatched( 0 )
+  {
+  }
+
+  // Reads the header and plans the segments
+  bool open() {
+    WavFileReader reader;
+    if ( !reader.open( _filename ) ) return false;
+    if ( !reader.select( 0 ) ) {
+      printf( "File %s has an unsupported encoding\n", _filename.c_str() );
+      return false;
+    }
+    _frames = reader.frames();
+    _sample_hz = reader.sampleRate();
+    _carrier_samples = SoundDecoder( _sample_hz, NULL ).carrierSamples();
+    _segment_frames = uint64_t( _segment_seconds*_sample_hz/_carrier_samples )*_carrier_samples;
+    if ( _segment_frames==0 ) _segment_frames = _carrier_samples;
+    _parts.resize( _frames==0 ? 1 : (_frames + _segment_frames - 1)/_segment_frames );
+    return true;
+  }
+
+  const std::string& filename() const { return _filename; }
+  uint64_t frames() const { return _frames; }
+  size_t segments() const { return _parts.size(); }
+
+  // Boundaries where the later segment was turned by pi, and where the
+  // segments never agreed within the overlap
+  uint32_t flips() const { return _flips; }
+  uint32_t unmatched() const { return _unmatched; }
+
+  // Decodes one segment. Different segments may run concurrently.
+  bool decode( size_t seg ) {
+    WavFileReader reader;
+    if ( !reader.open( _filename ) || !reader.select( 0 ) ) return false;
+    uint64_t first = seg*_segment_frames;
+    uint64_t warm = uint64_t(_warmup)*_carrier_samples;
+    if ( warm > first ) warm = first;
+    uint64_t last = first + _segment_frames + uint64_t(_overlap)*_carrier_samples;
+    if ( last > _frames ) last = _frames;
+
+    SoundDecoder decoder( _sample_hz, NULL, first - warm, first );
+    if ( !reader.seek( first - warm ) ) return false;
+    std::vector<double> block( BLOCK_SAMPLES );
+    uint64_t len = last - (first - warm);
+    while ( len>0 ) {
+      size_t n = reader.read( &block[0], len < BLOCK_SAMPLES ? len : BLOCK_SAMPLES );
+      if ( n==0 ) return false;
+      decoder.add( &block[0], n );
+      len -= n;
+    }
+    _parts[seg].swap( decoder.cycles );
+    return true;
+  }
+
+  // Joins the decoded segments into cycles, releasing them
+  void stitch( std::vector<DecodedCycle>& cycles ) {
+    cycles.clear();
+    _flips = _unmatched = 0;
+    for ( size_t k=0; k<_parts.size(); ++k ) {
+      std::vector<DecodedCycle>& next = _parts[k];
+      if ( cycles.empty() || next.empty() ) {
+        cycles.insert( cycles.end(), next.begin(), next.end() );
+        std::vector<DecodedCycle>().swap( next );
+        continue;
+      }
+      size_t i0 = cycles.size();
+      while ( (i0>0) && (cycles[i0-1].cycle >= next[0].cycle) ) i0--;
+      size_t n = cycles.size()-i0 < next.size() ? cycles.size()-i0 : next.size();
+
+      // The Costas loop locks at either of two phases pi apart
+      double agree = 0, all = 0;
+      for ( size_t j=0; j<n; ++j ) {
+        double c = cos( (next[j].phase - cycles[i0+j].phase)*M_PI/180 );
+        all += c;
+        if ( locked( next[j] ) && locked( cycles[i0+j] ) ) agree += c;
+      }
+      if ( (agree!=0 ? agree : all) < 0 ) {
+        _flips++;
+        for ( size_t j=0; j<next.size(); ++j ) {
+          next[j].phase += 180;
+          if ( next[j].phase >= 360 ) next[j].phase -= 360;
+        }
+      }
+
+      size_t hand = n;
+      while ( (hand>0) && (locked( next[hand-1] )==locked( cycles[i0+hand-1] )) &&
+              (fabs( remainder( next[hand-1].phase - cycles[i0+hand-1].phase, 360.0 ) ) < PHASE_TOLERANCE) ) {
+        hand--;
+      }
+      if ( (hand==n) && (n>0) ) _unmatched++;
+      cycles.resize( i0 + hand );
+      cycles.insert( cycles.end(), next.begin() + hand, next.end() );
+      std::vector<DecodedCycle>().swap( next );
+    }
+  }
+
+private:
+  static bool locked( const DecodedCycle& c ) {
+    return c.lock > 0.5;
+  }
+
+  std::string _filename;
+  double _segment_seconds;
+  uint32_t _overlap;
+  uint32_t _warmup;
+  uint64_t _frames;
+  uint32_t _sample_hz;
+  uint32_t _carrier_samples;
+  uint64_t _segment_frames;
+  uint32_t _flips;
+  uint32_t _unmatched;
+  std::vector< std::vector<DecodedCycle> > _parts;
+};
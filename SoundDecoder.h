@@ -0,0 +1,146 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include "CostasLoop.h"
+#include "Baseband.h"
+#include "Profiler.h"
+
+// Loop outputs at the end of one carrier cycle
+struct DecodedCycle
+{
+  uint32_t cycle;
+  double freq;       // [Hz]
+  double phase;      // [degrees]
+  double error;
+  double lock;
+};
+
+/*******************************************************************
+Demodulates the carrier produced by WavWriter. Samples are fed in
+blocks of any size, so the whole recording never has to be in memory.
+Each carrier cycle is printed to out as it completes or, with no out,
+appended to cycles. A decoder can start anywhere in a recording and
+warm up before the first cycle it reports. The loop runs in the
+sample type T.
+*******************************************************************/
+template< typename T >
+class SoundDecoderT
+{
+public:
+  static const uint32_t CARRIER_HZ = 1000;
+  static const uint32_t DATAOFF_HZ = 50;
+  static const uint32_t FADE_CYCLES = 10;
+  static const uint32_t DATA_CYCLES = 20;
+
+  // The first sample fed is sample start of the recording. Cycles that
+  // end before sample first only warm the loop up and are not reported.
+  SoundDecoderT( double sample_hz, FILE* out = stdout, uint64_t start = 0, uint64_t first = 0 )
+    : _sample_hz( sample_hz ),
+      _carrier_samples( sample_hz/CARRIER_HZ ),
+      _counter( start % _carrier_samples ),
+      _cycle( start/_carrier_samples ),
+      _pos( start ),
+      _first( first ),
+      _out( out ),
+      _costas( CARRIER_HZ/sample_hz )
+  {
+    _costas.nco = true;
+    // Phase is measured against a carrier that started at sample 0
+    double turns = (double(CARRIER_HZ)/sample_hz)*start;
+    _costas.free_phase = 2*M_PI*(turns - ::floor(turns));
+  }
+
+  // Samples per carrier cycle
+  uint32_t carrierSamples() const {
+    return _carrier_samples;
+  }
+
+  // Samples are normalized to full scale [-1,1)
+  void add( const T* wav, size_t n ) {
+    PROFILE_BLOCK( "SoundDecoder.add", n );
+    for ( size_t j=0; j<n; ++j ) {
+      T sample = T(0.5)*wav[j];
+      _costas.add( sample );
+      if ( ++_counter >= _carrier_samples ) {
+        _counter -= _carrier_samples;
+        if ( _pos+j < _first ) {
+          _cycle++;
+          continue;
+        }
+        PROFILE_SAMPLE( "SoundDecoder.output" );
+        DecodedCycle c;
+        c.cycle = _cycle++;
+        c.freq = _costas.freq*_sample_hz;
+        c.phase = _costas.phase*180/M_PI;
+        c.error = _costas.error;
+        c.lock = _costas.lock;
+        if ( _out ) print( _out, c );
+        else cycles.push_back( c );
+      }
+    }
+    _pos += n;
+  }
+
+  static void print( FILE* out, const DecodedCycle& c ) {
+    fprintf( out, "Cycle:%4d  Freq:%5.1f  Phase:%3.0f Error:%f\n", c.cycle, c.freq, c.phase, c.error );
+  }
+
+  std::vector<DecodedCycle> cycles;
+
+private:
+  double _sample_hz;
+  uint32_t _carrier_samples;
+  uint32_t _counter;
+  uint32_t _cycle;
+  uint64_t _pos;
+  uint64_t _first;
+  FILE* _out;
+  CostasLoopT<T> _costas;
+};
+
+typedef SoundDecoderT<double> SoundDecoder;
+typedef SoundDecoderT<float> SoundDecoderF;
+
+/*******************************************************************
+Same output as SoundDecoder from the complex baseband front end: the
+carrier is mixed down to 0 Hz and decimated to one sample per carrier
+cycle, so the loop runs once per cycle rather than once per sample.
+The sample rate must be a multiple of CARRIER_HZ.
+*******************************************************************/
+class BasebandSoundDecoder
+{
+public:
+  BasebandSoundDecoder( double sample_hz, FILE* out = stdout )
+    : _front( SoundDecoder::CARRIER_HZ/sample_hz, uint32_t( sample_hz/SoundDecoder::CARRIER_HZ ) ),
+      _cycle( 0 ),
+      _out( out ) {}
+
+  // Samples are normalized to full scale [-1,1)
+  void add( const double* wav, size_t n ) {
+    PROFILE_BLOCK( "BasebandSoundDecoder.add", n );
+    if ( _z.size() < _front.outputs( n ) ) _z.resize( _front.outputs( n ) );
+    size_t m = _front.process( wav, n, &_z[0] );
+    for ( size_t k=0; k<m; ++k ) {
+      _loop.add( _z[k] );
+      DecodedCycle c;
+      c.cycle = _cycle++;
+      c.freq = (1 + _loop.freq)*SoundDecoder::CARRIER_HZ;
+      c.phase = _loop.phase*180/M_PI;
+      c.error = _loop.error;
+      c.lock = _loop.lock;
+      if ( _out ) SoundDecoder::print( _out, c );
+      else cycles.push_back( c );
+    }
+  }
+
+  std::vector<DecodedCycle> cycles;
+
+private:
+  BasebandConverter _front;
+  BasebandCostasLoop _loop;
+  std::vector< std::complex<float> > _z;
+  uint32_t _cycle;
+  FILE* _out;
+};
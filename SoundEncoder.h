@@ -0,0 +1,141 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include "FileUtils.h"
+
+/*******************************************************************
+Modulates a byte payload into 16 bit samples. Each bit is a fade
+section followed by a data section. Samples are produced on demand,
+in blocks of any size, so the output never has to be held in memory.
+*******************************************************************/
+class SoundEncoder
+{
+public:
+  static const uint32_t SAMPLE_HZ =  8000;
+  static const uint32_t CARRIER_HZ = 1000;
+  static const uint32_t DATAOFF_HZ = 100;
+  static const uint32_t FADE_CYCLES = 200;
+  static const uint32_t DATA_CYCLES = 400;
+  static const uint32_t FADE_SAMPLES = (FADE_CYCLES*SAMPLE_HZ)/CARRIER_HZ;
+  static const uint32_t DATA_SAMPLES = (DATA_CYCLES*SAMPLE_HZ)/CARRIER_HZ;
+
+  SoundEncoder( const ByteArray& arr )
+    : _arr( arr )
+  {
+    _phase_carrier = 0;
+    _phase_data = 0;
+    _phase_data_off = 0;
+    _phase_clock = 0;
+    _phase_clock_off = 0;
+    _nb = 0;
+    _nbits = 0;
+    _section = START;
+    _left = 0;
+  }
+
+  // Total number of samples for the payload
+  uint64_t size() const {
+    return uint64_t(FADE_SAMPLES+DATA_SAMPLES)*8*_arr.size();
+  }
+
+  // Fills wav with up to n samples, returns how many were produced
+  size_t generate( int16_t* wav, size_t n ) {
+    const double PHASE_CARRIER_INCR = (2*M_PI*CARRIER_HZ)/SAMPLE_HZ;
+    const double PHASE_CLOCK_INCR = (2*M_PI*(CARRIER_HZ+DATAOFF_HZ))/SAMPLE_HZ;
+    const double PHASE_DATA_INCR = (2*M_PI*(CARRIER_HZ+2*DATAOFF_HZ))/SAMPLE_HZ;
+    const double ATTENUATION = 0.5;
+
+    size_t cnt = 0;
+    while ( cnt<n ) {
+      if ( _left==0 && !next() ) break;
+      uint32_t len = n-cnt < _left ? n-cnt : _left;
+      if ( _section==FADE ) {
+        for ( uint32_t nc =0; nc<len; ++nc ) {
+          //double val = ( sin( _phase_carrier ) + sin( _phase_data + _phase_data_off ) + sin( _phase_clock + _phase_clock_off ) )*0.25;
+          double val = ( sin( _phase_carrier ) )*0.25;
+          wav[cnt++] = ATTENUATION*val*32768;
+          _phase_carrier += PHASE_CARRIER_INCR;
+          _phase_clock += PHASE_CLOCK_INCR;
+          _phase_data += PHASE_DATA_INCR;
+          _phase_data_off += _phase_data_incr;
+          _phase_clock_off += _phase_clock_incr;
+        }
+      }
+      else {
+        for ( uint32_t nc =0; nc<len; ++nc ) {
+          //double val = ( sin( _phase_carrier ) + sin( _phase_data + _phase_data_off ) + sin( _phase_clock + _phase_clock_off ) )*0.25;
+          double val = ( sin( _phase_carrier ) );
+          wav[cnt++] = ATTENUATION*val*32768;
+          _phase_carrier += PHASE_CARRIER_INCR;
+          _phase_clock += PHASE_CLOCK_INCR;
+          _phase_data += PHASE_DATA_INCR;
+          _phase_clock_off += _phase_clock_incr;
+        }
+      }
+      _left -= len;
+    }
+    return cnt;
+  }
+
+private:
+  enum Section { START, FADE, DATA };
+
+  // Moves to the next fade or data section, false at the end of the payload
+  bool next() {
+    if ( _section==FADE ) {
+      double target_phase_clock = M_PI/2;
+      _phase_clock_incr = (target_phase_clock - _phase_clock_off)/DATA_SAMPLES;
+      _left = DATA_SAMPLES;
+      _section = DATA;
+      return true;
+    }
+    if ( _section==DATA ) {
+      if ( ++_nbits == 8 ) {
+        _nbits = 0;
+        ++_nb;
+      }
+      _section = START;
+    }
+    if ( _nb >= _arr.size() ) return false;
+
+    // For each bit
+    uint32_t byte = _arr[_nb];
+    uint32_t bit = (byte>>_nbits)&1;
+    double target_phase_data = (bit==0) ? 0 : M_PI/2;
+    double target_phase_clock = 0;
+    _phase_data_incr = (target_phase_data-_phase_data_off)/FADE_SAMPLES;
+    _phase_clock_incr = (target_phase_clock-_phase_clock_off)/FADE_SAMPLES;
+    _left = FADE_SAMPLES;
+    _section = FADE;
+    return true;
+  }
+
+  const ByteArray& _arr;
+  double _phase_carrier;
+  double _phase_data;
+  double _phase_data_off;
+  double _phase_clock;
+  double _phase_clock_off;
+  double _phase_data_incr;
+  double _phase_clock_incr;
+  uint32_t _nb;
+  uint32_t _nbits;
+  Section _section;
+  uint32_t _left;
+};
+
+// Streams the modulated payload to writer block by block. Writer is
+// WavFileWriter or anything else with bool write( const int16_t*, size_t ).
+template< typename Writer >
+bool encodeSound( const ByteArray& arr, Writer& writer )
+{
+  const size_t BLOCK_SAMPLES = 64*1024;
+  SoundEncoder encoder( arr );
+  SampleArray block( BLOCK_SAMPLES );
+  size_t n;
+  while ( (n = encoder.generate( &block[0], block.size() ))>0 ) {
+    if ( !writer.write( &block[0], n ) ) return false;
+  }
+  return true;
+}
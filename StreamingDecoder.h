@@ -0,0 +1,222 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <functional>
+#include <vector>
+#include "SoundDecoder.h"
+
+// The carrier was found or lost
+struct LockEvent
+{
+  uint32_t cycle;      // cycle that decided it
+  uint64_t sample;     // just past the end of that cycle
+  bool locked;
+  double level;        // carrier amplitude [full scale]
+};
+
+// A step in the carrier level: a data section starts on a rise, the
+// fade section of the next symbol on a fall
+struct SymbolTiming
+{
+  uint32_t cycle;      // first cycle at the new level
+  uint64_t sample;     // start of that cycle
+  bool data;
+  double level;        // carrier amplitude [full scale]
+  uint32_t cycles;     // length of the section that ended, from lock for the first
+};
+
+/*******************************************************************
+Carrier amplitude of each cycle, sqrt(2) times its RMS, counted off the
+way SoundDecoder counts cycles, so the levels line up with its cycles
+when both are fed the same samples from the start.
+*******************************************************************/
+template< typename T >
+class CycleLevelMeterT
+{
+public:
+  CycleLevelMeterT( uint32_t carrier_samples )
+    : _carrier_samples( carrier_samples ), _counter( 0 ), _sum( 0 ) {}
+
+  // Appends the level of every cycle the samples complete
+  void add( const T* wav, size_t n ) {
+    for ( size_t k=0; k<n; ++k ) {
+      _sum += double( wav[k] )*wav[k];
+      if ( ++_counter >= _carrier_samples ) {
+        _counter -= _carrier_samples;
+        levels.push_back( sqrt( 2*_sum/_carrier_samples ) );
+        _sum = 0;
+      }
+    }
+  }
+
+  std::vector<double> levels;
+
+private:
+  uint32_t _carrier_samples;
+  uint32_t _counter;
+  double _sum;
+};
+
+/*******************************************************************
+Lock and symbol timing from the cycles of a SoundDecoder and their
+levels. The loop's own lock flag does not rise at the levels WavWriter
+produces, so lock is decided here from the carrier amplitude of each
+cycle and how steady its phase is, with hysteresis over LOCK_CYCLES
+cycles. While locked, a step of more than LEVEL_STEP in amplitude ends
+a section, which gives the symbol timing.
+*******************************************************************/
+class SymbolSlicer
+{
+public:
+  static const uint32_t LOCK_CYCLES = 4;
+  static constexpr double MAX_DRIFT = 20;       // degrees of phase per cycle while locked
+  static constexpr double LEVEL_STEP = 2;
+
+  // Lock needs a carrier amplitude of lock_in, and is lost below lock_out
+  SymbolSlicer( uint32_t carrier_samples, double lock_in = 0.05, double lock_out = 0.025 )
+    : _carrier_samples( carrier_samples ),
+      _lock_in( lock_in ),
+      _lock_out( lock_out ),
+      _last_phase( 0 ),
+      _locked( false ),
+      _run( 0 ),
+      _level( 0 ),
+      _section( 0 ),
+      _in_section( false )
+  {}
+
+  std::function<void( const LockEvent& )> onLock;
+  std::function<void( const SymbolTiming& )> onSymbol;
+
+  void add( const DecodedCycle& c, double level ) {
+    uint64_t end = uint64_t( c.cycle+1 )*_carrier_samples;
+    double drift = fabs( remainder( c.phase - _last_phase, 360.0 ) );
+    _last_phase = c.phase;
+
+    bool carrier = (level > (_locked ? _lock_out : _lock_in)) && (drift < MAX_DRIFT);
+    if ( carrier==_locked ) _run = 0;
+    else if ( ++_run >= LOCK_CYCLES ) {
+      _locked = carrier;
+      _run = 0;
+      _in_section = false;
+      if ( onLock ) {
+        LockEvent e = { c.cycle, end, _locked, level };
+        onLock( e );
+      }
+    }
+    if ( !_locked ) return;
+
+    if ( !_in_section ) {
+      _in_section = true;
+      _section = c.cycle;
+      _level = level;
+      return;
+    }
+    bool rise = level > LEVEL_STEP*_level;
+    bool fall = level*LEVEL_STEP < _level;
+    if ( rise || fall ) {
+      if ( onSymbol ) {
+        SymbolTiming s = { c.cycle, end - _carrier_samples, rise, level, c.cycle - _section };
+        onSymbol( s );
+      }
+      _section = c.cycle;
+      _level = level;
+    }
+    else _level += 0.1*(level - _level);
+  }
+
+  bool locked() const {
+    return _locked;
+  }
+
+private:
+  uint32_t _carrier_samples;
+  double _lock_in;
+  double _lock_out;
+  double _last_phase;
+  bool _locked;
+  uint32_t _run;
+  double _level;       // of the current section, smoothed
+  uint32_t _section;   // first cycle of the current section
+  bool _in_section;
+};
+
+/*******************************************************************
+Push based decoding for live sources. push() takes 16 bit samples as
+they arrive, in blocks of any size, and every callback for them has
+run by the time it returns: the latency is the block pushed. Nothing
+but the decoder state is kept, so a pipe or a sound card can be
+decoded for as long as it runs. onCycle gets the loop outputs of every
+carrier cycle, as SoundDecoder reports them; onLock and onSymbol are
+the SymbolSlicer's.
+*******************************************************************/
+template< typename T >
+class StreamingDecoderT
+{
+public:
+  static const size_t BLOCK = 1024;             // samples converted at a time
+
+  StreamingDecoderT( double sample_hz, double lock_in = 0.05, double lock_out = 0.025 )
+    : _decoder( sample_hz, NULL ),
+      _meter( _decoder.carrierSamples() ),
+      _slicer( _decoder.carrierSamples(), lock_in, lock_out ),
+      _block( BLOCK ),
+      _samples( 0 )
+  {
+    _slicer.onLock = [this]( const LockEvent& e ) { if ( onLock ) onLock( e ); };
+    _slicer.onSymbol = [this]( const SymbolTiming& s ) { if ( onSymbol ) onSymbol( s ); };
+  }
+
+  std::function<void( const DecodedCycle& )> onCycle;
+  std::function<void( const LockEvent& )> onLock;
+  std::function<void( const SymbolTiming& )> onSymbol;
+
+  void push( const int16_t* wav, size_t n ) {
+    while ( n>0 ) {
+      size_t m = n < BLOCK ? n : BLOCK;
+      for ( size_t k=0; k<m; ++k ) _block[k] = T(wav[k])*T(1.0/32768);
+      process( &_block[0], m );
+      wav += m;
+      n -= m;
+    }
+  }
+
+  // Samples normalized to full scale [-1,1)
+  void push( const T* wav, size_t n ) {
+    process( wav, n );
+  }
+
+  bool locked() const {
+    return _slicer.locked();
+  }
+
+  // Samples pushed so far
+  uint64_t samples() const {
+    return _samples;
+  }
+
+private:
+  void process( const T* wav, size_t n ) {
+    _decoder.add( wav, n );
+    _meter.add( wav, n );
+    for ( size_t j=0; j<_decoder.cycles.size(); ++j ) {
+      if ( onCycle ) onCycle( _decoder.cycles[j] );
+      _slicer.add( _decoder.cycles[j], _meter.levels[j] );
+    }
+    _decoder.cycles.clear();
+    _meter.levels.clear();
+    _samples += n;
+  }
+
+  SoundDecoderT<T> _decoder;
+  CycleLevelMeterT<T> _meter;
+  SymbolSlicer _slicer;
+  std::vector<T> _block;
+  uint64_t _samples;
+};
+
+typedef CycleLevelMeterT<double> CycleLevelMeter;
+typedef CycleLevelMeterT<float> CycleLevelMeterF;
+typedef StreamingDecoderT<double> StreamingDecoder;
+typedef StreamingDecoderT<float> StreamingDecoderF;
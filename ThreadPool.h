@@ -0,0 +1,158 @@
+#pragma once
+#include <stddef.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*******************************************************************
+Work stealing thread pool. Every worker owns a deque of tasks: it runs
+its own tasks newest first and, when it runs dry, steals the oldest
+task from another worker. Tasks submitted from a worker go to its own
+deque, so work split up inside a task stays local unless someone is
+idle. Workers can be pinned one per core.
+*******************************************************************/
+class ThreadPool
+{
+public:
+    typedef std::function<void()> Task;
+
+    // threads==0 uses one worker per hardware thread
+    ThreadPool( unsigned threads = 0, bool pin = false )
+      : _queued( 0 ), _pending( 0 ), _stop( false ), _next( 0 )
+    {
+        // hardware_concurrency() is 0 where it cannot tell
+        unsigned cores = std::max( 1u, std::thread::hardware_concurrency() );
+        if ( threads==0 ) threads = cores;
+        _queues.resize( threads );
+        for ( unsigned j=0; j<threads; ++j ) _queues[j] = new Queue;
+        for ( unsigned j=0; j<threads; ++j ) {
+            _threads.push_back( std::thread( &ThreadPool::run, this, j ) );
+            if ( pin ) {
+                cpu_set_t cpus;
+                CPU_ZERO( &cpus );
+                CPU_SET( j % cores, &cpus );
+                if ( pthread_setaffinity_np( _threads.back().native_handle(), sizeof(cpus), &cpus )!=0 ) {
+                    printf( "Could not pin worker %u\n", j );
+                }
+            }
+        }
+    }
+
+    ~ThreadPool() {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock( _mutex );
+            _stop = true;
+        }
+        _wake.notify_all();
+        for ( size_t j=0; j<_threads.size(); ++j ) _threads[j].join();
+        for ( size_t j=0; j<_queues.size(); ++j ) delete _queues[j];
+    }
+
+    unsigned size() const {
+        return _queues.size();
+    }
+
+    void submit( const Task& task ) {
+        unsigned q = (owner()==this) ? worker() : (_next++ % _queues.size());
+        {
+            std::lock_guard<std::mutex> lock( _queues[q]->mutex );
+            _queues[q]->tasks.push_back( task );
+        }
+        {
+            std::lock_guard<std::mutex> lock( _mutex );
+            _queued++;
+            _pending++;
+        }
+        _wake.notify_one();
+    }
+
+    // Blocks until every submitted task, including the ones they
+    // submitted, has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock( _mutex );
+        _idle.wait( lock, [this]{ return _pending==0; } );
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool pop( unsigned self, Task& task ) {
+        {
+            Queue& q = *_queues[self];
+            std::lock_guard<std::mutex> lock( q.mutex );
+            if ( !q.tasks.empty() ) {
+                task = q.tasks.back();
+                q.tasks.pop_back();
+                return true;
+            }
+        }
+        for ( size_t j=1; j<_queues.size(); ++j ) {
+            Queue& q = *_queues[(self+j) % _queues.size()];
+            std::lock_guard<std::mutex> lock( q.mutex );
+            if ( !q.tasks.empty() ) {
+                task = q.tasks.front();
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run( unsigned self ) {
+        worker() = self;
+        owner() = this;
+        for ( ;; ) {
+            {
+                std::unique_lock<std::mutex> lock( _mutex );
+                _wake.wait( lock, [this]{ return _stop || (_queued>0); } );
+                if ( _queued==0 ) return;
+            }
+            // The task counted may have been taken by a worker that has
+            // not uncounted it yet, so try again
+            Task task;
+            if ( !pop( self, task ) ) {
+                std::this_thread::yield();
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock( _mutex );
+                _queued--;
+            }
+            task();
+            std::lock_guard<std::mutex> lock( _mutex );
+            if ( --_pending==0 ) _idle.notify_all();
+        }
+    }
+
+    // Worker index and pool of the calling thread
+    static unsigned& worker() {
+        static thread_local unsigned index = 0;
+        return index;
+    }
+    static ThreadPool*& owner() {
+        static thread_local ThreadPool* pool = NULL;
+        return pool;
+    }
+
+    std::vector<Queue*> _queues;
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+    size_t _queued;
+    size_t _pending;
+    bool _stop;
+    std::atomic<unsigned> _next;
+};
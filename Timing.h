@@ -0,0 +1,14 @@
+#pragma once
+#include <time.h>
+
+/*******************************************************************
+Wall clock for the benchmarks, the tests and the pipeline statistics:
+seconds on the monotonic clock, so differences of two calls are
+elapsed time however the system clock is set.
+*******************************************************************/
+static inline double now()
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec + 1E-9*ts.tv_nsec;
+}
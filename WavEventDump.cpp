@@ -0,0 +1,87 @@
+#include "EventLog.h"
+#include "SoundDecoder.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// The text the decoders and testWaveDecoder printed before they logged
+static void print( FILE* out, const Event& e )
+{
+  switch ( e.type ) {
+  case EVENT_CYCLE: {
+    DecodedCycle c;
+    c.cycle = e.id;
+    c.freq = e.v[0];
+    c.phase = e.v[1];
+    c.error = e.v[2];
+    c.lock = e.v[3];
+    SoundDecoder::print( out, c );
+    break;
+  }
+  case EVENT_PHASE_ADJUST:
+    fprintf( out, "Adjusting %s %ld periods\n", e.id<0 ? "backward" : "forward", e.id<0 ? -e.id : e.id );
+    break;
+  case EVENT_LOCK_IN:
+  case EVENT_LOCK_OUT:
+    fprintf( out, "%s  Cycle: %3ld  Phase: %3.0f %3.0f   Lock: %f %f\n", e.type==EVENT_LOCK_IN ? "LOCK-IN" : "LOCK-OUT",
+             e.id, e.v[0], e.v[1], e.v[2], e.v[3] );
+    break;
+  case EVENT_SYMBOL:
+    fprintf( out, "    symbol: %ld  %d  IC1: %f  %f  %f IC2: %f %f \n", e.id, e.aux, e.v[0], e.v[1], e.v[2], e.v[3],
+             e.v[4] );
+    break;
+  case EVENT_INVALID_SYMBOL:
+    fprintf( out, "    INVALID symbol: %ld  %d  %f  %f\n", e.id, e.aux, e.v[0], e.v[1] );
+    break;
+  case EVENT_TRANSITION:
+    fprintf( out, "Clock transition: %.0f -> %d, cycle %ld\n", e.v[0], e.aux, e.id );
+    break;
+  case EVENT_INTEGRATOR:
+    fprintf( out, "-- count:%ld sample:%f sin:%f cos:%f sq:%f\n", e.id, e.v[0], e.v[1], e.v[2], e.v[3] );
+    break;
+  default:
+    fprintf( out, "Event type %u id %ld aux %d\n", e.type, e.id, e.aux );
+  }
+}
+
+int main( int argc, char* argv[] )
+{
+  bool times = false;
+  std::vector<const char*> args;
+  for ( int j=1; j<argc; ++j ) {
+    if ( strcmp( argv[j], "-time" )==0 ) times = true;
+    else args.push_back( argv[j] );
+  }
+  if ( args.size()!=1 || args[0][0]=='-' ) {
+    printf( "Usage: %s <events> [-time]\n", argv[0] );
+    printf( "Prints an event log written by WavReader -log or testWaveDecoder as text. -time\n" );
+    printf( "puts the seconds since the log was opened and the thread in front of each event.\n" );
+    return 0;
+  }
+
+  const char* filename = args[0];
+  FILE* in = fopen( filename, "rb" );
+  if ( !in ) {
+    printf( "Could not open file %s for reading\n", filename );
+    return 1;
+  }
+  EventLogHeader h;
+  if ( (fread( &h, sizeof(h), 1, in )!=1) || (memcmp( h.magic, "WAVEVT1", 8 )!=0) || (h.record_size!=sizeof(Event)) ) {
+    printf( "File %s is not an event log\n", filename );
+    fclose( in );
+    return 2;
+  }
+
+  std::vector<Event> block( 4096 );
+  size_t n;
+  while ( (n = fread( &block[0], sizeof(Event), block.size(), in ))>0 ) {
+    for ( size_t k=0; k<n; ++k ) {
+      if ( times ) printf( "%12.6f %2u  ", 1E-9*(block[k].time - h.start)/h.ticks_per_ns, block[k].thread );
+      print( stdout, block[k] );
+    }
+  }
+  fclose( in );
+  return 0;
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <stdint.h>
 #include "FileUtils.h"
+#include "SampleConvert.h"
 
 // http://www.topherlee.com/software/pcm-tut-wavformat.html
 struct  WAV_HEADER
@@ -23,22 +24,19 @@ struct  WAV_HEADER
     uint32_t        Subchunk2Size;  // Sampled data length
 } __attribute__((packed));
 
-bool encodeWavFormat( const SampleArray& wav, ByteArray& bytes, uint32_t SAMPLE_HZ ) 
+void fillWavHeader( struct WAV_HEADER& hdr, uint64_t num_samples, uint32_t SAMPLE_HZ )
 {
     const uint32_t num_channels = 1;
     const uint32_t bits_per_sample = 16;
 
-    uint32_t datasize = ((num_channels*bits_per_sample)/8)*wav.size();
-    uint32_t hdrsize = sizeof(struct WAV_HEADER);
-
-    struct WAV_HEADER hdr;
-    memset( &hdr, 0, hdrsize );
-    hdr.ChunkSize = 2*wav.size() - 8;
+    uint64_t datasize = ((num_channels*bits_per_sample)/8)*num_samples;
+    memset( &hdr, 0, sizeof(hdr) );
+    hdr.ChunkSize = datasize + sizeof(struct WAV_HEADER) - 8;
     memcpy( hdr.RIFF, "RIFF", 4 );
     memcpy( hdr.WAVE, "WAVE", 4 );
     memcpy( hdr.fmt, "fmt ", 4 );
 
-    hdr.Subchunk1Size = bits_per_sample;
+    hdr.Subchunk1Size = 16;
     hdr.AudioFormat = 1;
     hdr.NumOfChan = num_channels;
     hdr.SamplesPerSec = SAMPLE_HZ;
@@ -46,30 +44,388 @@ bool encodeWavFormat( const SampleArray& wav, ByteArray& bytes, uint32_t SAMPLE_
     hdr.blockAlign = (bits_per_sample*num_channels)/8;
     hdr.bitsPerSample = bits_per_sample;
     memcpy( hdr.Subchunk2ID, "data", 4 );
-    hdr.Subchunk2Size = ((num_channels*bits_per_sample)/8)*wav.size() - sizeof(struct WAV_HEADER);
+    hdr.Subchunk2Size = datasize;
+}
+
+bool encodeWavFormat( const SampleArray& wav, ByteArray& bytes, uint32_t SAMPLE_HZ ) 
+{
+    uint32_t datasize = sizeof(int16_t)*wav.size();
+    uint32_t hdrsize = sizeof(struct WAV_HEADER);
+
+    struct WAV_HEADER hdr;
+    fillWavHeader( hdr, wav.size(), SAMPLE_HZ );
 
     bytes.resize( datasize + sizeof(struct WAV_HEADER) );
     memcpy( &bytes[0], &hdr, hdrsize );
-    memcpy( &bytes[hdrsize], &wav[0], datasize );
+    if ( datasize>0 ) memcpy( &bytes[hdrsize], &wav[0], datasize );
 
     return true;
 }
 
+/* Generic RIFF sub-chunk header */
+struct RIFF_CHUNK
+{
+    uint8_t         ID[4];
+    uint32_t        Size;           // Payload size, padded to even on disk
+} __attribute__((packed));
+
+/* Payload of the "ds64" chunk of RF64 files (EBU Tech 3306), which
+   carries the sizes that do not fit the 32 bit RIFF fields */
+struct WAV_DS64
+{
+    uint64_t        riffSize;
+    uint64_t        dataSize;
+    uint64_t        sampleCount;
+    uint32_t        tableLength;
+} __attribute__((packed));
+
+/* Payload of the "fmt " chunk */
+struct WAV_FMT
+{
+    uint16_t        AudioFormat;
+    uint16_t        NumOfChan;
+    uint32_t        SamplesPerSec;
+    uint32_t        bytesPerSec;
+    uint16_t        blockAlign;
+    uint16_t        bitsPerSample;
+} __attribute__((packed));
+
 // Everything here is hardcoded for 1 channel, 16 bits
+static bool isMono16( const WAV_FMT& fmt )
+{
+    return (fmt.NumOfChan == 1) && (fmt.bitsPerSample == 16) && (fmt.AudioFormat == 1);
+}
+
+// Walks the chunks of a WAV file held in memory
 bool decodeWavFormat( const ByteArray& bytes, SampleArray& wav, double& freq_hz ) 
 {
-    struct WAV_HEADER* hdr( (struct WAV_HEADER*)&bytes[0] );
-    uint32_t num_samples = (hdr->ChunkSize+8)/2;
-    uint32_t num_channels = hdr->NumOfChan;
-    uint32_t bits_per_sample = hdr->Subchunk1Size;
-    freq_hz = hdr->SamplesPerSec;
-    if ( (num_channels != 1) || ( bits_per_sample != 16 ) || ( hdr->AudioFormat != 1 ) )
+    const uint32_t riffsize = 12;
+    if ( (bytes.size() < riffsize) || (memcmp( &bytes[0], "RIFF", 4 )!=0) || (memcmp( &bytes[8], "WAVE", 4 )!=0) )
         return false;
 
-    uint32_t datasize = ((num_channels*bits_per_sample)/8)*num_samples;
-    uint32_t hdrsize = sizeof(struct WAV_HEADER);
-    
-    wav.resize( num_samples );
-    memcpy( &wav[0], &bytes[hdrsize], datasize );
-    return true;
+    bool have_fmt = false;
+    WAV_FMT fmt;
+    uint64_t offset = riffsize;
+    while ( offset + sizeof(RIFF_CHUNK) <= bytes.size() ) {
+        RIFF_CHUNK chunk;
+        memcpy( &chunk, &bytes[offset], sizeof(chunk) );
+        offset += sizeof(chunk);
+        uint64_t avail = bytes.size() - offset;
+        uint64_t size = chunk.Size < avail ? chunk.Size : avail;
+        if ( memcmp( chunk.ID, "fmt ", 4 )==0 ) {
+            if ( size < sizeof(fmt) ) return false;
+            memcpy( &fmt, &bytes[offset], sizeof(fmt) );
+            have_fmt = true;
+        }
+        else if ( memcmp( chunk.ID, "data", 4 )==0 ) {
+            if ( !have_fmt || !isMono16( fmt ) ) return false;
+            freq_hz = fmt.SamplesPerSec;
+            wav.resize( size/sizeof(int16_t) );
+            if ( !wav.empty() ) memcpy( &wav[0], &bytes[offset], wav.size()*sizeof(int16_t) );
+            return true;
+        }
+        offset += chunk.Size + (chunk.Size & 1);
+    }
+    return false;
 }
+
+/*******************************************************************
+Incremental WAV reader. Walks the RIFF chunks, skipping anything other
+than "fmt " and "data", then hands out the samples in blocks through a
+fixed size buffer, so memory use does not depend on the file size.
+*******************************************************************/
+class WavFileReader
+{
+public:
+    static const size_t BUFFER_SIZE = 256*1024;
+
+    WavFileReader() : _fd(-1), _left(0), _data_start(0), _data_size(0), _pos(0), _len(0) {
+        memset( &_fmt, 0, sizeof(_fmt) );
+    }
+    ~WavFileReader() { close(); }
+
+    // "-" reads standard input, which may be a pipe
+    bool open( const std::string& filename ) {
+        close();
+        _fd = filename=="-" ? ::dup( 0 ) : ::open( filename.c_str(), O_RDONLY );
+        if ( _fd<0 ) {
+            printf( "Could not open file %s for reading\n", filename.c_str() );
+            return false;
+        }
+        ::posix_fadvise( _fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+        _buffer.resize( BUFFER_SIZE );
+        _pos = _len = 0;
+        if ( !readHeader() ) {
+            printf( "File %s is not a WAV file\n", filename.c_str() );
+            close();
+            return false;
+        }
+        select( 0 );
+        return true;
+    }
+
+    void close() {
+        if ( _fd>=0 ) ::close( _fd );
+        _fd = -1;
+        _left = 0;
+    }
+
+    const WAV_FMT& format() const { return _fmt; }
+    uint32_t sampleRate() const { return _fmt.SamplesPerSec; }
+
+    // Frames left in the data chunk, as declared by its header
+    uint64_t framesLeft() const {
+        return _fmt.blockAlign>0 ? _left/_fmt.blockAlign : 0;
+    }
+
+    // Frames in the whole data chunk
+    uint64_t frames() const {
+        return _fmt.blockAlign>0 ? _data_size/_fmt.blockAlign : 0;
+    }
+
+    // Moves the read position to a frame of the data chunk
+    bool seek( uint64_t frame ) {
+        uint64_t offset = frame*_fmt.blockAlign;
+        if ( (_fd<0) || (offset > _data_size) ) return false;
+        if ( ::lseek( _fd, _data_start + offset, SEEK_SET )<0 ) return false;
+        _pos = _len = 0;
+        _left = _data_size - offset;
+        return true;
+    }
+
+    // Selects the channel returned by read( T*, size_t ) and the gain
+    // applied to it. Returns false if the encoding is not supported.
+    bool select( uint16_t channel, double gain = 1.0 ) {
+        return _conv.init( _fmt.AudioFormat, _fmt.bitsPerSample, _fmt.NumOfChan, channel, gain );
+    }
+
+    // Replaces block with up to max_samples samples, returns how many were
+    // read. Only 16 bit mono PCM is supported: anything else reads none.
+    size_t read( SampleArray& block, size_t max_samples ) {
+        if ( !isMono16( _fmt ) ) {
+            block.clear();
+            return 0;
+        }
+        block.resize( max_samples );
+        size_t nb = fill( (uint8_t*)&block[0], max_samples*sizeof(int16_t) );
+        block.resize( nb/sizeof(int16_t) );
+        return block.size();
+    }
+
+    // Reads up to max_frames frames of any supported encoding, converted to
+    // float or double (see SampleConverter). Returns the frames read.
+    template< typename T >
+    size_t read( T* out, size_t max_frames ) {
+        size_t fb = _conv.frameBytes();
+        if ( fb==0 ) return 0;
+        _raw.resize( BUFFER_SIZE - BUFFER_SIZE%fb );
+        size_t done = 0;
+        while ( done < max_frames ) {
+            size_t nf = max_frames - done;
+            if ( nf > _raw.size()/fb ) nf = _raw.size()/fb;
+            nf = fill( &_raw[0], nf*fb )/fb;
+            if ( nf==0 ) break;
+            _conv.convert( &_raw[0], nf, out + done );
+            done += nf;
+        }
+        return done;
+    }
+
+private:
+    bool readHeader() {
+        uint8_t riff[12];
+        if ( fill( riff, sizeof(riff), false )!=sizeof(riff) ) return false;
+        bool rf64 = memcmp( riff, "RF64", 4 )==0;
+        if ( (!rf64 && memcmp( riff, "RIFF", 4 )!=0) || (memcmp( riff+8, "WAVE", 4 )!=0) ) return false;
+        bool have_fmt = false;
+        uint64_t datasize64 = 0;
+        RIFF_CHUNK chunk;
+        while ( fill( (uint8_t*)&chunk, sizeof(chunk), false )==sizeof(chunk) ) {
+            uint64_t padded = chunk.Size + (chunk.Size & 1);
+            if ( rf64 && memcmp( chunk.ID, "ds64", 4 )==0 ) {
+                WAV_DS64 ds64;
+                if ( chunk.Size < sizeof(ds64) ) return false;
+                if ( fill( (uint8_t*)&ds64, sizeof(ds64), false )!=sizeof(ds64) ) return false;
+                if ( !skip( padded - sizeof(ds64) ) ) return false;
+                datasize64 = ds64.dataSize;
+            }
+            else if ( memcmp( chunk.ID, "fmt ", 4 )==0 ) {
+                // WAVE_FORMAT_EXTENSIBLE keeps the real code in the first
+                // two bytes of the SubFormat GUID, at offset 24
+                uint8_t fmt[26];
+                size_t len = chunk.Size < sizeof(fmt) ? chunk.Size : sizeof(fmt);
+                if ( len < sizeof(_fmt) ) return false;
+                if ( fill( fmt, len, false )!=len ) return false;
+                if ( !skip( padded - len ) ) return false;
+                memcpy( &_fmt, fmt, sizeof(_fmt) );
+                if ( (_fmt.AudioFormat==WAV_FORMAT_EXTENSIBLE) && (len==sizeof(fmt)) ) {
+                    memcpy( &_fmt.AudioFormat, &fmt[24], sizeof(_fmt.AudioFormat) );
+                }
+                have_fmt = true;
+            }
+            else if ( memcmp( chunk.ID, "data", 4 )==0 ) {
+                if ( !have_fmt ) return false;
+                _left = (rf64 && chunk.Size==0xFFFFFFFF) ? datasize64 : chunk.Size;
+                int64_t offset = ::lseek( _fd, 0, SEEK_CUR );
+                // A stream written before its length was known: read to the end
+                if ( (offset<0) && (chunk.Size==0 || chunk.Size>=0x7FFFFFFF) ) _left = ~0ULL;
+                _data_size = _left;
+                _data_start = offset - (_len - _pos);
+                return true;
+            }
+            else if ( !skip( padded ) ) return false;
+        }
+        return false;
+    }
+
+    bool skip( uint64_t nbytes ) {
+        uint8_t tmp[4096];
+        while ( nbytes>0 ) {
+            size_t nb = nbytes < sizeof(tmp) ? nbytes : sizeof(tmp);
+            if ( fill( tmp, nb, false )!=nb ) return false;
+            nbytes -= nb;
+        }
+        return true;
+    }
+
+    // Copies up to len bytes from the file, through the buffer. Reads of
+    // the data chunk are limited to its declared size.
+    size_t fill( uint8_t* dst, size_t len, bool data = true ) {
+        if ( data && (len > _left) ) len = _left;
+        size_t done = 0;
+        while ( done < len ) {
+            if ( _pos == _len ) {
+                if ( _fd<0 ) break;
+                int64_t nb = ::read( _fd, &_buffer[0], _buffer.size() );
+                if ( nb<=0 ) break;
+                _pos = 0;
+                _len = nb;
+            }
+            size_t nb = _len - _pos;
+            if ( nb > len - done ) nb = len - done;
+            memcpy( dst + done, &_buffer[_pos], nb );
+            _pos += nb;
+            done += nb;
+        }
+        if ( data ) _left -= done;
+        return done;
+    }
+
+    int _fd;
+    WAV_FMT _fmt;
+    SampleConverter _conv;
+    uint64_t _left;
+    uint64_t _data_start;
+    uint64_t _data_size;
+    ByteArray _buffer;
+    ByteArray _raw;
+    size_t _pos;
+    size_t _len;
+};
+
+
+/*******************************************************************
+Incremental 16 bit mono WAV writer. The header is written up front
+with empty sizes and patched by close(), so samples can be appended
+block by block. A JUNK chunk reserves room for the RF64 ds64 chunk,
+which replaces it when the data outgrows the 32 bit RIFF sizes.
+*******************************************************************/
+class WavFileWriter
+{
+public:
+    WavFileWriter() : _fd(-1), _samples(0) {}
+    ~WavFileWriter() { close(); }
+
+    bool open( const std::string& filename, uint32_t sample_hz ) {
+        close();
+        _fd = ::open( filename.c_str(), O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP );
+        if ( _fd<0 ) {
+            printf( "%s\n", strerror( errno ) );
+            printf( "Could not open file [%s] for writing\n", filename.c_str() );
+            return false;
+        }
+        _filename = filename;
+        _sample_hz = sample_hz;
+        _samples = 0;
+        ByteArray hdr;
+        header( hdr );
+        return put( &hdr[0], hdr.size() );
+    }
+
+    bool write( const int16_t* wav, size_t n ) {
+        if ( !put( (const uint8_t*)wav, n*sizeof(int16_t) ) ) return false;
+        _samples += n;
+        return true;
+    }
+
+    // Patches the header sizes and closes the file, and unless quiet says
+    // how much was written
+    bool close( bool quiet = false ) {
+        if ( _fd<0 ) return true;
+        ByteArray hdr;
+        header( hdr );
+        bool ok = ::pwrite( _fd, &hdr[0], hdr.size(), 0 )==int64_t(hdr.size());
+        ::close( _fd );
+        _fd = -1;
+        if ( !quiet ) {
+            printf( "Wrote %lu bytes to %s\n", uint64_t(hdr.size() + _samples*sizeof(int16_t)), _filename.c_str() );
+        }
+        return ok;
+    }
+
+    uint64_t samples() const {
+        return _samples;
+    }
+
+private:
+    // RIFF, JUNK/ds64, fmt and data headers for the samples written so far
+    void header( ByteArray& bytes ) const {
+        struct WAV_HEADER hdr;
+        fillWavHeader( hdr, _samples, _sample_hz );
+        RIFF_CHUNK junk;
+        WAV_DS64 ds64;
+        memset( &ds64, 0, sizeof(ds64) );
+        memcpy( junk.ID, "JUNK", 4 );
+        junk.Size = sizeof(ds64);
+
+        uint64_t datasize = _samples*sizeof(int16_t);
+        uint64_t riffsize = datasize + sizeof(hdr) + sizeof(junk) + sizeof(ds64) - 8;
+        hdr.ChunkSize = riffsize;
+        if ( riffsize > 0xFFFFFFFFULL ) {
+            memcpy( hdr.RIFF, "RF64", 4 );
+            memcpy( junk.ID, "ds64", 4 );
+            ds64.riffSize = riffsize;
+            ds64.dataSize = datasize;
+            ds64.sampleCount = _samples;
+            hdr.ChunkSize = 0xFFFFFFFF;
+            hdr.Subchunk2Size = 0xFFFFFFFF;
+        }
+
+        // RIFF/WAVE, then JUNK or ds64, then fmt and data
+        const size_t riffhdr = 12;
+        bytes.resize( sizeof(hdr) + sizeof(junk) + sizeof(ds64) );
+        uint8_t* p = &bytes[0];
+        memcpy( p, &hdr, riffhdr ); p += riffhdr;
+        memcpy( p, &junk, sizeof(junk) ); p += sizeof(junk);
+        memcpy( p, &ds64, sizeof(ds64) ); p += sizeof(ds64);
+        memcpy( p, ((const uint8_t*)&hdr) + riffhdr, sizeof(hdr) - riffhdr );
+    }
+
+    bool put( const uint8_t* data, size_t len ) {
+        while ( len>0 ) {
+            int64_t nb = ::write( _fd, data, len );
+            if ( nb<=0 ) {
+                printf( "%s\n", strerror( errno ) );
+                return false;
+            }
+            data += nb;
+            len -= nb;
+        }
+        return true;
+    }
+
+    int _fd;
+    std::string _filename;
+    uint32_t _sample_hz;
+    uint64_t _samples;
+};
@@ -1,48 +1,460 @@
 #include "WavFormat.h"
-#include "BandPassFilters.h"
-#include "LowPassFilters.h"
 #include "FileUtils.h"
-#include "Integrators.h"
-#include "CostasLoop.h"
+#include "SoundDecoder.h"
+#include "StreamingDecoder.h"
+#include "Resampler.h"
+#include "FixedPoint.h"
+#include "SegmentedDecoder.h"
+#include "ThreadPool.h"
+#include "PipelinedDecoder.h"
+#include "Profiler.h"
+#include "EventLog.h"
+#include "Timing.h"
 
-const uint32_t CARRIER_HZ = 1000;
-const uint32_t DATAOFF_HZ = 50;
-const uint32_t FADE_CYCLES = 10;
-const uint32_t DATA_CYCLES = 20;
+#include <dirent.h>
+#include <strings.h>
+#include <algorithm>
+#include <deque>
+#include <mutex>
 
-bool decodeSound( const SampleArray& wav, ByteArray& out, double SAMPLE_HZ ) 
+const size_t BLOCK_SAMPLES = 64*1024;
+
+// reader.read(), timed by the profiler
+template< typename T >
+static size_t readBlock( WavFileReader& reader, T* out, size_t max_frames )
+{
+  PROFILE_BLOCK( "WavReader.read", 0 );
+  size_t n = reader.read( out, max_frames );
+  PROFILE_SAMPLES( n );
+  return n;
+}
+
+// Moves the cycles a decoder has collected to the event log
+static void logCycles( std::vector<DecodedCycle>& cycles )
+{
+  EventLog& log( EventLog::instance() );
+  for ( const DecodedCycle& c: cycles ) log.log( EVENT_CYCLE, c.cycle, 0, c.freq, c.phase, c.error, c.lock );
+  cycles.clear();
+}
+
+// Feeds the recording to decoder, resampled to rate if one is given.
+// Cycles the decoder collects rather than prints go to the event log.
+template< typename Decoder >
+static void decodeBlocks( WavFileReader& reader, Decoder& decoder, PolyphaseResampler* resampler )
+{
+  PROFILE_BLOCK( "WavReader.decodeBlocks", reader.framesLeft() );
+  std::vector<double> block( BLOCK_SAMPLES );
+  std::vector<double> resampled( resampler ? resampler->outputs( BLOCK_SAMPLES ) : 0 );
+  size_t n;
+  while ( (n = readBlock( reader, &block[0], BLOCK_SAMPLES ))>0 ) {
+    if ( resampler ) {
+      size_t m = resampler->process( &block[0], n, &resampled[0] );
+      decoder.add( &resampled[0], m );
+    }
+    else decoder.add( &block[0], n );
+    logCycles( decoder.cycles );
+  }
+}
+
+// The float decoder reads float samples; resampling stays in double
+static void decodeBlocks( WavFileReader& reader, SoundDecoderF& decoder, PolyphaseResampler* resampler )
+{
+  PROFILE_BLOCK( "WavReader.decodeBlocks", reader.framesLeft() );
+  std::vector<float> samples( resampler ? resampler->outputs( BLOCK_SAMPLES ) : BLOCK_SAMPLES );
+  size_t n;
+  if ( resampler ) {
+    std::vector<double> block( BLOCK_SAMPLES ), resampled( samples.size() );
+    while ( (n = readBlock( reader, &block[0], BLOCK_SAMPLES ))>0 ) {
+      size_t m = resampler->process( &block[0], n, &resampled[0] );
+      for ( size_t k=0; k<m; ++k ) samples[k] = resampled[k];
+      decoder.add( &samples[0], m );
+      logCycles( decoder.cycles );
+    }
+  }
+  else {
+    while ( (n = readBlock( reader, &samples[0], BLOCK_SAMPLES ))>0 ) {
+      decoder.add( &samples[0], n );
+      logCycles( decoder.cycles );
+    }
+  }
+}
+
+// Fixed point baseband decoding straight from the 16 bit samples
+bool decodeFixed( WavFileReader& reader )
+{
+  if ( !isMono16( reader.format() ) ) {
+    printf( "Fixed point decoding needs 16 bit mono PCM\n" );
+    return false;
+  }
+  if ( (reader.sampleRate() % SoundDecoder::CARRIER_HZ)!=0 ) {
+    printf( "Fixed point decoding needs a multiple of %u Hz\n", SoundDecoder::CARRIER_HZ );
+    return false;
+  }
+  FixedBasebandDecoder decoder( reader.sampleRate() );
+  SampleArray block;
+  while ( reader.read( block, BLOCK_SAMPLES )>0 ) decoder.add( block );
+  return true;
+}
+
+// With a rate, the recording is resampled to it before the decoder runs.
+// A multiple of CARRIER_HZ keeps the cycles on whole samples, which the
+// baseband decoder requires. single runs the passband decoder in float.
+// With log the cycles go to the event log instead of stdout.
+bool decodeSound( WavFileReader& reader, ByteArray& out, uint32_t rate = 0, bool baseband = false, bool single = false,
+                  bool log = false )
+{
+  FILE* text = log ? NULL : stdout;
+  uint32_t hz = rate>0 ? rate : reader.sampleRate();
+  PolyphaseResampler* resampler = NULL;
+  if ( hz!=reader.sampleRate() ) resampler = new PolyphaseResampler( reader.sampleRate(), hz );
+  if ( baseband ) {
+    if ( (hz % SoundDecoder::CARRIER_HZ)!=0 ) {
+      printf( "Baseband decoding needs a multiple of %u Hz, use -rate\n", SoundDecoder::CARRIER_HZ );
+      delete resampler;
+      return false;
+    }
+    BasebandSoundDecoder decoder( hz, text );
+    decodeBlocks( reader, decoder, resampler );
+  }
+  else if ( single ) {
+    SoundDecoderF decoder( hz, text );
+    decodeBlocks( reader, decoder, resampler );
+  }
+  else {
+    SoundDecoder decoder( hz, text );
+    decodeBlocks( reader, decoder, resampler );
+  }
+  delete resampler;
+  return true;
+}
+
+// What the streaming and pipelined modes print, cycles to the event
+// log rather than stdout if one is open
+static void outputCycle( const DecodedCycle& c )
+{
+  EventLog& log( EventLog::instance() );
+  if ( log.enabled() ) log.log( EVENT_CYCLE, c.cycle, 0, c.freq, c.phase, c.error, c.lock );
+  else SoundDecoder::print( stdout, c );
+}
+
+static void outputLock( const LockEvent& e )
+{
+  printf( "%s  Cycle: %3u  Sample: %lu  Level: %f\n", e.locked ? "LOCK-IN" : "LOCK-OUT", e.cycle, e.sample, e.level );
+}
+
+static void outputSymbol( const SymbolTiming& s )
+{
+  printf( "%s  Cycle: %3u  Sample: %lu  Level: %f  After: %u cycles\n", s.data ? "DATA" : "FADE", s.cycle, s.sample,
+          s.level, s.cycles );
+}
+
+// Decodes a live source, standard input say, as the samples arrive.
+// Each block is on stdout by the time the next one is read.
+bool decodeStream( WavFileReader& reader )
+{
+  if ( !isMono16( reader.format() ) ) {
+    printf( "Streaming needs 16 bit mono PCM\n" );
+    return false;
+  }
+  const size_t STREAM_BLOCK = 1024;
+  StreamingDecoder decoder( reader.sampleRate() );
+  decoder.onCycle = outputCycle;
+  decoder.onLock = outputLock;
+  decoder.onSymbol = outputSymbol;
+  SampleArray block;
+  while ( reader.read( block, STREAM_BLOCK )>0 ) {
+    decoder.push( &block[0], block.size() );
+    fflush( stdout );
+  }
+  return true;
+}
+
+/*******************************************************************
+Pipelined mode: the streaming decode split into stages on their own
+cores by PipelinedDecoder, so one stream is not held to the speed of
+one core. The output is the same as the streaming mode's. Stage times
+and ring occupancy go to stderr.
+*******************************************************************/
+bool decodePipelined( WavFileReader& reader, uint32_t rate = 0, bool pin = false )
+{
+  PipelinedDecoder decoder( reader.sampleRate(), rate );
+  decoder.onCycle = []( const DecodedCycle& c, double ) { outputCycle( c ); };
+  decoder.onLock = outputLock;
+  decoder.onSymbol = outputSymbol;
+  decoder.onBlock = []() { fflush( stdout ); };
+
+  Pipeline pipeline( pin );
+  decoder.stages( pipeline, [&reader]( double* samples, size_t max ) { return reader.read( samples, max ); } );
+  pipeline.run();
+  pipeline.report( stderr );
+  return true;
+}
+
+/*******************************************************************
+Batch mode. Every file is cut into segments by SegmentedDecoder, and
+every segment is one task on the pool, so a huge file does not become
+the tail. The last segment of a file to finish stitches the file and
+writes its cycles to outdir.
+*******************************************************************/
+struct BatchFile
+{
+  BatchFile( const std::string& in, double segment_seconds, uint32_t overlap )
+    : decoder( in, segment_seconds, overlap ) {}
+
+  SegmentedDecoder decoder;
+  std::string out;
+  std::mutex mutex;
+  size_t left;
+  double start;
+  double end;
+  bool ok;
+};
+
+static void decodeSegment( BatchFile& file, size_t seg )
+{
+  double t0 = now();
+  bool ok = file.decoder.decode( seg );
+
+  std::lock_guard<std::mutex> lock( file.mutex );
+  file.ok = file.ok && ok;
+  if ( t0 < file.start ) file.start = t0;
+  if ( --file.left > 0 ) return;
+
+  std::vector<DecodedCycle> cycles;
+  file.decoder.stitch( cycles );
+  FILE* fout = fopen( file.out.c_str(), "w" );
+  if ( fout==NULL ) {
+    printf( "Could not open file %s for writing\n", file.out.c_str() );
+    file.ok = false;
+  }
+  else {
+    for ( size_t c=0; c<cycles.size(); ++c ) SoundDecoder::print( fout, cycles[c] );
+    fclose( fout );
+  }
+  file.end = now();
+}
+
+// A manifest lists one file per line; a directory contributes its .wav files
+static bool listInputs( const std::string& path, std::vector<std::string>& files )
 {
-  const uint32_t CARRIER_SAMPLES =  SAMPLE_HZ/CARRIER_HZ;
-  uint32_t counter = 0;
-  uint32_t cycle = 0;
-  CostasLoop costas( CARRIER_HZ/SAMPLE_HZ );
-  for ( uint32_t j=0; j<wav.size(); ++j ) {
-    double sample = double(wav[j])/65536;
-    costas.add( sample );
-    if ( ++counter >= CARRIER_SAMPLES ) {
-      counter -= CARRIER_SAMPLES;
-      printf( "Cycle:%4d  Freq:%5.1f  Phase:%3.0f Error:%f\n",
-	      cycle++, costas.freq*SAMPLE_HZ, costas.phase*180/M_PI, costas.error );
+  struct stat st;
+  if ( ::stat( path.c_str(), &st )!=0 ) {
+    printf( "Could not find %s\n", path.c_str() );
+    return false;
+  }
+  if ( S_ISDIR( st.st_mode ) ) {
+    DIR* dir = opendir( path.c_str() );
+    if ( dir==NULL ) return false;
+    std::vector<std::string> names;
+    while ( struct dirent* e = readdir( dir ) ) {
+      std::string name = e->d_name;
+      if ( (name.size()>4) && (strcasecmp( name.c_str()+name.size()-4, ".wav" )==0) ) {
+        names.push_back( path + "/" + name );
+      }
+    }
+    closedir( dir );
+    std::sort( names.begin(), names.end() );
+    files.insert( files.end(), names.begin(), names.end() );
+    return true;
+  }
+  ByteArray text;
+  if ( !readFile( path, text ) ) return false;
+  std::string line;
+  for ( size_t j=0; j<=text.size(); ++j ) {
+    if ( (j==text.size()) || (text[j]=='\n') || (text[j]=='\r') ) {
+      if ( !line.empty() && (line[0]!='#') ) files.push_back( line );
+      line.clear();
     }
+    else line += char(text[j]);
   }
+  return true;
+}
+
+static std::string baseName( const std::string& path )
+{
+  size_t slash = path.rfind( '/' );
+  std::string name = slash==std::string::npos ? path : path.substr( slash+1 );
+  size_t dot = name.rfind( '.' );
+  return dot==std::string::npos ? name : name.substr( 0, dot );
 }
 
-int main( int argc, char* argv[] ) 
+static int decodeBatch( const std::string& input, const std::string& outdir,
+                        unsigned threads, bool pin, double segment_seconds, uint32_t overlap )
 {
-    if ( argc<=2 ) {
-        printf( "Usage: %s <infile> <outfile>\n", argv[0] );
+  std::vector<std::string> names;
+  if ( !listInputs( input, names ) ) return 1;
+
+  std::deque<BatchFile> files;
+  uint64_t total = 0;
+  for ( size_t j=0; j<names.size(); ++j ) {
+    files.emplace_back( names[j], segment_seconds, overlap );
+    BatchFile& f = files.back();
+    if ( !f.decoder.open() ) {
+      files.pop_back();
+      continue;
+    }
+    f.out = outdir + "/" + baseName( names[j] ) + ".txt";
+    f.left = f.decoder.segments();
+    f.start = 1E300;
+    f.end = 0;
+    f.ok = true;
+    total += f.decoder.frames();
+  }
+
+  double t0 = now();
+  {
+    ThreadPool pool( threads, pin );
+    threads = pool.size();
+    // Largest files first, so they do not become the tail
+    std::vector<BatchFile*> order;
+    for ( size_t j=0; j<files.size(); ++j ) order.push_back( &files[j] );
+    std::stable_sort( order.begin(), order.end(),
+                      []( const BatchFile* a, const BatchFile* b ) { return a->decoder.frames() > b->decoder.frames(); } );
+    for ( size_t j=0; j<order.size(); ++j ) {
+      for ( size_t s=0; s<order[j]->decoder.segments(); ++s ) {
+        BatchFile* f = order[j];
+        pool.submit( [f,s]() { decodeSegment( *f, s ); } );
+      }
+    }
+    pool.wait();
+  }
+  double t1 = now();
+
+  std::string summary_name = outdir + "/summary.txt";
+  FILE* summary = fopen( summary_name.c_str(), "w" );
+  int failures = 0;
+  for ( FILE* out : { stdout, summary } ) {
+    if ( out==NULL ) continue;
+    for ( size_t j=0; j<files.size(); ++j ) {
+      const BatchFile& f = files[j];
+      fprintf( out, "File:%s  Samples:%lu  Segments:%lu  Flips:%u  Unmatched:%u  Latency:%.3fs  Decode:%.3fs  %s\n",
+               f.decoder.filename().c_str(), f.decoder.frames(), f.decoder.segments(), f.decoder.flips(),
+               f.decoder.unmatched(), f.end - t0, f.end - f.start, f.ok ? "OK" : "FAILED" );
+    }
+    fprintf( out, "Files:%lu  Samples:%lu  Threads:%u  Time:%.3fs  Rate:%.2f Msamples/s\n",
+             files.size(), total, threads, t1-t0, 1E-6*total/(t1-t0) );
+  }
+  if ( summary ) fclose( summary );
+  for ( size_t j=0; j<files.size(); ++j ) {
+    if ( !files[j].ok ) failures++;
+  }
+  return failures==0 ? 0 : 5;
+}
+
+// Decodes one file with its segments spread over the pool
+static bool decodeParallel( const std::string& input, unsigned threads, bool pin,
+                            double segment_seconds, uint32_t overlap )
+{
+  SegmentedDecoder decoder( input, segment_seconds, overlap );
+  if ( !decoder.open() ) return false;
+  std::vector<char> ok( decoder.segments() );
+  {
+    ThreadPool pool( threads, pin );
+    for ( size_t s=0; s<decoder.segments(); ++s ) {
+      pool.submit( [&decoder,&ok,s]() { ok[s] = decoder.decode( s ); } );
+    }
+    pool.wait();
+  }
+  for ( size_t s=0; s<ok.size(); ++s ) {
+    if ( !ok[s] ) return false;
+  }
+  std::vector<DecodedCycle> cycles;
+  decoder.stitch( cycles );
+  for ( size_t c=0; c<cycles.size(); ++c ) SoundDecoder::print( stdout, cycles[c] );
+  return true;
+}
+
+int main( int argc, char* argv[] )
+{
+    bool batch = false;
+    unsigned threads = 0;
+    bool pin = false;
+    double segment = 60;
+    uint32_t overlap = 200;
+    uint32_t rate = 0;
+    bool baseband = false;
+    bool fixed = false;
+    bool single = false;
+    bool pipelined = false;
+    const char* log = NULL;
+    std::vector<std::string> args;
+    for ( int j=1; j<argc; ++j ) {
+        if ( strcmp( argv[j], "-batch" )==0 ) batch = true;
+        else if ( (strcmp( argv[j], "-threads" )==0) && (j+1<argc) ) threads = atoi( argv[++j] );
+        else if ( (strcmp( argv[j], "-segment" )==0) && (j+1<argc) ) segment = atof( argv[++j] );
+        else if ( (strcmp( argv[j], "-overlap" )==0) && (j+1<argc) ) overlap = atoi( argv[++j] );
+        else if ( (strcmp( argv[j], "-rate" )==0) && (j+1<argc) ) rate = atoi( argv[++j] );
+        else if ( strcmp( argv[j], "-baseband" )==0 ) baseband = true;
+        else if ( strcmp( argv[j], "-fixed" )==0 ) fixed = true;
+        else if ( strcmp( argv[j], "-float" )==0 ) single = true;
+        else if ( strcmp( argv[j], "-pin" )==0 ) pin = true;
+        else if ( strcmp( argv[j], "-pipeline" )==0 ) pipelined = true;
+        else if ( (strcmp( argv[j], "-log" )==0) && (j+1<argc) ) log = argv[++j];
+        else args.push_back( argv[j] );
+    }
+    if ( args.size()!=2 ) {
+        printf( "Usage: %s <infile> <outfile> -threads N [-pin] [-segment seconds] [-overlap cycles]\n", argv[0] );
+        printf( "       %s <infile> <outfile> [-rate Hz] [-baseband | -float] [-log events]\n", argv[0] );
+        printf( "       %s <infile> <outfile> -fixed\n", argv[0] );
+        printf( "       %s - <outfile> [-log events]      reads a 16 bit mono stream from stdin\n", argv[0] );
+        printf( "       %s <infile|-> <outfile> -pipeline [-rate Hz] [-pin] [-log events]\n", argv[0] );
+        printf( "       %s -batch <manifest|directory> <outdir> [-threads N] [-pin] [-segment seconds] [-overlap cycles]\n", argv[0] );
         return 0;
     }
+    // Without -batch, -threads 0 and 1 both decode on this thread, in any
+    // of the modes. More threads segment the file and run the plain
+    // SoundDecoder on each segment, as -batch does, so take no mode
+    bool parallel = threads>1;
+    if ( (batch || parallel) && (rate || baseband || fixed || single || pipelined) ) {
+        printf( "%s: -rate, -baseband, -float, -fixed and -pipeline do not combine with %s\n", argv[0],
+                batch ? "-batch" : "-threads above 1" );
+        return 1;
+    }
+    if ( parallel && !batch && (args[0]=="-") ) {
+        printf( "%s: stdin cannot be split into segments, drop -threads\n", argv[0] );
+        return 1;
+    }
+    if ( fixed && (rate || baseband || single) ) {
+        printf( "%s: -fixed runs at the file's rate in 16 bit, without -rate, -baseband or -float\n", argv[0] );
+        return 1;
+    }
+    if ( baseband && single ) {
+        printf( "%s: -baseband and -float are alternatives, pick one\n", argv[0] );
+        return 1;
+    }
+    if ( pipelined && (baseband || single || fixed) ) {
+        printf( "%s: -baseband, -float and -fixed do not combine with -pipeline\n", argv[0] );
+        return 1;
+    }
+    if ( !pipelined && !batch && (args[0]=="-") && (rate || baseband || fixed || single) ) {
+        printf( "%s: -rate, -baseband, -float and -fixed do not combine with streaming from stdin\n", argv[0] );
+        return 1;
+    }
+    if ( log && !EventLog::instance().open( log ) ) return 4;
+    if ( batch ) return decodeBatch( args[0], args[1], threads, pin, segment, overlap );
 
-    ByteArray bufin;
-    SampleArray samples;
     ByteArray bufout;
-    double freq_hz;
-
-    if ( !readFile( argv[1], bufin ) ) return 1;
-    if ( !decodeWavFormat( bufin, samples, freq_hz ) ) return 2;
-    if ( !decodeSound( samples, bufout, freq_hz ) ) return 3;
-    if ( !writeFile( argv[2], bufout ) ) return 4;
+    if ( parallel ) {
+        // Segments of one file on several cores, stitched at the overlaps
+        if ( !decodeParallel( args[0], threads, pin, segment, overlap ) ) return 3;
+    }
+    else {
+        WavFileReader reader;
+        if ( !reader.open( args[0] ) ) return 1;
+        if ( !reader.select( 0 ) ) return 2;
+        if ( pipelined ) {
+            if ( !decodePipelined( reader, rate, pin ) ) return 3;
+        }
+        else if ( args[0]=="-" ) {
+            if ( !decodeStream( reader ) ) return 3;
+        }
+        else if ( fixed ) {
+            if ( !decodeFixed( reader ) ) return 3;
+        }
+        else if ( !decodeSound( reader, bufout, rate, baseband, single, log!=NULL ) ) return 3;
+    }
+    if ( !writeFile( args[1], bufout ) ) return 4;
+    if ( !EventLog::instance().close() ) return 4;
 
     return 0;
 }
@@ -0,0 +1,99 @@
+#include "WavFormat.h"
+#include "FFT.h"
+#include "Timing.h"
+
+#include <stdlib.h>
+
+/** Writes the waterfall of a WAV file: one frame of dB magnitudes per
+hop. The binary output starts with SPEC_HEADER and holds bins() floats
+per frame; -text writes one line per frame instead. Reports the peak of
+every frame as a quick check of carrier health */
+
+const size_t BLOCK_SAMPLES = 64*1024;
+
+struct SPEC_HEADER
+{
+  char ID[4];           // "SPEC"
+  uint32_t fftSize;
+  uint32_t hop;
+  uint32_t sampleRate;
+  uint32_t bins;
+};
+
+int main( int argc, char* argv[] )
+{
+  unsigned fft = 1024;
+  unsigned hop = 512;
+  bool text = false;
+  std::vector<const char*> args;
+  for ( int j=1; j<argc; ++j ) {
+    if ( (strcmp( argv[j], "-fft" )==0) && (j+1<argc) ) fft = atoi( argv[++j] );
+    else if ( (strcmp( argv[j], "-hop" )==0) && (j+1<argc) ) hop = atoi( argv[++j] );
+    else if ( strcmp( argv[j], "-text" )==0 ) text = true;
+    else args.push_back( argv[j] );
+  }
+  if ( (args.size()!=2) || (fft<2) || ((fft & (fft-1))!=0) || (hop==0) ) {
+    printf( "Usage: %s <infile> <outfile> [-fft N] [-hop H] [-text]\n", argv[0] );
+    printf( "       N is a power of two, default 1024; H defaults to 512\n" );
+    return 0;
+  }
+
+  WavFileReader reader;
+  if ( !reader.open( args[0] ) ) return 1;
+  if ( !reader.select( 0 ) ) return 2;
+  FILE* out = fopen( args[1], text ? "w" : "wb" );
+  if ( out==NULL ) {
+    printf( "Could not open file %s for writing\n", args[1] );
+    return 4;
+  }
+
+  Spectrogram spec( fft, hop );
+  double hz_per_bin = double(reader.sampleRate())/fft;
+  if ( !text ) {
+    SPEC_HEADER hdr;
+    memcpy( hdr.ID, "SPEC", 4 );
+    hdr.fftSize = fft;
+    hdr.hop = hop;
+    hdr.sampleRate = reader.sampleRate();
+    hdr.bins = spec.bins();
+    fwrite( &hdr, sizeof(hdr), 1, out );
+  }
+
+  std::vector<double> block( BLOCK_SAMPLES );
+  std::vector<float> row( spec.bins() );
+  double peak_min = 1E300, peak_max = -1E300, level_sum = 0;
+  uint64_t frames = 0, samples = 0;
+  double t0 = now();
+  size_t n;
+  while ( (n = reader.read( &block[0], BLOCK_SAMPLES ))>0 ) {
+    samples += n;
+    spec.add( &block[0], n, [&]( uint64_t frame, const std::vector<double>& db ) {
+      unsigned peak = 0;
+      for ( unsigned k=0; k<db.size(); ++k ) {
+        if ( db[k] > db[peak] ) peak = k;
+      }
+      peak_min = fmin( peak_min, peak*hz_per_bin );
+      peak_max = fmax( peak_max, peak*hz_per_bin );
+      level_sum += db[peak];
+      frames++;
+      if ( text ) {
+        fprintf( out, "Time:%.4f", double(frame)*hop/reader.sampleRate() );
+        for ( unsigned k=0; k<db.size(); ++k ) fprintf( out, " %.1f", db[k] );
+        fprintf( out, "\n" );
+      }
+      else {
+        for ( unsigned k=0; k<db.size(); ++k ) row[k] = db[k];
+        fwrite( &row[0], sizeof(float), row.size(), out );
+      }
+    } );
+  }
+  double t1 = now();
+  fclose( out );
+
+  printf( "Wrote %lu frames of %u bins to %s\n", frames, spec.bins(), args[1] );
+  if ( frames>0 ) {
+    printf( "Peak between %.1f and %.1f Hz, mean level %.1f dB\n", peak_min, peak_max, level_sum/frames );
+  }
+  printf( "%lu samples in %.3fs, %.2f Msamples/s\n", samples, t1-t0, 1E-6*samples/(t1-t0) );
+  return 0;
+}
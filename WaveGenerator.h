@@ -3,6 +3,7 @@
 #include <functional>
 #include <complex>
 #include <limits>
+#include <stddef.h>
 #include <stdint.h>
 #include <math.h>
 
@@ -50,6 +51,25 @@ public:
     _amp += _amp_inc;
   }
 
+  // Block version of step(): the same wave, with the oscillator run by
+  // CordicGenerator::generate() between changes of target
+  void generate( double* out, size_t n ) {
+    size_t j = 0;
+    while ( j<n ) {
+      if ( _countdown==0 ) {
+        recalc();
+      }
+      size_t m = n-j < _countdown ? n-j : _countdown;
+      _cordic.generate( &out[j], NULL, m );
+      for ( size_t k=j; k<j+m; ++k ) {
+        out[k] *= _amp;
+        _amp += _amp_inc;
+      }
+      _countdown -= m;
+      j += m;
+    }
+  }
+
 private:
   void recalc() {
     double old_phase = _target.phase;
@@ -0,0 +1,262 @@
+#include "WavFormat.h"
+#include "BandPassFilters.h"
+#include "LowPassFilters.h"
+#include "CostasLoop.h"
+#include "CordicGenerator.h"
+#include "CordicQueueIntegrator.h"
+#include "DCT.h"
+#include "SoundEncoder.h"
+#include "SoundDecoder.h"
+#include "Timing.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/** Throughput of every DSP block and of the codec end to end. Each case
+is run until it has taken long enough to time, and the fastest run is
+kept. Prints a table and writes the results as JSON, to the file given
+or to benchWavDecoder.json. Cycles are time stamp counter ticks, which
+run at the nominal clock whatever the core is doing; they are 0 where
+there is no counter. -quick runs shorter and smaller, as a smoke test */
+
+static uint64_t ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+struct BenchResult
+{
+  std::string name;
+  size_t size;          // block or payload size the case was run at
+  uint64_t samples;     // samples per run
+  unsigned reps;
+  double ns;            // per sample
+  double cycles;        // per sample
+};
+
+static std::vector<BenchResult> results;
+static double min_seconds = 0.25;
+// Results feed this so the work cannot be optimized away
+static volatile double sink;
+
+// Runs run() once to warm up, then until min_seconds have gone by, and
+// at least 3 times, and keeps the fastest
+template< typename Run >
+static void bench( const char* name, size_t size, uint64_t samples, Run run )
+{
+  run();
+  double best = 1E30;
+  uint64_t best_ticks = 0;
+  unsigned reps = 0;
+  double start = now();
+  while ( reps < 3 || now() - start < min_seconds ) {
+    double t0 = now();
+    uint64_t c0 = ticks();
+    run();
+    uint64_t c1 = ticks();
+    double t1 = now();
+    if ( t1 - t0 < best ) {
+      best = t1 - t0;
+      best_ticks = c1 - c0;
+    }
+    reps++;
+  }
+  BenchResult r;
+  r.name = name;
+  r.size = size;
+  r.samples = samples;
+  r.reps = reps;
+  r.ns = 1E9*best/samples;
+  r.cycles = double( best_ticks )/samples;
+  results.push_back( r );
+  printf( "%-24s %9lu %10lu samples %4u reps %9.2f Msamples/s %8.2f ns %8.2f cycles\n", name, size, samples, reps,
+          1E3/r.ns, r.ns, r.cycles );
+}
+
+// Keeps the samples, as encodeSound would write them to a file
+struct MemoryWriter
+{
+  bool write( const int16_t* wav, size_t n ) {
+    samples.insert( samples.end(), wav, wav + n );
+    return true;
+  }
+  SampleArray samples;
+};
+
+static void benchBlocks( size_t size )
+{
+  // A tone under noise, and the clean carrier of the codec for the loop,
+  // which reports every period it slips
+  std::vector<double> x( size ), y( size ), z( size ), carrier( size );
+  for ( size_t m=0; m<size; ++m ) {
+    x[m] = 0.3*cos( 2*M_PI*0.125*m + 1.0 ) + double( rand() )/RAND_MAX - 0.5;
+    carrier[m] = 0.5*sin( 2*M_PI*0.125*m );
+  }
+
+  {
+    BandPassFilter f( 0.125, 0.02, 8 );
+    bench( "BandPassFilter.add", size, size, [&]() {
+      for ( size_t m=0; m<size; ++m ) y[m] = f.add( x[m] );
+      sink = y[size-1];
+    } );
+    bench( "BandPassFilter.process", size, size, [&]() {
+      f.process( &x[0], &y[0], size );
+      sink = y[size-1];
+    } );
+  }
+  {
+    BiquadLowPassFilter f( 1/sqrt(2.0), 0.01 );
+    bench( "BiquadLowPassFilter.add", size, size, [&]() {
+      for ( size_t m=0; m<size; ++m ) y[m] = f.add( x[m] );
+      sink = y[size-1];
+    } );
+  }
+  {
+    CostasLoop c( 0.125 );
+    c.nco = true;
+    bench( "CostasLoop.add", size, size, [&]() {
+      for ( size_t m=0; m<size; ++m ) c.add( carrier[m] );
+      sink = c.phase;
+    } );
+  }
+  {
+    CordicGenerator g( 0.125 );
+    bench( "CordicGenerator.generate", size, size, [&]() {
+      g.generate( &y[0], &z[0], size );
+      sink = y[size-1] + z[size-1];
+    } );
+  }
+  {
+    CordicQueueIntegrator it( 800, 0.125 );
+    bench( "CordicQueueIntegrator", size, size, [&]() {
+      it.process( &x[0], size );
+      sink = it.level();
+    } );
+  }
+  {
+    std::vector<double> freqs;
+    freqs.push_back( 0.125 );
+    freqs.push_back( 0.13125 );
+    freqs.push_back( 0.1375 );
+    DCTArray d( freqs );
+    bench( "DCTArray.add", size, size, [&]() {
+      for ( size_t m=0; m<size; ++m ) d.add( x[m] );
+      sink = d[0].mag();
+    } );
+  }
+}
+
+static bool benchCodec( size_t bytes, const std::string& tmp )
+{
+  ByteArray payload( bytes );
+  for ( size_t j=0; j<bytes; ++j ) payload[j] = rand();
+  uint64_t samples = SoundEncoder( payload ).size();
+
+  MemoryWriter mem;
+  bench( "encodeSound", bytes, samples, [&]() {
+    mem.samples.clear();
+    encodeSound( payload, mem );
+    sink = mem.samples.back();
+  } );
+
+  ByteArray wavfile;
+  encodeWavFormat( mem.samples, wavfile, SoundEncoder::SAMPLE_HZ );
+  SampleArray wav;
+  double hz = 0;
+  bench( "decodeWavFormat", bytes, samples, [&]() {
+    decodeWavFormat( wavfile, wav, hz );
+    sink = wav.back();
+  } );
+
+  // Through a file and both ends of the codec, without the report close()
+  // prints by default
+  std::vector<double> block( 64*1024 );
+  bool ok = true;
+  bench( "WavWriter-WavReader", bytes, samples, [&]() {
+    WavFileWriter writer;
+    if ( !writer.open( tmp, SoundEncoder::SAMPLE_HZ ) || !encodeSound( payload, writer ) ||
+         !writer.close( true ) ) {
+      ok = false;
+      return;
+    }
+    WavFileReader reader;
+    if ( !reader.open( tmp ) ) {
+      ok = false;
+      return;
+    }
+    SoundDecoder decoder( reader.sampleRate(), NULL );
+    size_t n;
+    while ( (n = reader.read( &block[0], block.size() ))>0 ) decoder.add( &block[0], n );
+    sink = decoder.cycles.size();
+  } );
+  ::unlink( tmp.c_str() );
+  if ( !ok ) printf( "WavWriter-WavReader: could not write and read back %s\n", tmp.c_str() );
+  return ok;
+}
+
+static bool writeJson( const std::string& filename )
+{
+  FILE* f = fopen( filename.c_str(), "w" );
+  if ( !f ) {
+    printf( "Could not open file [%s] for writing\n", filename.c_str() );
+    return false;
+  }
+#ifdef __AVX2__
+  const char* avx2 = "true";
+#else
+  const char* avx2 = "false";
+#endif
+  fprintf( f, "{\n  \"benchmark\": \"benchWavDecoder\",\n  \"avx2\": %s,\n  \"min_seconds\": %g,\n  \"results\": [\n",
+           avx2, min_seconds );
+  for ( size_t j=0; j<results.size(); ++j ) {
+    const BenchResult& r( results[j] );
+    fprintf( f, "    { \"name\": \"%s\", \"size\": %lu, \"samples\": %lu, \"reps\": %u, "
+                "\"samples_per_s\": %.6g, \"ns_per_sample\": %.6g, \"cycles_per_sample\": %.6g }%s\n",
+             r.name.c_str(), r.size, r.samples, r.reps, 1E9/r.ns, r.ns, r.cycles, j+1<results.size() ? "," : "" );
+  }
+  fprintf( f, "  ]\n}\n" );
+  bool ok = fclose( f )==0;
+  printf( "Wrote %lu results to %s\n", results.size(), filename.c_str() );
+  return ok;
+}
+
+int main( int argc, char* argv[] )
+{
+  bool quick = false;
+  std::string json = "benchWavDecoder.json";
+  for ( int j=1; j<argc; ++j ) {
+    if ( strcmp( argv[j], "-quick" )==0 ) quick = true;
+    else if ( argv[j][0]=='-' ) {
+      printf( "Usage: %s [-quick] [results.json]\n", argv[0] );
+      return 1;
+    }
+    else json = argv[j];
+  }
+  if ( quick ) min_seconds = 0.01;
+  srand( 42 );
+
+  const char* tmpdir = getenv( "TMPDIR" );
+  std::string tmp = std::string( tmpdir ? tmpdir : "/tmp" ) + "/benchWavDecoder.wav";
+
+  // In the first level cache, in the second, and streaming from memory
+  benchBlocks( 4096 );
+  benchBlocks( 65536 );
+  if ( !quick ) benchBlocks( 1<<20 );
+
+  // Payload bytes; each is 38400 samples
+  bool ok = benchCodec( 4, tmp ) && benchCodec( 32, tmp ) && (quick || benchCodec( 256, tmp ));
+
+  return writeJson( json ) && ok ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#include "Baseband.h"
+#include "CostasLoop.h"
+#include "CordicQueueIntegrator.h"
+#include "Timing.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/** Runs a carrier with a tone 100 Hz above it through the baseband front
+end and checks the baseband Costas loop and integrator against their
+passband versions, then compares the speed of the two decoders */
+
+// Distance between two phases in degrees, modulo period
+static double distance( double a, double b, double period )
+{
+  return fabs( remainder( (a-b)*180/M_PI, period ) );
+}
+
+int main()
+{
+  const double FS = 8000, FC = 1000, OFF = 100;
+  const uint32_t DECIM = 8;
+  const double PHI = 0.7, PSI = 2.1;
+  int failures = 0;
+
+  const size_t LEN = 800000;
+  std::vector<double> x( LEN );
+  for ( size_t m=0; m<LEN; ++m ) {
+    x[m] = 0.5*cos( 2*M_PI*(FC+0.5)/FS*m + PHI ) + 0.3*cos( 2*M_PI*(FC+OFF)/FS*m + PSI );
+  }
+
+  BasebandConverter front( FC/FS, DECIM );
+  std::vector< std::complex<float> > z( front.outputs( LEN ) );
+  z.resize( front.process( &x[0], LEN, &z[0] ) );
+
+  // Carrier phase and frequency, both loops on the same signal
+  {
+    BasebandCostasLoop bb;
+    bb.process( &z[0], z.size() );
+    CostasLoop pb( FC/FS );
+    pb.nco = true;
+    for ( size_t m=0; m<LEN; ++m ) pb.add( 0.5*x[m] );
+    // The half hertz offset has turned the carrier by this much at the end
+    double expected = PHI + 2*M_PI*0.5*LEN/FS;
+    double dbb = distance( bb.phase, expected, 180 );
+    double dpb = distance( pb.phase, expected, 180 );
+    double freq = (1 + bb.freq)*FS/DECIM;
+    bool ok = (dbb < 2) && (fabs( freq - (FC+0.5) ) < 0.01) && (bb.lock > 0.9);
+    printf( "Costas: baseband phase %.1f off by %.2f deg, passband off by %.2f deg, freq %.3f Hz, lock %.3f  %s\n",
+            bb.phase*180/M_PI, dbb, dpb, freq, bb.lock, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  // Tone above the carrier, a whole number of beat periods in the window
+  {
+    BasebandIntegrator bb( 100, OFF*DECIM/FS );
+    CordicQueueIntegrator pb( 100*DECIM, (FC+OFF)/FS );
+    for ( size_t k=0; k<z.size(); ++k ) bb.add( z[k] );
+    for ( size_t m=0; m<LEN; ++m ) pb.add( x[m] );
+    // The front end delays the tone; take that out of the baseband phase
+    double bb_phase = bb.phase() - 2*M_PI*OFF/FS*front.delay();
+    double d = distance( bb_phase, pb.phase(), 360 );
+    double dref = distance( pb.phase(), -PSI, 360 );
+    bool ok = (d < 2) && (dref < 2) && (fabs( bb.level() - pb.level() ) < 0.01);
+    printf( "Integrator: baseband %.1f deg level %.3f, passband %.1f deg level %.3f  %s\n",
+            fmod( bb_phase*180/M_PI + 720, 360 ), bb.level(), pb.phase()*180/M_PI, pb.level(), ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  {
+    CostasLoop pb( FC/FS );
+    pb.nco = true;
+    double t0 = now();
+    for ( size_t m=0; m<LEN; ++m ) pb.add( 0.5*x[m] );
+    double t1 = now();
+    BasebandConverter front( FC/FS, DECIM );
+    BasebandCostasLoop bb;
+    std::vector< std::complex<float> > blk( front.outputs( 4096 ) );
+    for ( size_t m=0; m<LEN; m+=4096 ) {
+      size_t k = front.process( &x[m], LEN-m < 4096 ? LEN-m : 4096, &blk[0] );
+      bb.process( &blk[0], k );
+    }
+    double t2 = now();
+    printf( "Passband loop %.1f Msamples/s, baseband front end and loop %.1f Msamples/s (%.1fx)\n",
+            1E-6*LEN/(t1-t0), 1E-6*LEN/(t2-t1), (t1-t0)/(t2-t1) );
+    // Keep the work from being optimized away
+    if ( pb.phase + bb.phase < -1 ) failures++;
+  }
+
+  return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+#include "BandPassFilters.h"
+#include "BandPassFilterBank.h"
+#include "Timing.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+/** Checks that BandPassFilter::process() matches add() bit for bit
+for every supported order and for arbitrary block boundaries, that
+every BandPassFilterBank channel matches a standalone filter, then
+compares the throughput of both */
+
+int main()
+{
+  const uint32_t NS = 100000;
+  std::vector<double> input( NS );
+  srand( 42 );
+  for ( uint32_t j=0; j<NS; ++j ) {
+    input[j] = sin( 2*M_PI*0.1*j ) + double(rand())/RAND_MAX - 0.5;
+  }
+
+  int failures = 0;
+  for ( int order=2; order<=16; order+=2 ) {
+    BandPassFilter ref( 0.1, 0.02, order );
+    BandPassFilter blk( 0.1, 0.02, order );
+    std::vector<double> expected( NS );
+    std::vector<double> output( NS );
+    for ( uint32_t j=0; j<NS; ++j ) expected[j] = ref.add( input[j] );
+
+    uint32_t pos = 0;
+    while ( pos<NS ) {
+      uint32_t len = rand() % 100;
+      if ( len > NS-pos ) len = NS-pos;
+      blk.process( &input[pos], &output[pos], len );
+      pos += len;
+    }
+    bool ok = memcmp( &expected[0], &output[0], NS*sizeof(double) )==0;
+    ok = ok && ( ref.value()==blk.value() );
+    printf( "Order:%2d  %s\n", order, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  // Channels of mixed order, more than one register wide
+  {
+    const int NC = 6;
+    BandPassFilterBank bank;
+    std::vector<BandPassFilter> ref;
+    for ( int c=0; c<NC; ++c ) {
+      double fc = 0.05 + 0.05*c;
+      int order = 2 + 2*(c%4);
+      bank.add_channel( fc, 0.02, order );
+      ref.push_back( BandPassFilter( fc, 0.02, order ) );
+    }
+    std::vector<double> output( NS*NC );
+    bank.process( &input[0], &output[0], NS );
+    bool ok = true;
+    for ( uint32_t j=0; j<NS; ++j ) {
+      for ( int c=0; c<NC; ++c ) {
+        if ( ref[c].add( input[j] ) != output[j*NC+c] ) ok = false;
+      }
+    }
+    printf( "Bank:     %s\n", ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  const int order = 8;
+  const uint32_t REPEAT = 50;
+  BandPassFilter bp1( 0.1, 0.02, order );
+  BandPassFilter bp2( 0.1, 0.02, order );
+  std::vector<double> output( NS );
+  double t0 = now();
+  for ( uint32_t r=0; r<REPEAT; ++r ) {
+    for ( uint32_t j=0; j<NS; ++j ) output[j] = bp1.add( input[j] );
+  }
+  double t1 = now();
+  for ( uint32_t r=0; r<REPEAT; ++r ) {
+    bp2.process( &input[0], &output[0], NS );
+  }
+  double t2 = now();
+  printf( "Order %d  add: %6.1f Msamples/s  process: %6.1f Msamples/s\n", order,
+          1E-6*NS*REPEAT/(t1-t0), 1E-6*NS*REPEAT/(t2-t1) );
+
+  BandPassFilter bp3( 0.10, 0.02, 4 );
+  BandPassFilter bp4( 0.15, 0.02, 4 );
+  BandPassFilter bp5( 0.20, 0.02, 4 );
+  BandPassFilterBank bank;
+  bank.add_channel( 0.10, 0.02, 4 );
+  bank.add_channel( 0.15, 0.02, 4 );
+  bank.add_channel( 0.20, 0.02, 4 );
+  double sum = 0;
+  double t3 = now();
+  for ( uint32_t r=0; r<REPEAT; ++r ) {
+    for ( uint32_t j=0; j<NS; ++j ) {
+      sum += bp3.add( input[j] ) + bp4.add( input[j] ) + bp5.add( input[j] );
+    }
+  }
+  double t4 = now();
+  for ( uint32_t r=0; r<REPEAT; ++r ) {
+    for ( uint32_t j=0; j<NS; ++j ) {
+      bank.add( input[j] );
+      sum -= bank.value(0) + bank.value(1) + bank.value(2);
+    }
+  }
+  double t5 = now();
+  printf( "3 channels order 4  filters: %6.1f Msamples/s  bank: %6.1f Msamples/s (%g)\n",
+          1E-6*NS*REPEAT/(t4-t3), 1E-6*NS*REPEAT/(t5-t4), sum );
+
+  return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+#include "CordicGenerator.h"
+#include "CordicQueueIntegrator.h"
+#include "WaveGenerator.h"
+#include "Timing.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/** Checks CordicGenerator::generate() against the exact tone and against
+advance(), runs it long enough, in whole blocks and in calls shorter
+than a block, to show that its magnitude stays put while advance()
+drifts, checks the block versions of WaveGenerator and
+CordicQueueIntegrator against their per sample versions, and compares
+the speeds */
+
+// Largest distance of the generated samples from exp(i 2 pi fc m), in
+// random blocks, and of advance() run over the same samples
+template< typename T >
+static int checkTone( double fc, size_t len, double tol )
+{
+  CordicGeneratorT<T> blk( fc ), one( fc );
+  std::vector<T> re( len ), im( len );
+  for ( size_t m=0; m<len; ) {
+    size_t n = 1 + rand()%1000;
+    if ( n > len-m ) n = len-m;
+    blk.generate( &re[m], &im[m], n );
+    m += n;
+  }
+  double err = 0, err_one = 0;
+  for ( size_t m=0; m<len; ++m ) {
+    long double a = 2*M_PI*(long double)fc*m;
+    long double s = sinl( a ), c = cosl( a );
+    err = fmax( err, hypotl( re[m] - s, im[m] - c ) );
+    err_one = fmax( err_one, hypotl( one.real() - s, one.imag() - c ) );
+    one.advance();
+  }
+  bool ok = err < tol;
+  printf( "%s fc %.4f: %lu samples, generate() max error %.2e, advance() %.2e  %s\n",
+          sizeof(T)==4 ? "float " : "double", fc, len, err, err_one, ok ? "OK" : "MISMATCH" );
+  return ok ? 0 : 1;
+}
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+
+  // What is left is the rounding of the step, which turns the phase
+  // away at a constant rate: about 1E-16 radians per block
+  failures += checkTone<double>( 0.125, 1000000, 1E-10 );
+  failures += checkTone<double>( 1000/22050., 1000000, 1E-10 );
+  failures += checkTone<double>( 0.3141, 1000000, 1E-10 );
+  failures += checkTone<float>( 1000/22050., 1000000, 1E-6 );
+
+  {
+    // A long run: generate() renormalizes, advance() is left to drift
+    const size_t LEN = 400000000, BLOCK = 4096;
+    CordicGenerator blk( 1000/22050. ), one( 1000/22050. );
+    std::vector<double> re( BLOCK ), im( BLOCK );
+    double mag = 0;
+    double t0 = now();
+    for ( size_t m=0; m<LEN; m+=BLOCK ) {
+      blk.generate( &re[0], &im[0], BLOCK );
+      mag = fmax( mag, fabs( hypot( re[BLOCK-1], im[BLOCK-1] ) - 1 ) );
+    }
+    double t1 = now();
+    for ( size_t m=0; m<LEN; ++m ) one.advance();
+    double t2 = now();
+    double drift = fabs( hypot( one.real(), one.imag() ) - 1 );
+    bool ok = mag < 1E-14;
+    printf( "%lu samples: generate() magnitude error %.2e, advance() %.2e  %s\n", LEN, mag, drift,
+            ok ? "OK" : "MISMATCH" );
+    printf( "generate() %.1f Msamples/s, advance() %.1f Msamples/s (%.1fx)\n", 1E-6*LEN/(t1-t0),
+            1E-6*LEN/(t2-t1), (t2-t1)/(t1-t0) );
+    if ( !ok ) failures++;
+  }
+
+  {
+    // Calls shorter than a block, as MultiWindowIntegrator makes one
+    // sample at a time, renormalize as well
+    const size_t LEN = 50000000;
+    CordicGenerator blk( 1000/22050. );
+    double re[CordicGenerator::LANES], im[CordicGenerator::LANES];
+    double mag = 0;
+    for ( size_t m=0; m<LEN; ) {
+      size_t n = 1 + rand()%(CordicGenerator::LANES-1);
+      blk.generate( re, im, n );
+      mag = fmax( mag, fabs( hypot( re[n-1], im[n-1] ) - 1 ) );
+      m += n;
+    }
+    bool ok = mag < 1E-14;
+    printf( "%lu samples in calls of 1 to %u: generate() magnitude error %.2e  %s\n", LEN,
+            CordicGenerator::LANES-1, mag, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  {
+    // Phase steps and amplitude ramps of varying lengths. Each generator
+    // runs its own copy of the schedule.
+    unsigned k = 0;
+    auto schedule = [k]( WaveGenerator::State& t ) mutable {
+      t.steps = 37 + (k*13)%200;
+      t.phase = M_PI*((k*7)%4)/2;
+      t.amplitude = 0.5 + 0.25*(k%3);
+      k++;
+    };
+    WaveGenerator one( 0.05, schedule ), blk( 0.05, schedule );
+    std::vector<double> y( 100000 ), z( y.size() );
+    for ( size_t m=0; m<y.size(); ++m ) y[m] = one.step();
+    for ( size_t m=0; m<z.size(); ) {
+      size_t n = 1 + (m*7919)%500;
+      if ( n > z.size()-m ) n = z.size()-m;
+      blk.generate( &z[m], n );
+      m += n;
+    }
+    double err = 0;
+    for ( size_t m=0; m<y.size(); ++m ) err = fmax( err, fabs( y[m] - z[m] ) );
+    bool ok = err < 1E-9;
+    printf( "WaveGenerator: generate() against step() max difference %.2e  %s\n", err, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  {
+    const size_t LEN = 2000000;
+    std::vector<double> x( LEN );
+    for ( size_t m=0; m<LEN; ++m ) x[m] = 0.3*cos( 2*M_PI*0.125*m + 1.0 ) + double( rand() )/RAND_MAX - 0.5;
+    CordicQueueIntegrator one( 800, 0.125 ), blk( 800, 0.125 );
+    double t0 = now();
+    for ( size_t m=0; m<LEN; ++m ) one.add( x[m] );
+    double t1 = now();
+    blk.process( &x[0], LEN );
+    double t2 = now();
+    double dphase = fabs( remainder( one.phase() - blk.phase(), 2*M_PI ) );
+    double dlevel = fabs( one.level() - blk.level() );
+    bool ok = (dphase < 1E-9) && (dlevel < 1E-9);
+    printf( "CordicQueueIntegrator: process() against add() phase %.2e level %.2e, %.1f against %.1f Msamples/s  %s\n",
+            dphase, dlevel, 1E-6*LEN/(t2-t1), 1E-6*LEN/(t1-t0), ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#include "WavFormat.h"
+#include "CostasLoop.h"
+#include "CostasLoopBank.h"
+#include "Timing.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+/** Runs the Costas loop with libm sin/cos and with the table NCO over
+samplewav.wav and over a long synthetic carrier, and checks that phase,
+frequency, lock and error agree. Then runs a CostasLoopBank over many
+streams against one CostasLoop per stream. Also compares the speeds */
+
+static double phase_diff( double a, double b )
+{
+  double d = fmod( a - b, 2*M_PI );
+  if ( d>M_PI ) d -= 2*M_PI;
+  if ( d<-M_PI ) d += 2*M_PI;
+  return fabs( d );
+}
+
+static int compare( const char* name, const std::vector<double>& samples, double fc, double phase_tol,
+                    double tol )
+{
+  CostasLoop ref( fc );
+  CostasLoop nco( fc );
+  nco.nco = true;
+  double dphase = 0, dfreq = 0, dlock = 0, derror = 0;
+  for ( size_t j=0; j<samples.size(); ++j ) {
+    ref.add( samples[j] );
+    nco.add( samples[j] );
+    dphase = fmax( dphase, phase_diff( ref.phase, nco.phase ) );
+    dfreq = fmax( dfreq, fabs( ref.freq - nco.freq ) );
+    dlock = fmax( dlock, fabs( ref.lock - nco.lock ) );
+    derror = fmax( derror, fabs( ref.error - nco.error ) );
+  }
+  bool ok = (dphase<phase_tol) && (dfreq<tol) && (dlock<tol) && (derror<tol);
+  printf( "%s: %lu samples  max diff phase:%g freq:%g lock:%g error:%g  %s\n", name, samples.size(),
+          dphase, dfreq, dlock, derror, ok ? "OK" : "MISMATCH" );
+
+  double t0 = now();
+  for ( size_t j=0; j<samples.size(); ++j ) ref.add( samples[j] );
+  double t1 = now();
+  for ( size_t j=0; j<samples.size(); ++j ) nco.add( samples[j] );
+  double t2 = now();
+  printf( "%s: libm %6.2f Msamples/s  nco %6.2f Msamples/s\n", name,
+          1E-6*samples.size()/(t1-t0), 1E-6*samples.size()/(t2-t1) );
+  return ok ? 0 : 1;
+}
+
+static int compare_bank( const std::vector<double>& samples, double fc, size_t streams, size_t N )
+{
+  // Every stream gets its own carrier, gain and offset into the recording
+  std::vector<double> fcs( streams );
+  for ( size_t s=0; s<streams; ++s ) fcs[s] = fc*(1.0 + 0.002*(s%7));
+  std::vector<double> input( N*streams );
+  for ( size_t j=0; j<N; ++j ) {
+    for ( size_t s=0; s<streams; ++s ) {
+      input[j*streams+s] = (0.5 + 0.1*(s%5))*samples[(j + 977*s)%samples.size()];
+    }
+  }
+
+  std::vector<CostasLoop> loops;
+  for ( size_t s=0; s<streams; ++s ) {
+    loops.push_back( CostasLoop( fcs[s] ) );
+    loops.back().nco = true;
+  }
+  CostasLoopBank bank( fcs );
+  std::vector<double> phase( N*streams ), freq( N*streams );
+  bank.process( &input[0], N, &phase[0], &freq[0] );
+
+  double dphase = 0, dfreq = 0, dlock = 0, derror = 0;
+  for ( size_t s=0; s<streams; ++s ) {
+    for ( size_t j=0; j<N; ++j ) {
+      loops[s].add( input[j*streams+s] );
+      dphase = fmax( dphase, phase_diff( loops[s].phase, phase[j*streams+s] ) );
+      dfreq = fmax( dfreq, fabs( loops[s].freq - freq[j*streams+s] ) );
+    }
+    dlock = fmax( dlock, fabs( loops[s].lock - bank.lock[s] ) );
+    derror = fmax( derror, fabs( loops[s].error - bank.error[s] ) );
+  }
+  bool ok = (dphase<1E-6) && (dfreq<1E-9) && (dlock<1E-9) && (derror<1E-9);
+  printf( "bank: %lu streams x %lu samples  max diff phase:%g freq:%g lock:%g error:%g  %s\n",
+          streams, N, dphase, dfreq, dlock, derror, ok ? "OK" : "MISMATCH" );
+
+  double t0 = now();
+  for ( size_t s=0; s<streams; ++s ) {
+    for ( size_t j=0; j<N; ++j ) loops[s].add( input[j*streams+s] );
+  }
+  double t1 = now();
+  bank.process( &input[0], N );
+  double t2 = now();
+  printf( "bank: %lu lanes  loops %6.2f Msamples/s  bank %6.2f Msamples/s\n", CostasLoopBank::LANES,
+          1E-6*N*streams/(t1-t0), 1E-6*N*streams/(t2-t1) );
+  return ok ? 0 : 1;
+}
+
+int main( int argc, char* argv[] )
+{
+  const char* filename = argc>1 ? argv[1] : "samplewav.wav";
+  int failures = 0;
+
+  WavFileReader reader;
+  if ( !reader.open( filename ) ) return 1;
+  std::vector<double> samples( reader.framesLeft() );
+  samples.resize( reader.read( &samples[0], samples.size() ) );
+  for ( double& s : samples ) s *= 0.5;
+  failures += compare( filename, samples, 1000.0/reader.sampleRate(), 2E-9, 1E-14 );
+
+  // Long enough for the libm phase to grow past 1E6 radians. The libm loop
+  // then loses precision in free_phase, which gains up to half an ulp per
+  // sample; the wrapped NCO loop does not. That bounds the phase difference.
+  const size_t N = 10000000;
+  std::vector<double> carrier( N );
+  for ( size_t j=0; j<N; ++j ) carrier[j] = 0.25*sin( 2*M_PI*(j*(1000.5/22050)) + 0.3 );
+  double top = 2*M_PI*(1000.0/22050)*N;
+  double drift = 0.5*N*(nextafter( top, 2*top ) - top);
+  failures += compare( "carrier", carrier, 1000.0/22050, 1E-6 + drift, 1E-9 );
+
+  failures += compare_bank( samples, 1000.0/reader.sampleRate(), 37, 100000 );
+
+  return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#include "EventLog.h"
+#include "Timing.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** Logs from several threads at once, through enough records to fill
+the ring many times over, then reads the file back: every record must
+be there once, in order per thread. Times log() with the log closed
+and open */
+
+int main()
+{
+  int failures = 0;
+  EventLog& log( EventLog::instance() );
+  const unsigned THREADS = 4;
+  const int64_t PER_THREAD = 1000000;
+
+  // Closed: every record is dropped
+  double t0 = now();
+  for ( int64_t k=0; k<PER_THREAD; ++k ) log.log( EVENT_INTEGRATOR, k, 0, k );
+  double closed_ns = 1E9*(now() - t0)/PER_THREAD;
+
+  const char* tmpdir = getenv( "TMPDIR" );
+  std::string filename = std::string( tmpdir ? tmpdir : "/tmp" ) + "/testEventLog.evt";
+  if ( !log.open( filename ) ) return 1;
+  t0 = now();
+  std::vector<std::thread> producers;
+  for ( unsigned t=0; t<THREADS; ++t ) {
+    producers.push_back( std::thread( [t, &log]() {
+      for ( int64_t k=0; k<PER_THREAD; ++k ) log.log( EVENT_INTEGRATOR, k, t, k, -k );
+    } ) );
+  }
+  for ( std::thread& p: producers ) p.join();
+  double open_ns = 1E9*(now() - t0)/(THREADS*PER_THREAD);
+  uint64_t waits = log.waits();
+  if ( !log.close() ) failures++;
+
+  FILE* in = fopen( filename.c_str(), "rb" );
+  if ( !in ) return 1;
+  EventLogHeader h;
+  bool ok = fread( &h, sizeof(h), 1, in )==1 && h.record_size==sizeof(Event) && h.ticks_per_ns>0;
+  std::vector<int64_t> next( THREADS, 0 );
+  uint64_t count = 0, bad = 0;
+  Event e;
+  while ( fread( &e, sizeof(e), 1, in )==1 ) {
+    count++;
+    unsigned t = e.aux;
+    if ( (e.type!=EVENT_INTEGRATOR) || (t>=THREADS) || (e.id!=next[t]) || (e.v[0]!=e.id) || (e.v[1]!=-e.id) ) bad++;
+    else next[t]++;
+  }
+  fclose( in );
+  remove( filename.c_str() );
+  ok = ok && (count==THREADS*PER_THREAD) && (bad==0) && (waits<=count);
+  printf( "%u threads: %lu of %lu records read back, %lu out of order or damaged  %s\n", THREADS, count,
+          THREADS*PER_THREAD, bad, ok ? "OK" : "MISMATCH" );
+  printf( "log() %.2f ns closed, %.1f ns open, %lu waits for a full ring\n", closed_ns, open_ns, waits );
+  if ( !ok ) failures++;
+
+  return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+#include "FFT.h"
+#include "Timing.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/** Checks the real FFT against a direct long double DFT for every size up
+to 4096, checks the Spectrogram scaling and frame count on a sine and with a
+hop of 0, and reports the speed of a 1024 point transform */
+
+static int checkSize( unsigned n )
+{
+  std::vector<double> x( n ), re( n/2+1 ), im( n/2+1 );
+  for ( unsigned j=0; j<n; ++j ) x[j] = double(rand())/RAND_MAX - 0.5;
+  FFT fft( n );
+  fft.real( &x[0], &re[0], &im[0] );
+  double err = 0;
+  for ( unsigned k=0; k<=n/2; ++k ) {
+    long double sr = 0, si = 0;
+    for ( unsigned m=0; m<n; ++m ) {
+      long double a = -2*M_PI*(long double)((uint64_t(k)*m) % n)/n;
+      sr += x[m]*cosl( a );
+      si += x[m]*sinl( a );
+    }
+    err = fmax( err, fabs( re[k]-(double)sr ) );
+    err = fmax( err, fabs( im[k]-(double)si ) );
+  }
+  // Error of a radix-2 FFT grows with log2(n) times the input scale
+  bool ok = err < 1E-13*sqrt( double(n) )*log2( double(n)+1 );
+  printf( "FFT %5u: max error %g  %s\n", n, err, ok ? "OK" : "MISMATCH" );
+  return ok ? 0 : 1;
+}
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+  for ( unsigned n=2; n<=4096; n*=2 ) failures += checkSize( n );
+
+  // Full scale sine on a bin reads 0 dB there; 10000 samples make
+  // (10000-256)/128+1 frames of 256 with a hop of 128
+  {
+    Spectrogram spec( 256, 128 );
+    std::vector<double> x( 10000 );
+    for ( size_t j=0; j<x.size(); ++j ) x[j] = sin( 2*M_PI*(32.0/256)*j );
+    uint64_t frames = 0;
+    double level = 0;
+    unsigned peak = 0;
+    for ( size_t j=0; j<x.size(); j+=777 ) {
+      size_t n = x.size()-j < 777 ? x.size()-j : 777;
+      spec.add( &x[j], n, [&]( uint64_t, const std::vector<double>& db ) {
+        frames++;
+        peak = 0;
+        for ( unsigned k=0; k<db.size(); ++k ) if ( db[k] > db[peak] ) peak = k;
+        level = db[peak];
+      } );
+    }
+    bool ok = (frames==(10000-256)/128+1) && (peak==32) && (fabs( level ) < 1E-9);
+    printf( "Spectrogram: %lu frames, peak at bin %u, %g dB  %s\n", frames, peak, level, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  // A hop of 0 is taken as 1: a frame per sample once the first is full
+  {
+    Spectrogram spec( 64, 0 );
+    std::vector<double> x( 1000, 0.25 );
+    uint64_t frames = 0;
+    spec.add( &x[0], x.size(), [&]( uint64_t, const std::vector<double>& ) { frames++; } );
+    bool ok = (spec.hop()==1) && (frames==1000-64+1);
+    printf( "Spectrogram hop 0: hop %u, %lu frames  %s\n", spec.hop(), frames, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  {
+    const unsigned N = 1024;
+    const unsigned REPEAT = 20000;
+    FFT fft( N );
+    std::vector<double> x( N ), re( N/2+1 ), im( N/2+1 );
+    for ( unsigned j=0; j<N; ++j ) x[j] = double(rand())/RAND_MAX - 0.5;
+    double t0 = now();
+    for ( unsigned r=0; r<REPEAT; ++r ) {
+      x[r%N] += re[1]*1E-20;
+      fft.real( &x[0], &re[0], &im[0] );
+    }
+    double t1 = now();
+    printf( "FFT %u: %.2f us per transform, %.1f Msamples/s\n", N, 1E6*(t1-t0)/REPEAT, 1E-6*N*REPEAT/(t1-t0) );
+  }
+
+  return failures==0 ? 0 : 1;
+}
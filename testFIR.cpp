@@ -0,0 +1,100 @@
+#include "FIRFilter.h"
+#include "BandPassFilters.h"
+#include "Timing.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/** Checks FIRFilter sample by sample and in odd sized blocks against a
+direct long double convolution, checks the band pass design, and
+compares the speed of both paths with the IIR BandPassFilter */
+
+static int checkTaps( unsigned ntaps, const std::vector<double>& x )
+{
+  FIRFilter one( 0.1, 0.025, ntaps ), blk( one.taps() );
+  const std::vector<double>& h( one.taps() );
+  std::vector<double> y( x.size() );
+  for ( size_t m=0; m<x.size(); ) {
+    size_t n = 1 + rand()%(3*ntaps);
+    if ( n > x.size()-m ) n = x.size()-m;
+    // In place, as BandPassFilter::process() allows
+    for ( size_t j=0; j<n; ++j ) y[m+j] = x[m+j];
+    blk.process( &y[m], &y[m], n );
+    m += n;
+  }
+  double err = 0;
+  for ( size_t m=0; m<x.size(); ++m ) {
+    long double s = 0;
+    for ( size_t k=0; k<h.size() && k<=m; ++k ) s += (long double)h[k]*x[m-k];
+    err = fmax( err, fabs( one.add( x[m] ) - (double)s ) );
+    err = fmax( err, fabs( y[m] - (double)s ) );
+  }
+  bool ok = err < 1E-12;
+  printf( "FIR %4u taps: max error %g  %s\n", ntaps, err, ok ? "OK" : "MISMATCH" );
+  return ok ? 0 : 1;
+}
+
+// Gain of the taps at normalized frequency f
+static double gain( const std::vector<double>& h, double f )
+{
+  double re = 0, im = 0;
+  for ( size_t m=0; m<h.size(); ++m ) {
+    re += h[m]*cos( 2*M_PI*f*m );
+    im -= h[m]*sin( 2*M_PI*f*m );
+  }
+  return sqrt( re*re + im*im );
+}
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+  std::vector<double> x( 20000 );
+  for ( size_t m=0; m<x.size(); ++m ) x[m] = double(rand())/RAND_MAX - 0.5;
+  unsigned sizes[] = { 1, 2, 7, 64, 255, 1023 };
+  for ( unsigned j=0; j<sizeof(sizes)/sizeof(sizes[0]); ++j ) failures += checkTaps( sizes[j], x );
+
+  // The carrier channel of testWaveDecoder: 100 Hz, 25 Hz wide at 1 kHz,
+  // against its neighbours 50 Hz away
+  {
+    FIRFilter fir( 0.1, 0.025, 255 );
+    double pass = gain( fir.taps(), 0.1 );
+    double stop = fmax( gain( fir.taps(), 0.05 ), gain( fir.taps(), 0.15 ) );
+    bool ok = (fabs( pass-1 ) < 1E-9) && (stop < 1E-3);
+    printf( "Design: gain %.6f at fc, %.1f dB at fc +/- 50 Hz  %s\n", pass, 20*log10( stop ), ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  {
+    const size_t LEN = 1000000;
+    std::vector<double> in( LEN ), out( LEN );
+    for ( size_t m=0; m<LEN; ++m ) in[m] = double(rand())/RAND_MAX - 0.5;
+    BandPassFilter iir( 0.1, 0.025, 4 );
+    double t0 = now();
+    iir.process( &in[0], &out[0], LEN );
+    double t1 = now();
+    double sink = out[LEN-1];
+    printf( "IIR order 4: %.1f Msamples/s\n", 1E-6*LEN/(t1-t0) );
+    unsigned taps[] = { 63, 255, 1023 };
+    for ( unsigned j=0; j<sizeof(taps)/sizeof(taps[0]); ++j ) {
+      FIRFilter a( 0.1, 0.025, taps[j] ), b( a.taps() );
+      size_t n = LEN/10;
+      double t2 = now();
+      for ( size_t m=0; m<n; ++m ) out[m] = a.add( in[m] );
+      double t3 = now();
+      sink += out[n-1];
+      for ( size_t m=0; m<LEN; m+=4096 ) b.process( &in[m], &out[m], LEN-m < 4096 ? LEN-m : 4096 );
+      double t4 = now();
+      sink += out[LEN-1];
+      printf( "FIR %4u taps: direct %6.1f Msamples/s  overlap-save %6.1f (%.1fx, FFT %u)\n",
+              taps[j], 1E-6*n/(t3-t2), 1E-6*LEN/(t4-t3), (t3-t2)/n/((t4-t3)/LEN), FIRFilter::fftSize( taps[j] ) );
+    }
+    // Keep the work from being optimized away
+    if ( sink!=sink ) failures++;
+  }
+
+  return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#include "FixedPoint.h"
+#include "SoundEncoder.h"
+#include "Timing.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/** Checks the fixed point decimator against PolyphaseResampler, runs a
+recording from SoundEncoder through FixedBasebandDecoder and the double
+BasebandSoundDecoder, reports how far apart they are once locked, and
+compares their speed with each other and with the passband SoundDecoder */
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+
+  // Decimator: within rounding of the double filter, full scale included
+  {
+    const size_t LEN = 100000;
+    SampleArray x( LEN );
+    std::vector<double> xd( LEN );
+    for ( size_t m=0; m<LEN; ++m ) {
+      x[m] = m < LEN/2 ? int16_t( rand() % 65536 - 32768 ) : ((m/4)%2 ? 32767 : -32768);
+      xd[m] = x[m]/32768.0;
+    }
+    FixedDecimator fix( 8 );
+    PolyphaseResampler ref( 8, 1, 10, 1.0 );
+    std::vector<int16_t> y( fix.outputs( LEN ) );
+    std::vector<double> yd( ref.outputs( LEN ) );
+    size_t n = 0, nd = ref.process( &xd[0], LEN, &yd[0] );
+    for ( size_t m=0; m<LEN; m+=777 ) n += fix.process( &x[m], LEN-m < 777 ? LEN-m : 777, &y[n] );
+    double err = 0;
+    for ( size_t k=0; k<n && k<nd; ++k ) {
+      double ref_q15 = fmax( -32768, fmin( 32767, yd[k]*32768 ) );
+      err = fmax( err, fabs( y[k] - ref_q15 ) );
+    }
+    bool ok = (n==nd) && (err <= 8);
+    printf( "Decimator: %lu outputs, max error %.2f LSB  %s\n", n, err, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  // The same recording through both decoders
+  ByteArray payload( 25 );
+  for ( size_t j=0; j<payload.size(); ++j ) payload[j] = rand();
+  SoundEncoder enc( payload );
+  SampleArray wav( enc.size() );
+  wav.resize( enc.generate( &wav[0], wav.size() ) );
+  std::vector<double> wavd( wav.size() );
+
+  BasebandSoundDecoder dbl( SoundEncoder::SAMPLE_HZ, NULL );
+  FixedBasebandDecoder fix( SoundEncoder::SAMPLE_HZ, NULL );
+  // Touch the cycle arrays first so page faults stay out of the timing
+  size_t cycles = wav.size()/(SoundEncoder::SAMPLE_HZ/SoundEncoder::CARRIER_HZ) + 1;
+  dbl.cycles.resize( cycles );
+  dbl.cycles.clear();
+  fix.cycles.resize( cycles );
+  fix.cycles.clear();
+  const size_t BLOCK = 4096;
+  SoundDecoder pb( SoundEncoder::SAMPLE_HZ, NULL );
+  pb.cycles.resize( cycles );
+  pb.cycles.clear();
+  double tp = now();
+  for ( size_t m=0; m<wav.size(); m+=BLOCK ) {
+    size_t n = wav.size()-m < BLOCK ? wav.size()-m : BLOCK;
+    for ( size_t j=0; j<n; ++j ) wavd[m+j] = wav[m+j]*(1.0/32768);
+    pb.add( &wavd[m], n );
+  }
+  double t0 = now();
+  for ( size_t m=0; m<wav.size(); m+=BLOCK ) {
+    size_t n = wav.size()-m < BLOCK ? wav.size()-m : BLOCK;
+    for ( size_t j=0; j<n; ++j ) wavd[m+j] = wav[m+j]*(1.0/32768);
+    dbl.add( &wavd[m], n );
+  }
+  double t1 = now();
+  for ( size_t m=0; m<wav.size(); m+=BLOCK ) {
+    fix.add( &wav[m], wav.size()-m < BLOCK ? wav.size()-m : BLOCK );
+  }
+  double t2 = now();
+
+  {
+    // Skip the pull-in, then compare cycle by cycle
+    size_t n = dbl.cycles.size() < fix.cycles.size() ? dbl.cycles.size() : fix.cycles.size();
+    double max_phase = 0, sum2 = 0, max_freq = 0, max_lock = 0;
+    size_t count = 0;
+    for ( size_t c=1000; c<n; ++c ) {
+      const DecodedCycle& a( dbl.cycles[c] );
+      const DecodedCycle& b( fix.cycles[c] );
+      double d = fabs( remainder( a.phase - b.phase, 360 ) );
+      max_phase = fmax( max_phase, d );
+      sum2 += d*d;
+      max_freq = fmax( max_freq, fabs( a.freq - b.freq ) );
+      max_lock = fmax( max_lock, fabs( a.lock - b.lock ) );
+      count++;
+    }
+    double rms = count ? sqrt( sum2/count ) : 0;
+    bool ok = (dbl.cycles.size()==fix.cycles.size()) && (count>0) && (max_phase < 0.5) && (max_freq < 0.05);
+    printf( "Decoders: %lu cycles, phase rms %.4f max %.4f deg, freq max %.5f Hz, lock max %.5f apart  %s\n",
+            n, rms, max_phase, max_freq, max_lock, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  printf( "%lu samples: passband %.1f Msamples/s, double baseband %.1f, fixed %.1f (%.1fx and %.1fx)\n", wav.size(),
+          1E-6*wav.size()/(t0-tp), 1E-6*wav.size()/(t1-t0), 1E-6*wav.size()/(t2-t1), (t0-tp)/(t2-t1), (t1-t0)/(t2-t1) );
+
+  return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+#include "FusedPipe.h"
+#include "BandPassFilters.h"
+#include "CordicQueueIntegrator.h"
+#include "Timing.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/** Runs band pass, decimator, Costas loop and cycle slicer fused by
+pipe() and checks every cycle against the same stages chained by hand
+one sample at a time, through process() and add(). Also feeds a
+CordicQueueIntegrator sink. Times the fused pipe against the hand
+written loop and against block stages with a vector between each */
+
+static const double HZ = 16000;
+static const uint32_t DECIM = 2;
+
+static bool same( const std::vector<DecodedCycle>& a, const std::vector<DecodedCycle>& b )
+{
+  if ( a.size()!=b.size() ) return false;
+  for ( size_t c=0; c<a.size(); ++c ) {
+    if ( (a[c].cycle!=b[c].cycle) || (a[c].freq!=b[c].freq) || (a[c].phase!=b[c].phase) ||
+         (a[c].error!=b[c].error) || (a[c].lock!=b[c].lock) ) return false;
+  }
+  return true;
+}
+
+// The stages chained by hand
+static void byHand( const std::vector<double>& x, std::vector<DecodedCycle>& cycles )
+{
+  BandPassFilter bp( 1000/HZ, 400/HZ, 4 );
+  CostasLoop loop( 1000*DECIM/HZ );
+  uint32_t count = 0, counter = 0, cycle = 0;
+  uint32_t carrier_samples = HZ/DECIM/SoundDecoder::CARRIER_HZ;
+  double sum = 0;
+  for ( size_t m=0; m<x.size(); ++m ) {
+    sum += bp.add( x[m] );
+    if ( ++count < DECIM ) continue;
+    loop.add( sum/DECIM );
+    count = 0;
+    sum = 0;
+    if ( ++counter >= carrier_samples ) {
+      counter -= carrier_samples;
+      DecodedCycle c;
+      c.cycle = cycle++;
+      c.freq = loop.freq*HZ/DECIM;
+      c.phase = loop.phase*180/M_PI;
+      c.error = loop.error;
+      c.lock = loop.lock;
+      cycles.push_back( c );
+    }
+  }
+}
+
+// Block stages with a whole vector between each
+static void byBlocks( const std::vector<double>& x, std::vector<DecodedCycle>& cycles )
+{
+  BandPassFilter bp( 1000/HZ, 400/HZ, 4 );
+  CostasLoop loop( 1000*DECIM/HZ );
+  CycleSlicer slicer( loop, HZ/DECIM );
+  std::vector<double> filtered( x.size() ), decimated( x.size()/DECIM ), inphase( x.size()/DECIM );
+  bp.process( &x[0], &filtered[0], x.size() );
+  for ( size_t m=0; m<decimated.size(); ++m ) {
+    double sum = 0;
+    for ( uint32_t k=0; k<DECIM; ++k ) sum += filtered[m*DECIM+k];
+    decimated[m] = sum/DECIM;
+  }
+  auto collect = [&cycles]( const DecodedCycle& c ) { cycles.push_back( c ); };
+  for ( size_t m=0; m<decimated.size(); ++m ) {
+    inphase[m] = loop.add( decimated[m] );
+    slicer.push( inphase[m], collect );
+  }
+}
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+  const size_t LEN = 2000000;
+  std::vector<double> x( LEN );
+  for ( size_t m=0; m<LEN; ++m ) {
+    x[m] = 0.5*sin( 2*M_PI*1000/HZ*m + M_PI*((m/3200)%2) ) + 0.2*(double( rand() )/RAND_MAX - 0.5);
+  }
+
+  std::vector<DecodedCycle> reference, blocks, fused, single;
+  double t0 = now();
+  byHand( x, reference );
+  double hand_s = now() - t0;
+  t0 = now();
+  byBlocks( x, blocks );
+  double blocks_s = now() - t0;
+
+  BandPassFilter bp( 1000/HZ, 400/HZ, 4 );
+  CostasLoop loop( 1000*DECIM/HZ );
+  auto p = pipe( bp, Decimator( DECIM ), loop, CycleSlicer( loop, HZ/DECIM ),
+                 [&fused]( const DecodedCycle& c ) { fused.push_back( c ); } );
+  t0 = now();
+  p.process( &x[0], x.size() );
+  double fused_s = now() - t0;
+
+  // Odd sized calls, and add() on its own
+  BandPassFilter bp2( 1000/HZ, 400/HZ, 4 );
+  CostasLoop loop2( 1000*DECIM/HZ );
+  auto q = pipe( bp2, Decimator( DECIM ), loop2, CycleSlicer( loop2, HZ/DECIM ),
+                 [&single]( const DecodedCycle& c ) { single.push_back( c ); } );
+  for ( size_t m=0; m<LEN; ) {
+    size_t n = rand() % 1000;
+    if ( n > LEN-m ) n = LEN-m;
+    if ( n==0 ) q.add( x[m++] );
+    else q.process( &x[m], n );
+    m += n;
+  }
+
+  bool ok = same( reference, fused ) && same( reference, single ) && same( reference, blocks );
+  printf( "%lu cycles by hand, %lu fused, %lu fused in odd calls, %lu by blocks  %s\n", reference.size(), fused.size(),
+          single.size(), blocks.size(), ok ? "OK" : "MISMATCH" );
+  if ( !ok ) failures++;
+  ok = (p.stage<2>().freq==loop.freq) && (&p.stage<0>()==&bp);
+  printf( "Stages held by reference  %s\n", ok ? "OK" : "MISMATCH" );
+  if ( !ok ) failures++;
+
+  // A sink at the end
+  BandPassFilter bp3( 1000/HZ, 400/HZ, 4 );
+  CordicQueueIntegrator it( 800, 1000/HZ ), it_ref( 800, 1000/HZ );
+  BandPassFilter bp4( 1000/HZ, 400/HZ, 4 );
+  pipe( bp3, it ).process( &x[0], x.size() );
+  for ( size_t m=0; m<LEN; ++m ) it_ref.add( bp4.add( x[m] ) );
+  // Exact but for the rounding the integrator's own inlining may change
+  ok = (fabs( it.level() - it_ref.level() ) < 1E-12) && (fabs( it.phase() - it_ref.phase() ) < 1E-12);
+  printf( "Integrator level %f phase %f, by hand %f %f  %s\n", it.level(), it.phase(), it_ref.level(),
+          it_ref.phase(), ok ? "OK" : "MISMATCH" );
+  if ( !ok ) failures++;
+
+  printf( "ns/sample: fused %.2f, by hand %.2f, block stages with vectors %.2f\n", 1E9*fused_s/LEN, 1E9*hand_s/LEN,
+          1E9*blocks_s/LEN );
+  return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include "DCT.h"
+#include "Goertzel.h"
+#include "Timing.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/** Checks GoertzelArray in whole-block and sliding mode against sums
+computed directly in long double, then compares its speed with DCTArray
+for the 50 bins used by testWaveGen */
+
+// mag and phase of x[first..first+n) at frequency f, phase at x[first]
+static void reference( const std::vector<double>& x, size_t first, size_t n, double f,
+                       double& mag, double& phase )
+{
+  long double s = 0, c = 0;
+  for ( size_t m=0; m<n; ++m ) {
+    long double a = 2*M_PI*(long double)f*m;
+    s += x[first+m]*sinl( a );
+    c += x[first+m]*cosl( a );
+  }
+  mag = sqrtl( (s*s + c*c)/n );
+  phase = atan2l( s, c );
+}
+
+static bool close( double mag, double phase, double ref_mag, double ref_phase, double scale, double& err )
+{
+  double e = fabs( mag - ref_mag );
+  // The phase is only meaningful where there is some magnitude
+  if ( ref_mag > 1E-6*scale ) {
+    double d = fabs( remainder( phase - ref_phase, 2*M_PI ) );
+    e = fmax( e, d*ref_mag );
+  }
+  e /= scale;
+  err = fmax( err, e );
+  return e < 1E-9;
+}
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+  const unsigned N = 50;
+  std::vector<double> freqs( N );
+  for ( unsigned j=0; j<N; ++j ) freqs[j] = (0.5*j)/N + 0.0013*(j%3);
+
+  const size_t LEN = 40000;
+  std::vector<double> x( LEN );
+  for ( size_t m=0; m<LEN; ++m ) {
+    x[m] = cos( 2*M_PI*0.1*m + 0.4 ) + 0.5*sin( 2*M_PI*0.15*m ) + (double(rand())/RAND_MAX - 0.5);
+  }
+
+  // Whole block, sample by sample and in odd sized blocks
+  {
+    GoertzelArray one( freqs ), blk( freqs );
+    for ( size_t m=0; m<LEN; ++m ) one.add( x[m] );
+    for ( size_t m=0; m<LEN; ) {
+      size_t n = 1 + rand()%3000;
+      if ( n > LEN-m ) n = LEN-m;
+      blk.add( &x[m], n );
+      m += n;
+    }
+    double err = 0;
+    bool ok = true;
+    for ( unsigned j=0; j<N; ++j ) {
+      double mag, phase;
+      reference( x, 0, LEN, freqs[j], mag, phase );
+      ok = close( one[j].mag(), one[j].phase(), mag, phase, 1.0, err ) && ok;
+      ok = close( blk[j].mag(), blk[j].phase(), mag, phase, 1.0, err ) && ok;
+    }
+    printf( "Block: %u bins x %lu samples  max error %g  %s\n", N, LEN, err, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  // Sliding window, checked while filling up and after several windows
+  {
+    const uint32_t W = 1000;
+    GoertzelArray sl( freqs, W );
+    double err = 0;
+    bool ok = true;
+    for ( size_t m=0; m<LEN; ++m ) {
+      sl.add( x[m] );
+      size_t n = m+1;
+      if ( (n==10) || (n==W) || (n%3777==0) || (n==LEN) ) {
+        size_t len = n < W ? n : W;
+        for ( unsigned j=0; j<N; ++j ) {
+          double mag, phase;
+          reference( x, n-len, len, freqs[j], mag, phase );
+          ok = close( sl[j].mag(), sl[j].phase(), mag, phase, 1.0, err ) && ok;
+        }
+      }
+    }
+    printf( "Sliding: window %u  max error %g  %s\n", W, err, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  // Speed against DCTArray
+  {
+    DCTArray dct( freqs );
+    GoertzelArray one( freqs ), blk( freqs ), sl( freqs, 1000 );
+    double t0 = now();
+    for ( size_t m=0; m<LEN; ++m ) dct.add( x[m] );
+    double t1 = now();
+    for ( size_t m=0; m<LEN; ++m ) one.add( x[m] );
+    double t2 = now();
+    blk.add( &x[0], LEN );
+    double t3 = now();
+    for ( size_t m=0; m<LEN; ++m ) sl.add( x[m] );
+    double t4 = now();
+    printf( "%u bins: DCTArray %7.3f Msamples/s  Goertzel %7.3f (%.0fx)  block %7.3f (%.0fx)  sliding %7.3f (%.0fx)\n",
+            N, 1E-6*LEN/(t1-t0), 1E-6*LEN/(t2-t1), (t1-t0)/(t2-t1), 1E-6*LEN/(t3-t2), (t1-t0)/(t3-t2),
+            1E-6*LEN/(t4-t3), (t1-t0)/(t4-t3) );
+    // Keep the work from being optimized away
+    if ( dct[0].mag() + one[0].mag() + blk[0].mag() + sl[0].mag() < 0 ) failures++;
+  }
+
+  return failures==0 ? 0 : 1;
+}
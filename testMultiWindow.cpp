@@ -0,0 +1,120 @@
+#include "CordicQueueIntegrator.h"
+#include "Timing.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/** Checks MultiWindowIntegrator against one CordicQueueIntegrator per
+window, through add() and process(), from the first sample and after a
+long run, and compares the speed and the history kept */
+
+// Tone at fc with a phase step every 1000 samples, under noise
+static void signal( std::vector<double>& x, size_t first, double fc )
+{
+  for ( size_t m=0; m<x.size(); ++m ) {
+    size_t t = first + m;
+    x[m] = 0.5*cos( 2*M_PI*fc*t + M_PI*((t/1000)%2) ) + 0.5*(double( rand() )/RAND_MAX - 0.5);
+  }
+}
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+  const double FC = 1000/8000.;
+  std::vector<uint32_t> windows;
+  windows.push_back( 800 );
+  windows.push_back( 100 );
+  windows.push_back( 16 );
+  windows.push_back( 8 );
+  windows.push_back( 400 );
+
+  std::vector<CordicQueueIntegrator> ref;
+  for ( uint32_t w: windows ) ref.push_back( CordicQueueIntegrator( w, FC ) );
+  MultiWindowIntegrator one( windows, FC ), blk( windows, FC );
+
+  const size_t LEN = 1000000, BLOCK = 4096;
+  std::vector<double> x( BLOCK );
+  double dphase = 0, dlevel = 0, dblk = 0;
+  size_t checked = 0;
+  for ( size_t m=0; m<LEN; m+=BLOCK ) {
+    signal( x, m, FC );
+    blk.process( &x[0], BLOCK );
+    for ( size_t j=0; j<BLOCK; ++j ) {
+      one.add( x[j] );
+      for ( CordicQueueIntegrator& r: ref ) r.add( x[j] );
+      // Every sample at the start, then now and then
+      if ( (m+j < 2000) || ((m+j)%97==0) ) {
+        for ( size_t w=0; w<windows.size(); ++w ) {
+          dlevel = fmax( dlevel, fabs( one.level( w ) - ref[w].level() ) );
+          // The phase only means something with some of the tone in it
+          if ( ref[w].level() > 0.1 ) {
+            dphase = fmax( dphase, fabs( remainder( one.phase( w ) - ref[w].phase(), 2*M_PI ) ) );
+          }
+          checked++;
+        }
+      }
+    }
+    for ( size_t w=0; w<windows.size(); ++w ) {
+      dblk = fmax( dblk, fabs( remainder( one.phase( w ) - blk.phase( w ), 2*M_PI ) ) );
+      dblk = fmax( dblk, fabs( one.level( w ) - blk.level( w ) ) );
+    }
+  }
+  bool ok = (dphase < 1E-4) && (dlevel < 1E-4) && (dblk < 1E-6);
+  printf( "%lu checks: max phase difference %.2e rad, level %.2e, process() against add() %.2e  %s\n", checked,
+          dphase, dlevel, dblk, ok ? "OK" : "MISMATCH" );
+  if ( !ok ) failures++;
+
+  {
+    // A long run through process(), then compared with fresh integrators
+    // given only the last window of samples
+    const size_t LONG = 24414*BLOCK;
+    MultiWindowIntegrator mw( windows, FC );
+    for ( size_t m=0; m<LONG; m+=BLOCK ) {
+      signal( x, m, FC );
+      mw.process( &x[0], BLOCK );
+    }
+
+    // The level does not depend on the phase of the tone, so the fresh
+    // integrators can start theirs anywhere. x still holds the last block.
+    double worst = 0;
+    for ( size_t w=0; w<windows.size(); ++w ) {
+      CordicQueueIntegrator fresh( windows[w], FC );
+      for ( size_t m=BLOCK-windows[w]; m<BLOCK; ++m ) fresh.add( x[m] );
+      double d = fabs( mw.level( w ) - fresh.level() );
+      worst = fmax( worst, d );
+    }
+    bool long_ok = worst < 1E-4;
+    printf( "%lu samples: level difference from a fresh integrator %.2e  %s\n", LONG, worst,
+            long_ok ? "OK" : "MISMATCH" );
+    if ( !long_ok ) failures++;
+  }
+
+  {
+    std::vector<double> y( LEN );
+    signal( y, 0, FC );
+    MultiWindowIntegrator mw( windows, FC );
+    std::vector<CordicQueueIntegrator> cq;
+    for ( uint32_t w: windows ) cq.push_back( CordicQueueIntegrator( w, FC ) );
+    double t0 = now();
+    mw.process( &y[0], LEN );
+    double t1 = now();
+    for ( size_t m=0; m<LEN; ++m ) {
+      for ( CordicQueueIntegrator& r: cq ) r.add( y[m] );
+    }
+    double t2 = now();
+    double mw_rate = 1E-6*LEN/(t1-t0), cq_rate = 1E-6*LEN/(t2-t1);
+    printf( "%lu windows: process() %.1f Msamples/s, one CordicQueueIntegrator per window %.1f Msamples/s (%.1fx)\n",
+            windows.size(), mw_rate, cq_rate, mw_rate/cq_rate );
+    size_t cq_bytes = 0;
+    for ( uint32_t w: windows ) cq_bytes += w*3*sizeof(double);
+    printf( "History: %lu bytes shared, %lu bytes in separate integrators\n", (800+1)*3*sizeof(float), cq_bytes );
+    // Keep the work from being optimized away
+    if ( mw.level( 0 ) + cq[0].level() < 0 ) failures++;
+  }
+
+  return failures==0 ? 0 : 1;
+}
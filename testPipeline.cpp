@@ -0,0 +1,121 @@
+#include "PipelinedDecoder.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/** Passes numbered blocks through a chain of small rings, with a slow
+last stage so the rings fill up, and checks every block arrives once,
+in order, and that the backpressure shows in the report. Then runs the
+decode of a noisy carrier through the stages of PipelinedDecoder, as
+WavReader -pipeline does, and checks the cycles and levels against a
+serial run */
+
+struct NumberBlock
+{
+  uint64_t seq;
+  uint64_t payload[7];
+};
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+
+  const uint64_t COUNT = 200000;
+  uint64_t bad = 0, received = 0;
+  {
+    Pipeline pipeline;
+    SpscRing<NumberBlock>& first = pipeline.ring<NumberBlock>( "first", 4 );
+    SpscRing<NumberBlock>& second = pipeline.ring<NumberBlock>( "second", 3 );
+    pipeline.stage( "source", [&first]() {
+      for ( uint64_t k=0; k<COUNT; ++k ) {
+        NumberBlock* b = first.claim();
+        b->seq = k;
+        for ( unsigned j=0; j<7; ++j ) b->payload[j] = k*j;
+        first.publish();
+      }
+      first.close();
+    } );
+    pipeline.stage( "relay", [&first,&second]() {
+      while ( NumberBlock* in = first.front() ) {
+        NumberBlock* out = second.claim();
+        *out = *in;
+        first.release();
+        second.publish();
+      }
+      second.close();
+    } );
+    pipeline.stage( "sink", [&second,&bad,&received]() {
+      volatile double work = 0;
+      while ( NumberBlock* in = second.front() ) {
+        if ( in->seq!=received || in->payload[6]!=6*received ) bad++;
+        received++;
+        for ( unsigned j=0; j<50; ++j ) work = work + sqrt( double( j ) );
+        second.release();
+      }
+    } );
+    pipeline.run();
+    pipeline.report( stdout );
+
+    const PipelineRing& r( *pipeline.rings()[1] );
+    uint64_t full = pipeline.rings()[0]->full_waits + r.full_waits;
+    bool ok = (received==COUNT) && (bad==0) && (r.capacity==4) && (r.blocks==COUNT) && (r.most<=r.capacity) &&
+              (full>0);
+    printf( "%lu of %lu blocks through, %lu out of order, ring of %lu at most %lu full, %lu waits for room  %s\n",
+            received, COUNT, bad, r.capacity, r.most, full, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  // Carrier that fades in and out, under noise
+  const size_t LEN = 400000;
+  const double HZ = 8000;
+  std::vector<double> x( LEN );
+  for ( size_t m=0; m<LEN; ++m ) {
+    double level = ((m/3200)%3==2) ? 0.1 : 0.5;
+    x[m] = level*sin( 2*M_PI*1000/HZ*m ) + 0.05*(double( rand() )/RAND_MAX - 0.5);
+  }
+  SoundDecoder serial( HZ, NULL );
+  serial.add( &x[0], LEN );
+  CycleLevelMeter serial_meter( serial.carrierSamples() );
+  serial_meter.add( &x[0], LEN );
+
+  std::vector<DecodedCycle> cycles;
+  std::vector<double> levels;
+  uint32_t locks = 0;
+  {
+    PipelinedDecoder decoder( HZ );
+    decoder.onCycle = [&cycles,&levels]( const DecodedCycle& c, double level ) {
+      cycles.push_back( c );
+      levels.push_back( level );
+    };
+    decoder.onLock = [&locks]( const LockEvent& ) { locks++; };
+    size_t m = 0;
+    Pipeline pipeline;
+    decoder.stages( pipeline, [&x,&m]( double* samples, size_t max ) {
+      size_t n = x.size()-m < max ? x.size()-m : max;
+      for ( size_t k=0; k<n; ++k ) samples[k] = x[m+k];
+      m += n;
+      return n;
+    } );
+    pipeline.run();
+    pipeline.report( stdout );
+  }
+
+  size_t mismatches = 0;
+  for ( size_t c=0; c<cycles.size() && c<serial.cycles.size(); ++c ) {
+    const DecodedCycle& a( cycles[c] );
+    const DecodedCycle& b( serial.cycles[c] );
+    if ( (a.cycle!=b.cycle) || (a.phase!=b.phase) || (a.freq!=b.freq) || (levels[c]!=serial_meter.levels[c]) ) {
+      mismatches++;
+    }
+  }
+  bool ok = (cycles.size()==serial.cycles.size()) && (levels.size()==cycles.size()) && (mismatches==0) && (locks==1);
+  printf( "%lu cycles through the pipeline, %lu serial, %lu differ, %u lock events  %s\n", cycles.size(),
+          serial.cycles.size(), mismatches, locks, ok ? "OK" : "MISMATCH" );
+  if ( !ok ) failures++;
+
+  return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+#include "WavFormat.h"
+#include "BandPassFilters.h"
+#include "CordicQueueIntegrator.h"
+#include "DCT.h"
+#include "SoundDecoder.h"
+#include "SoundEncoder.h"
+#include "Timing.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/** Runs the float and double instantiations of the DSP blocks side by
+side: checks that the float wavefront in BandPassFilterF::process()
+matches its add() bit for bit, reports how far float strays from double
+for the filters, integrators and DCT, decodes samplewav.wav and an
+encoded recording with SoundDecoderF and SoundDecoder and compares the
+cycles, and compares the speeds */
+
+// Distance between two phases in degrees
+static double distance( double a, double b )
+{
+  return fabs( remainder( a - b, 360 ) );
+}
+
+static int checkBandPass( const std::vector<double>& x, const std::vector<float>& xf )
+{
+  int failures = 0;
+  for ( int order=2; order<=16; order+=2 ) {
+    BandPassFilterF ref( 0.125, 0.02, order ), blk( 0.125, 0.02, order );
+    BandPassFilter dbl( 0.125, 0.02, order );
+    std::vector<float> y( x.size() ), z( x.size() );
+    std::vector<double> yd( x.size() );
+    for ( size_t m=0; m<x.size(); ++m ) y[m] = ref.add( xf[m] );
+    for ( size_t m=0; m<x.size(); ) {
+      size_t n = 1 + rand()%5000;
+      if ( n > x.size()-m ) n = x.size()-m;
+      blk.process( &xf[m], &z[m], n );
+      m += n;
+    }
+    dbl.process( &x[0], &yd[0], x.size() );
+    double err = 0, sum2 = 0;
+    for ( size_t m=0; m<x.size(); ++m ) {
+      err = fmax( err, fabs( y[m] - yd[m] ) );
+      sum2 += yd[m]*yd[m];
+    }
+    bool same = y==z;
+    bool ok = same && (err < 1E-3*sqrt( sum2/x.size() ));
+    printf( "BandPass order %2d: float max error %.2e, rms %.2e%s  %s\n", order, err, sqrt( sum2/x.size() ),
+            same ? "" : ", process() differs from add()", ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+  return failures;
+}
+
+static int checkBlocks( const std::vector<double>& x, const std::vector<float>& xf )
+{
+  int failures = 0;
+  {
+    BiquadLowPassFilter dbl( 1/sqrt(2.0), 0.01 );
+    BiquadLowPassFilterF flt( 1/sqrt(2.0), 0.01 );
+    double err = 0;
+    for ( size_t m=0; m<x.size(); ++m ) err = fmax( err, fabs( dbl.add( x[m] ) - flt.add( xf[m] ) ) );
+    bool ok = err < 1E-4;
+    printf( "BiquadLowPass: float max error %.2e  %s\n", err, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+  {
+    // A 1 kHz tone at 8 kHz under the noise, on a 100 cycle window
+    CordicQueueIntegrator dbl( 800, 0.125 );
+    CordicQueueIntegratorF flt( 800, 0.125 );
+    double dphase = 0, dlevel = 0;
+    for ( size_t m=0; m<x.size(); ++m ) {
+      double s = 0.3*cos( 2*M_PI*0.125*m + 1.0 ) + x[m];
+      dbl.add( s );
+      flt.add( s );
+      if ( m>=800 ) {
+        dphase = fmax( dphase, distance( dbl.phase()*180/M_PI, flt.phase()*180/M_PI ) );
+        dlevel = fmax( dlevel, fabs( dbl.level() - flt.level() ) );
+      }
+    }
+    bool ok = (dphase < 1) && (dlevel < 0.01);
+    printf( "CordicQueueIntegrator: float max phase error %.4f deg, level %.2e  %s\n", dphase, dlevel,
+            ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+  {
+    DCT dbl( 0.125 );
+    DCTF flt( 0.125 );
+    for ( size_t m=0; m<x.size(); ++m ) {
+      double s = 0.3*cos( 2*M_PI*0.125*m + 1.0 ) + x[m];
+      dbl.add( s );
+      flt.add( s );
+    }
+    double dphase = distance( dbl.phase()*180/M_PI, flt.phase()*180/M_PI );
+    double dmag = fabs( dbl.mag() - flt.mag() )/dbl.mag();
+    bool ok = (dphase < 0.1) && (dmag < 1E-3);
+    printf( "DCT: float phase error %.4f deg, relative magnitude error %.2e  %s\n", dphase, dmag,
+            ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+  return failures;
+}
+
+// Decodes the recording with both decoders and compares the cycles once
+// the loops have had skip cycles to pull in
+static int compareDecoders( const char* name, const std::vector<double>& wav, double sample_hz, size_t skip,
+                            double phase_tol, double freq_tol )
+{
+  std::vector<float> xf( wav.begin(), wav.end() );
+  SoundDecoder dbl( sample_hz, NULL );
+  SoundDecoderF flt( sample_hz, NULL );
+  size_t cycles = wav.size()/dbl.carrierSamples() + 1;
+  dbl.cycles.reserve( cycles );
+  flt.cycles.reserve( cycles );
+  double t0 = now();
+  dbl.add( &wav[0], wav.size() );
+  double t1 = now();
+  flt.add( &xf[0], xf.size() );
+  double t2 = now();
+
+  size_t n = dbl.cycles.size() < flt.cycles.size() ? dbl.cycles.size() : flt.cycles.size();
+  double max_phase = 0, sum2 = 0, max_freq = 0;
+  size_t count = 0;
+  for ( size_t c=skip; c<n; ++c ) {
+    double d = distance( dbl.cycles[c].phase, flt.cycles[c].phase );
+    max_phase = fmax( max_phase, d );
+    sum2 += d*d;
+    max_freq = fmax( max_freq, fabs( dbl.cycles[c].freq - flt.cycles[c].freq ) );
+    count++;
+  }
+  double rms = count ? sqrt( sum2/count ) : 0;
+  bool ok = (dbl.cycles.size()==flt.cycles.size()) && (count>0) && (max_phase < phase_tol) && (max_freq < freq_tol);
+  printf( "%s: %lu cycles, float phase rms %.6f max %.6f deg, freq max %.2e Hz  %s\n", name, n, rms, max_phase,
+          max_freq, ok ? "OK" : "MISMATCH" );
+  printf( "%s: double %.1f Msamples/s, float %.1f Msamples/s\n", name, 1E-6*wav.size()/(t1-t0),
+          1E-6*wav.size()/(t2-t1) );
+  return ok ? 0 : 1;
+}
+
+int main( int argc, char* argv[] )
+{
+  srand( 42 );
+  int failures = 0;
+
+  const size_t LEN = 1000000;
+  std::vector<double> x( LEN );
+  std::vector<float> xf( LEN );
+  for ( size_t m=0; m<LEN; ++m ) {
+    xf[m] = float( rand() )/RAND_MAX - 0.5f;
+    x[m] = xf[m];
+  }
+  failures += checkBandPass( x, xf );
+  failures += checkBlocks( x, xf );
+
+  {
+    BandPassFilter dbl( 0.125, 0.02, 16 );
+    BandPassFilterF flt( 0.125, 0.02, 16 );
+    std::vector<double> y( LEN );
+    std::vector<float> yf( LEN );
+    double t0 = now();
+    dbl.process( &x[0], &y[0], LEN );
+    double t1 = now();
+    flt.process( &xf[0], &yf[0], LEN );
+    double t2 = now();
+    printf( "BandPass order 16 process(): double %.1f Msamples/s, float %.1f Msamples/s (%.1fx)\n",
+            1E-6*LEN/(t1-t0), 1E-6*LEN/(t2-t1), (t1-t0)/(t2-t1) );
+    // Keep the work from being optimized away
+    if ( y[LEN-1] + yf[LEN-1] != y[LEN-1] + yf[LEN-1] ) failures++;
+  }
+
+  const char* filename = argc>1 ? argv[1] : "samplewav.wav";
+  WavFileReader reader;
+  if ( !reader.open( filename ) ) return 1;
+  std::vector<double> samples( reader.framesLeft() );
+  samples.resize( reader.read( &samples[0], samples.size() ) );
+  failures += compareDecoders( filename, samples, reader.sampleRate(), 0, 1E-3, 1E-5 );
+
+  ByteArray payload( 25 );
+  for ( size_t j=0; j<payload.size(); ++j ) payload[j] = rand();
+  SoundEncoder enc( payload );
+  SampleArray wav( enc.size() );
+  wav.resize( enc.generate( &wav[0], wav.size() ) );
+  std::vector<double> scaled( wav.size() );
+  for ( size_t m=0; m<wav.size(); ++m ) scaled[m] = wav[m]*(1.0/32768);
+  failures += compareDecoders( "SoundEncoder", scaled, SoundEncoder::SAMPLE_HZ, 1000, 1E-3, 1E-5 );
+
+  return failures==0 ? 0 : 1;
+}
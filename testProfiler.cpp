@@ -0,0 +1,101 @@
+// Every probe compiled in, whatever the build
+#undef WAVDECODER_PROFILE
+#define WAVDECODER_PROFILE 2
+
+#include "BandPassFilters.h"
+#include "CordicQueueIntegrator.h"
+#include "SoundDecoder.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+/** Runs the probed blocks with every probe compiled in and checks the
+counts the profiler keeps: exact for the block probes, to within one
+sampling period for the sampled ones, with ticks in every stage. The
+report follows on stderr at exit */
+
+static int check( const char* name, uint64_t samples, uint64_t tol )
+{
+  ProfileStage& s( Profiler::instance().stage( name, false ) );
+  uint64_t scale = s.sampled ? Profiler::SAMPLING : 1;
+  uint64_t counted = s.samples.load()*scale;
+  uint64_t diff = counted > samples ? counted - samples : samples - counted;
+  bool ok = (diff <= tol) && (s.ticks.load() > 0);
+  printf( "%-26s %9lu samples counted of %9lu, %6.2f ticks/sample  %s\n", name, counted, samples,
+          s.samples.load() ? double( s.ticks.load() )/s.samples.load() : 0.0, ok ? "OK" : "MISMATCH" );
+  return ok ? 0 : 1;
+}
+
+// Median ticks per sample of the timed calls, taken as spread evenly
+// over the log2 bin it falls in. Unlike the mean it ignores the few
+// calls a preemption or an interrupt lands in
+static double median( const ProfileStage& s )
+{
+  uint64_t half = s.timed.load()/2, below = 0;
+  for ( unsigned b=0; b<ProfileStage::BINS; ++b ) {
+    uint64_t n = s.hist[b].load();
+    if ( below + n > half ) {
+      double lo = b>0 ? double( 1ULL<<b ) : 0, width = b>0 ? lo : 2;
+      return lo + width*(half - below)/n;
+    }
+    below += n;
+  }
+  return 0;
+}
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+  const size_t LEN = 1000000, BLOCK = 4096;
+  std::vector<double> x( LEN ), y( LEN );
+  for ( size_t m=0; m<LEN; ++m ) x[m] = 0.5*sin( 2*M_PI*0.125*m ) + 0.1*(double( rand() )/RAND_MAX - 0.5);
+
+  BandPassFilter bp( 0.125, 0.02, 8 );
+  for ( size_t m=0; m<LEN; m+=BLOCK ) bp.process( &x[m], &y[m], LEN-m < BLOCK ? LEN-m : BLOCK );
+  for ( size_t m=0; m<LEN; ++m ) y[m] = bp.add( x[m] );
+
+  CordicQueueIntegrator it( 800, 0.125 );
+  it.process( &x[0], LEN );
+  for ( size_t m=0; m<LEN; ++m ) it.add( x[m] );
+
+  // Block by block, each call timed here as well
+  SoundDecoder dec( 8000, NULL );
+  dec.cycles.reserve( LEN/8 );
+  std::vector<double> per;
+  for ( size_t m=0; m<LEN; m+=BLOCK ) {
+    size_t n = LEN-m < BLOCK ? LEN-m : BLOCK;
+    uint64_t t0 = Profiler::ticks();
+    dec.add( &x[m], n );
+    per.push_back( double( Profiler::ticks() - t0 )/n );
+  }
+
+  const uint64_t S = Profiler::SAMPLING;
+  failures += check( "BandPassFilter.process", LEN, 0 );
+  failures += check( "BandPassFilter.add", LEN, S );
+  failures += check( "CordicQueueIntegrator.process", LEN, 0 );
+  failures += check( "CordicQueueIntegrator.add", LEN, S );
+  failures += check( "SoundDecoder.add", LEN, 0 );
+  failures += check( "SoundDecoder.output", LEN/8, S );
+  const char* splits[] = { "CostasLoop.nco", "CostasLoop.mixer", "CostasLoop.loop", "CostasLoop.lock", "CostasLoop.freq" };
+  for ( const char* name: splits ) failures += check( name, LEN, S );
+
+  // The splits of the loop make up most of what its block takes, and not
+  // much more: each split is timed on its own, which costs it the overlap
+  // with its neighbours the block gets. Medians, since a sampled call that
+  // is preempted counts SAMPLING times over in the means.
+  double loop = 0;
+  for ( const char* name: splits ) loop += median( Profiler::instance().stage( name, true ) );
+  std::nth_element( per.begin(), per.begin() + per.size()/2, per.end() );
+  double whole = per[per.size()/2];
+  bool ok = (loop > 0.3*whole) && (loop < 1.5*whole);
+  printf( "CostasLoop splits median %.1f ticks/sample, SoundDecoder.add median %.1f  %s\n", loop, whole,
+          ok ? "OK" : "MISMATCH" );
+  if ( !ok ) failures++;
+
+  return failures==0 ? 0 : 1;
+}
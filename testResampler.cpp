@@ -0,0 +1,80 @@
+#include "Resampler.h"
+#include "Timing.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/** Resamples a sine between the rates WAV files come in and checks it
+against the same sine at the output rate, checks that the outputs do
+not depend on the block sizes, and reports the speed */
+
+static int checkRates( uint32_t in_hz, uint32_t out_hz, double f )
+{
+  const size_t LEN = 50000;
+  std::vector<double> x( LEN );
+  for ( size_t m=0; m<LEN; ++m ) x[m] = sin( 2*M_PI*f*m/in_hz );
+
+  PolyphaseResampler one( in_hz, out_hz ), blk( in_hz, out_hz );
+  std::vector<double> y, z;
+  std::vector<double> out( one.outputs( 3000 ) );
+  for ( size_t m=0; m<LEN; ++m ) {
+    size_t k = one.process( &x[m], 1, &out[0] );
+    y.insert( y.end(), out.begin(), out.begin()+k );
+  }
+  for ( size_t m=0; m<LEN; ) {
+    size_t n = 1 + rand()%3000;
+    if ( n > LEN-m ) n = LEN-m;
+    size_t k = blk.process( &x[m], n, &out[0] );
+    z.insert( z.end(), out.begin(), out.begin()+k );
+    m += n;
+  }
+
+  bool same = y==z;
+  // Output k is input time k M/L, less the filter delay; skip the
+  // start-up of the filter
+  double err = 0;
+  size_t skip = size_t( 2*blk.delay()*out_hz/in_hz ) + 1;
+  for ( size_t k=skip; k<y.size(); ++k ) {
+    double t = double(k)*blk.down()/blk.up() - blk.delay();
+    err = fmax( err, fabs( y[k] - sin( 2*M_PI*f*t/in_hz ) ) );
+  }
+  size_t expected = (uint64_t(LEN)*blk.up() - 1)/blk.down() + 1;
+  bool ok = same && (y.size()==expected) && (err < 1E-3);
+  printf( "%5u -> %5u Hz (%u/%u): %lu outputs, max error %g%s  %s\n", in_hz, out_hz, blk.up(), blk.down(),
+          y.size(), err, same ? "" : ", blocks differ", ok ? "OK" : "MISMATCH" );
+  return ok ? 0 : 1;
+}
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+  failures += checkRates( 22050, 8000, 1100 );
+  failures += checkRates( 44100, 8000, 1200 );
+  failures += checkRates( 48000, 8000, 1000 );
+  failures += checkRates( 8000, 4000, 1000 );
+  failures += checkRates( 8000, 22050, 1100 );
+
+  {
+    const size_t LEN = 4000000;
+    std::vector<double> x( LEN );
+    for ( size_t m=0; m<LEN; ++m ) x[m] = double(rand())/RAND_MAX - 0.5;
+    PolyphaseResampler rs( 44100, 8000 );
+    std::vector<double> out( rs.outputs( 4096 ) );
+    double sink = 0;
+    double t0 = now();
+    for ( size_t m=0; m<LEN; m+=4096 ) {
+      size_t k = rs.process( &x[m], LEN-m < 4096 ? LEN-m : 4096, &out[0] );
+      if ( k>0 ) sink += out[k-1];
+    }
+    double t1 = now();
+    printf( "44100 -> 8000 Hz: %.1f Msamples/s in\n", 1E-6*LEN/(t1-t0) );
+    // Keep the work from being optimized away
+    if ( sink!=sink ) failures++;
+  }
+
+  return failures==0 ? 0 : 1;
+}
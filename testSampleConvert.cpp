@@ -0,0 +1,110 @@
+#include "SampleConvert.h"
+#include "Timing.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+/** Checks every SampleConverter encoding against a plain reference
+decoder, for float and double output, with odd lengths so both the SIMD
+kernels and the scalar tails are exercised. Then reports throughput */
+
+// Full scale value of one sample, straight from the definition
+static double reference( uint16_t format, uint16_t bits, const uint8_t* p )
+{
+  switch ( format ) {
+  case WAV_FORMAT_PCM:
+    switch ( bits ) {
+    case 8:  return (p[0] - 128)/128.0;
+    case 16: return int16_t( p[0] | (p[1]<<8) )/32768.0;
+    case 24: return int32_t( (p[0]<<8) | (p[1]<<16) | (uint32_t(p[2])<<24) )/2147483648.0;
+    case 32: return int32_t( p[0] | (p[1]<<8) | (p[2]<<16) | (uint32_t(p[3])<<24) )/2147483648.0;
+    }
+    return 0;
+  case WAV_FORMAT_IEEE_FLOAT:
+    if ( bits==32 ) { float v; memcpy( &v, p, 4 ); return v; }
+    else { double v; memcpy( &v, p, 8 ); return v; }
+  case WAV_FORMAT_ALAW:  return alaw2linear( p[0] )/32768.0;
+  case WAV_FORMAT_MULAW: return mulaw2linear( p[0] )/32768.0;
+  }
+  return 0;
+}
+
+static int check( uint16_t format, uint16_t bits, uint16_t channels )
+{
+  const size_t N = 1003;
+  size_t fb = (bits/8)*channels;
+  std::vector<uint8_t> raw( N*fb );
+  for ( size_t j=0; j<raw.size(); ++j ) raw[j] = rand();
+  if ( format==WAV_FORMAT_IEEE_FLOAT ) {
+    for ( size_t j=0; j<N*channels; ++j ) {
+      if ( bits==32 ) { float v = double(rand())/RAND_MAX - 0.5; memcpy( &raw[4*j], &v, 4 ); }
+      else { double v = double(rand())/RAND_MAX - 0.5; memcpy( &raw[8*j], &v, 8 ); }
+    }
+  }
+  int failures = 0;
+  for ( uint16_t ch=0; ch<channels; ++ch ) {
+    SampleConverter conv;
+    if ( !conv.init( format, bits, channels, ch ) ) {
+      printf( "Format:%d bits:%d channels:%d  NOT SUPPORTED\n", format, bits, channels );
+      return 1;
+    }
+    std::vector<double> outd( N );
+    std::vector<float> outf( N );
+    conv.convert( &raw[0], N, &outd[0] );
+    conv.convert( &raw[0], N, &outf[0] );
+    bool ok = true;
+    for ( size_t j=0; j<N; ++j ) {
+      double ref = reference( format, bits, &raw[j*fb + ch*(bits/8)] );
+      if ( outd[j]!=ref ) ok = false;
+      if ( (format==WAV_FORMAT_IEEE_FLOAT) && (bits==64) ) {
+        if ( outf[j]!=float(ref) ) ok = false;
+      }
+      else if ( fabs( outf[j]-ref ) > 1E-7*fabs(ref) ) ok = false;
+    }
+    printf( "Format:%d bits:%2d channels:%d channel:%d  %s\n", format, bits, channels, ch, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+  return failures;
+}
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+
+  // G.711 spot values from the ITU tables
+  if ( mulaw2linear( 0xFF )!=0 || mulaw2linear( 0x00 )!=-32124 || mulaw2linear( 0x80 )!=32124 ||
+       alaw2linear( 0xD5 )!=8 || alaw2linear( 0x55 )!=-8 || alaw2linear( 0xAA )!=32256 ) {
+    printf( "G.711 tables MISMATCH\n" );
+    failures++;
+  }
+
+  for ( uint16_t ch=1; ch<=3; ++ch ) {
+    failures += check( WAV_FORMAT_PCM, 8, ch );
+    failures += check( WAV_FORMAT_PCM, 16, ch );
+    failures += check( WAV_FORMAT_PCM, 24, ch );
+    failures += check( WAV_FORMAT_PCM, 32, ch );
+    failures += check( WAV_FORMAT_IEEE_FLOAT, 32, ch );
+    failures += check( WAV_FORMAT_IEEE_FLOAT, 64, ch );
+    failures += check( WAV_FORMAT_ALAW, 8, ch );
+    failures += check( WAV_FORMAT_MULAW, 8, ch );
+  }
+
+  const size_t N = 1<<20;
+  const uint32_t REPEAT = 50;
+  std::vector<uint8_t> raw( 2*N );
+  std::vector<double> out( N );
+  for ( size_t j=0; j<raw.size(); ++j ) raw[j] = rand();
+  SampleConverter conv;
+  conv.init( WAV_FORMAT_PCM, 16, 1 );
+  double t0 = now();
+  for ( uint32_t r=0; r<REPEAT; ++r ) conv.convert( &raw[0], N, &out[0] );
+  double t1 = now();
+  printf( "PCM16 mono to double: %6.1f Msamples/s\n", 1E-6*N*REPEAT/(t1-t0) );
+
+  return failures==0 ? 0 : 1;
+}
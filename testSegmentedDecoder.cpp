@@ -0,0 +1,102 @@
+#include "SegmentedDecoder.h"
+#include "SoundEncoder.h"
+#include "WavFormat.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+/** Decodes recordings with SegmentedDecoder over several segment and
+overlap sizes and compares every stitched cycle with one SoundDecoder
+run over the whole file. One recording is WavWriter's encoding of a
+payload; the other a carrier whose phase turns by pi every so often,
+under noise, so that segments lock half a turn off and the stitch has
+to flip them back */
+
+// The serial decode
+static bool serial( const std::string& filename, std::vector<DecodedCycle>& cycles )
+{
+  WavFileReader reader;
+  if ( !reader.open( filename ) || !reader.select( 0 ) ) return false;
+  SoundDecoder decoder( reader.sampleRate(), NULL );
+  std::vector<double> block( SegmentedDecoder::BLOCK_SAMPLES );
+  size_t n;
+  while ( (n = reader.read( &block[0], block.size() ))>0 ) decoder.add( &block[0], n );
+  cycles.swap( decoder.cycles );
+  return true;
+}
+
+// Adds the segments turned by pi to flips
+static int check( const std::string& filename, const std::vector<DecodedCycle>& reference, double seconds,
+                  uint32_t overlap, uint32_t& flips )
+{
+  SegmentedDecoder decoder( filename, seconds, overlap );
+  if ( !decoder.open() ) return 1;
+  bool ok = true;
+  for ( size_t s=decoder.segments(); s-->0; ) {
+    if ( !decoder.decode( s ) ) ok = false;
+  }
+  std::vector<DecodedCycle> cycles;
+  decoder.stitch( cycles );
+
+  double dphase = 0, dfreq = 0;
+  size_t renumbered = 0;
+  for ( size_t c=0; c<cycles.size() && c<reference.size(); ++c ) {
+    if ( cycles[c].cycle!=reference[c].cycle ) renumbered++;
+    dphase = fmax( dphase, fabs( remainder( cycles[c].phase - reference[c].phase, 360.0 ) ) );
+    dfreq = fmax( dfreq, fabs( cycles[c].freq - reference[c].freq ) );
+  }
+  ok = ok && (cycles.size()==reference.size()) && (renumbered==0) && (dphase<1E-3) && (dfreq<1E-6) &&
+       (decoder.unmatched()==0);
+  flips += decoder.flips();
+  printf( "%-28s %5.1fs segments, overlap %3u: %2lu segments, %lu of %lu cycles, %u flips, %u unmatched, "
+          "max diff phase:%g freq:%g  %s\n", filename.substr( filename.rfind( '/' )+1 ).c_str(), seconds, overlap,
+          decoder.segments(), cycles.size(), reference.size(), decoder.flips(), decoder.unmatched(), dphase, dfreq,
+          ok ? "OK" : "MISMATCH" );
+  return ok ? 0 : 1;
+}
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+  const char* tmpdir = getenv( "TMPDIR" );
+  std::string dir = tmpdir ? tmpdir : "/tmp";
+
+  std::string encoded = dir + "/testSegmentedDecoder-encoded.wav";
+  ByteArray payload;
+  for ( unsigned j=0; j<40; ++j ) payload.push_back( rand() );
+  WavFileWriter writer;
+  if ( !writer.open( encoded, SoundEncoder::SAMPLE_HZ ) || !encodeSound( payload, writer ) || !writer.close() ) return 1;
+
+  std::string flipped = dir + "/testSegmentedDecoder-flipped.wav";
+  const uint32_t HZ = 8000;
+  SampleArray wav( 120*HZ );
+  for ( size_t m=0; m<wav.size(); ++m ) {
+    double turn = M_PI*((m/(7*HZ+HZ/3))%2);
+    wav[m] = 32768*(0.4*sin( 2*M_PI*1000.0/HZ*m + turn ) + 0.1*(double( rand() )/RAND_MAX - 0.5));
+  }
+  if ( !writer.open( flipped, HZ ) || !writer.write( &wav[0], wav.size() ) || !writer.close() ) return 1;
+
+  std::vector<DecodedCycle> reference;
+  if ( !serial( encoded, reference ) ) return 1;
+  const double seconds[] = { 10, 25, 60 };
+  const uint32_t overlaps[] = { 50, 200 };
+  uint32_t flips = 0;
+  for ( double s: seconds ) {
+    for ( uint32_t o: overlaps ) failures += check( encoded, reference, s, o, flips );
+  }
+
+  if ( !serial( flipped, reference ) ) return 1;
+  flips = 0;
+  for ( double s: seconds ) failures += check( flipped, reference, s, 200, flips );
+  printf( "%u segments of the flipped carrier turned back by pi  %s\n", flips, flips>0 ? "OK" : "MISMATCH" );
+  if ( flips==0 ) failures++;
+
+  remove( encoded.c_str() );
+  remove( flipped.c_str() );
+  return failures==0 ? 0 : 1;
+}
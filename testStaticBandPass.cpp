@@ -0,0 +1,139 @@
+#include "BandPassFilters.h"
+#include "Timing.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/** Checks StaticBandPassFilter against BandPassFilter for every order:
+coefficients to a few DBL_EPSILON where the design is well conditioned,
+outputs to rounding and process() against add() bit for bit. Checks
+that a filter designed by the compiler matches one designed at run
+time bit for bit, and compares sizes and speeds */
+
+// Designed by the compiler: this does not build unless the whole design
+// is a constant expression
+constexpr StaticBandPassFilter<8> PROTO8( 0.125, 0.02 );
+
+// Largest coefficient difference in units of DBL_EPSILON
+template< int Order >
+static double eps( const StaticBandPassFilter<Order>& s, const BandPassFilter& r )
+{
+  double worst = 0;
+  for ( int k=0; k<Order; ++k ) {
+    const BandPassFilter::SOSBandPass& f( r.sections()[k] );
+    const typename StaticBandPassFilter<Order>::Section& g( s.sections()[k] );
+    double c[4][2] = { { g.b0, f.b[0] }, { g.b2, f.b[2] }, { g.a1, f.a[1] }, { g.a2, f.a[2] } };
+    for ( int j=0; j<4; ++j ) worst = fmax( worst, fabs( c[j][0] - c[j][1] )/DBL_EPSILON );
+  }
+  return worst;
+}
+
+template< int Order >
+static int check( const std::vector<double>& x, double fc, double bw )
+{
+  StaticBandPassFilter<Order> s( fc, bw );
+  BandPassFilter r( fc, bw, Order );
+  double coef = eps( s, r );
+  double err = 0, sum2 = 0;
+  for ( size_t m=0; m<x.size(); ++m ) {
+    double a = s.add( x[m] ), b = r.add( x[m] );
+    err = fmax( err, fabs( a - b ) );
+    sum2 += b*b;
+  }
+  double rms = sqrt( sum2/x.size() );
+  // Orders of 12 and up have a pole pair with Q 0.50 that neither design
+  // gets to better than about 1E-9 (see StaticBandPassFilter)
+  bool ok = (coef <= (Order<12 ? 16 : 1E-8/DBL_EPSILON)) && (err <= 1E-9*rms);
+  printf( "Order %2d: coefficients within %8.0f eps, output max error %.2e of rms %.2e  %s\n", Order, coef, err, rms,
+          ok ? "OK" : "MISMATCH" );
+  return ok ? 0 : 1;
+}
+
+template< int Order >
+static void speed( const std::vector<double>& x )
+{
+  StaticBandPassFilter<Order> s( 0.125, 0.02 );
+  BandPassFilter r1( 0.125, 0.02, Order ), r2( 0.125, 0.02, Order );
+  std::vector<double> y( x.size() );
+  double t0 = now();
+  for ( size_t m=0; m<x.size(); ++m ) y[m] = r1.add( x[m] );
+  double t1 = now();
+  r2.process( &x[0], &y[0], x.size() );
+  double t2 = now();
+  for ( size_t m=0; m<x.size(); ++m ) y[m] = s.add( x[m] );
+  double t3 = now();
+  s.process( &x[0], &y[0], x.size() );
+  double t4 = now();
+  printf( "Order %2d: BandPassFilter add %.1f, process %.1f, StaticBandPassFilter add %.1f, process %.1f Msamples/s, %lu bytes\n",
+          Order, 1E-6*x.size()/(t1-t0), 1E-6*x.size()/(t2-t1), 1E-6*x.size()/(t3-t2),
+          1E-6*x.size()/(t4-t3), sizeof(StaticBandPassFilter<Order>) );
+}
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+  std::vector<double> x( 200000 );
+  for ( size_t m=0; m<x.size(); ++m ) x[m] = double( rand() )/RAND_MAX - 0.5;
+
+  failures += check< 2>( x, 0.125, 0.02 );
+  failures += check< 4>( x, 0.125, 0.02 );
+  failures += check< 6>( x, 0.05, 0.01 );
+  failures += check< 8>( x, 0.125, 0.02 );
+  failures += check<10>( x, 0.2, 0.05 );
+  failures += check<12>( x, 0.125, 0.02 );
+  failures += check<14>( x, 0.3, 0.02 );
+  failures += check<16>( x, 0.125, 0.02 );
+
+  {
+    StaticBandPassFilter<6> a( 0.1, 0.02 ), b( 0.1, 0.02 );
+    std::vector<double> y( x.size() ), z( x.size() );
+    for ( size_t m=0; m<x.size(); ++m ) y[m] = a.add( x[m] );
+    for ( size_t m=0; m<x.size(); ) {
+      size_t n = 1 + rand()%3000;
+      if ( n > x.size()-m ) n = x.size()-m;
+      b.process( &x[m], &z[m], n );
+      m += n;
+    }
+    bool same = y==z;
+    printf( "process() %s add()\n", same ? "matches" : "DIFFERS FROM" );
+    if ( !same ) failures++;
+  }
+
+  {
+    // Compile time and run time designs are the same filter
+    StaticBandPassFilter<8> a( PROTO8 );
+    double fc = 0.125 + x.size()*0;   // not a constant expression
+    StaticBandPassFilter<8> b( fc, 0.02 );
+    bool same = true;
+    for ( size_t m=0; m<x.size(); ++m ) same = same && (a.add( x[m] )==b.add( x[m] ));
+    printf( "Compile time design %s the run time one\n", same ? "matches" : "DIFFERS FROM" );
+    if ( !same ) failures++;
+  }
+
+  {
+    // Float sections, as BandPassFilterF
+    StaticBandPassFilter<4,float> s( 0.125, 0.02 );
+    BandPassFilterF r( 0.125, 0.02, 4 );
+    double err = 0;
+    for ( size_t m=0; m<x.size(); ++m ) err = fmax( err, fabs( s.add( x[m] ) - r.add( x[m] ) ) );
+    bool ok = err < 1E-5;
+    printf( "Float order 4: max difference from BandPassFilterF %.2e  %s\n", err, ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+  }
+
+  std::vector<double> big( 4000000 );
+  for ( size_t m=0; m<big.size(); ++m ) big[m] = x[m%x.size()];
+  speed<2>( big );
+  speed<4>( big );
+  speed<8>( big );
+  speed<16>( big );
+  printf( "BandPassFilter object %lu bytes plus %lu per section on the heap\n", sizeof(BandPassFilter),
+          sizeof(BandPassFilter::SOSBandPass) );
+
+  return failures==0 ? 0 : 1;
+}
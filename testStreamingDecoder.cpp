@@ -0,0 +1,92 @@
+#include "StreamingDecoder.h"
+#include "SoundEncoder.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/** Pushes an encoded payload in blocks of random size, as a live source
+would deliver it, and checks that the cycles match SoundDecoder on the
+whole recording, that lock is found once and kept, and that the symbol
+timing falls on the fade and data sections the encoder wrote */
+
+static uint32_t distance( uint64_t sample, uint64_t expected )
+{
+  return sample > expected ? sample - expected : expected - sample;
+}
+
+int main()
+{
+  srand( 42 );
+  int failures = 0;
+  ByteArray payload;
+  payload.push_back( 0x5A );
+  payload.push_back( 0xC3 );
+  SoundEncoder encoder( payload );
+  SampleArray wav( encoder.size() );
+  wav.resize( encoder.generate( &wav[0], wav.size() ) );
+
+  std::vector<double> x( wav.size() );
+  for ( size_t m=0; m<wav.size(); ++m ) x[m] = wav[m]/32768.;
+  SoundDecoder reference( SoundEncoder::SAMPLE_HZ, NULL );
+  reference.add( &x[0], x.size() );
+
+  StreamingDecoder decoder( SoundEncoder::SAMPLE_HZ );
+  std::vector<DecodedCycle> cycles;
+  std::vector<LockEvent> locks;
+  std::vector<SymbolTiming> symbols;
+  decoder.onCycle = [&cycles]( const DecodedCycle& c ) { cycles.push_back( c ); };
+  decoder.onLock = [&locks]( const LockEvent& e ) { locks.push_back( e ); };
+  decoder.onSymbol = [&symbols]( const SymbolTiming& s ) { symbols.push_back( s ); };
+
+  // Every cycle ends inside the push that completes it
+  size_t pushed = 0, late = 0;
+  while ( pushed<wav.size() ) {
+    size_t n = 1 + rand() % 3000;
+    if ( n > wav.size()-pushed ) n = wav.size()-pushed;
+    decoder.push( &wav[pushed], n );
+    pushed += n;
+    if ( cycles.size()!=pushed/8 ) late++;
+  }
+
+  size_t mismatches = 0;
+  for ( size_t c=0; c<cycles.size() && c<reference.cycles.size(); ++c ) {
+    const DecodedCycle& a( cycles[c] );
+    const DecodedCycle& b( reference.cycles[c] );
+    if ( (a.cycle!=b.cycle) || (a.freq!=b.freq) || (a.phase!=b.phase) || (a.error!=b.error) ) mismatches++;
+  }
+  bool ok = (cycles.size()==reference.cycles.size()) && (mismatches==0) && (late==0);
+  printf( "%lu cycles pushed, %lu from SoundDecoder, %lu differ, %lu reported late  %s\n", cycles.size(),
+          reference.cycles.size(), mismatches, late, ok ? "OK" : "MISMATCH" );
+  if ( !ok ) failures++;
+
+  ok = (locks.size()==1) && locks[0].locked && (locks[0].cycle < 20) && decoder.locked();
+  printf( "%lu lock events, first at cycle %u  %s\n", locks.size(), locks.empty() ? 0 : locks[0].cycle,
+          ok ? "OK" : "MISMATCH" );
+  if ( !ok ) failures++;
+
+  // One rise and one fall per bit, but no fall before the first fade
+  const uint32_t FADE = SoundEncoder::FADE_SAMPLES, DATA = SoundEncoder::DATA_SAMPLES;
+  size_t bits = 8*payload.size();
+  size_t wrong = 0;
+  uint32_t worst = 0;
+  for ( size_t k=0; k<symbols.size(); ++k ) {
+    const SymbolTiming& s( symbols[k] );
+    size_t bit = (k+1)/2;
+    uint64_t expected = bit*(FADE+DATA) + (s.data ? FADE : 0);
+    uint32_t d = distance( s.sample, expected );
+    if ( d > worst ) worst = d;
+    // The section that ended is the other kind
+    uint32_t length = (s.data ? FADE : DATA)/8;
+    if ( (s.data!=(k%2==0)) || (d > 16) ) wrong++;
+    else if ( (k>0) && (distance( s.cycles, length ) > 2) ) wrong++;
+  }
+  ok = (symbols.size()==2*bits-1) && (wrong==0);
+  printf( "%lu symbol edges for %lu bits, %lu misplaced, worst %u samples off  %s\n", symbols.size(), bits, wrong,
+          worst, ok ? "OK" : "MISMATCH" );
+  if ( !ok ) failures++;
+
+  return failures==0 ? 0 : 1;
+}
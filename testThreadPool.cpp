@@ -0,0 +1,123 @@
+#include "ThreadPool.h"
+#include "SoundDecoder.h"
+#include "SoundEncoder.h"
+#include "WavFormat.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** Runs many small tasks, some of which submit more, through the pool
+and checks each ran exactly once, on more than one worker, before
+wait() returned. Given the path to WavReader, also runs -batch over a
+directory of encoded recordings and compares each output file with the
+serial decode printed the same way */
+
+static int checkPool( unsigned threads )
+{
+  const unsigned TASKS = 2000, CHILDREN = 3;
+  std::vector< std::atomic<int> > runs( TASKS*(CHILDREN+1) );
+  std::vector< std::atomic<int> > workers( 64 );
+  for ( auto& r: runs ) r = 0;
+  for ( auto& w: workers ) w = 0;
+  bool ok = true;
+  {
+    ThreadPool pool( threads );
+    for ( unsigned round=0; round<3; ++round ) {
+      for ( unsigned t=0; t<TASKS; ++t ) {
+        pool.submit( [&pool,&runs,&workers,t]() {
+          runs[t*(CHILDREN+1)]++;
+          workers[std::hash<std::thread::id>()( std::this_thread::get_id() ) % workers.size()] = 1;
+          for ( unsigned c=1; c<=CHILDREN; ++c ) {
+            pool.submit( [&runs,t,c]() { runs[t*(CHILDREN+1)+c]++; } );
+          }
+        } );
+      }
+      pool.wait();
+      for ( auto& r: runs ) {
+        if ( r!=int(round+1) ) ok = false;
+      }
+    }
+  }
+  unsigned used = 0;
+  for ( auto& w: workers ) used += w;
+  ok = ok && (threads<2 || used>1);
+  printf( "%u workers: %u tasks and their children run once per round, on %u threads  %s\n", threads,
+          TASKS*(CHILDREN+1), used, ok ? "OK" : "MISMATCH" );
+  return ok ? 0 : 1;
+}
+
+static bool readText( const std::string& filename, std::string& text )
+{
+  ByteArray bytes;
+  if ( !readFile( filename, bytes ) ) return false;
+  text.assign( bytes.begin(), bytes.end() );
+  return true;
+}
+
+static int checkBatch( const std::string& wavreader )
+{
+  const char* tmpdir = getenv( "TMPDIR" );
+  std::string dir = std::string( tmpdir ? tmpdir : "/tmp" ) + "/testThreadPool-XXXXXX";
+  if ( !mkdtemp( &dir[0] ) ) return 1;
+  std::string indir = dir + "/in", outdir = dir + "/out";
+  if ( (mkdir( indir.c_str(), 0700 )!=0) || (mkdir( outdir.c_str(), 0700 )!=0) ) return 1;
+
+  const char* names[] = { "a", "b", "c" };
+  for ( unsigned f=0; f<3; ++f ) {
+    ByteArray payload;
+    for ( unsigned j=0; j<4*(f+1); ++j ) payload.push_back( rand() );
+    WavFileWriter writer;
+    if ( !writer.open( indir + "/" + names[f] + ".wav", SoundEncoder::SAMPLE_HZ ) ||
+         !encodeSound( payload, writer ) || !writer.close() ) return 1;
+  }
+
+  std::string cmd = wavreader + " -batch " + indir + " " + outdir + " -threads 3 -segment 5 -overlap 100";
+  int rc = system( cmd.c_str() );
+  int failures = rc==0 ? 0 : 1;
+  for ( unsigned f=0; f<3; ++f ) {
+    std::string wav = indir + "/" + names[f] + ".wav", txt = outdir + "/" + names[f] + ".txt";
+    WavFileReader reader;
+    if ( !reader.open( wav ) || !reader.select( 0 ) ) return 1;
+    std::string serial = dir + "/serial.txt";
+    FILE* out = fopen( serial.c_str(), "w" );
+    if ( !out ) return 1;
+    SoundDecoder decoder( reader.sampleRate(), out );
+    std::vector<double> block( 4096 );
+    size_t n;
+    while ( (n = reader.read( &block[0], block.size() ))>0 ) decoder.add( &block[0], n );
+    fclose( out );
+
+    std::string expected, got;
+    bool ok = readText( serial, expected ) && readText( txt, got ) && !expected.empty() && (got==expected);
+    printf( "-batch %s: %lu bytes, serial %lu  %s\n", txt.c_str(), got.size(), expected.size(),
+            ok ? "OK" : "MISMATCH" );
+    if ( !ok ) failures++;
+    remove( serial.c_str() );
+    remove( wav.c_str() );
+    remove( txt.c_str() );
+  }
+  std::string summary = outdir + "/summary.txt";
+  remove( summary.c_str() );
+  rmdir( indir.c_str() );
+  rmdir( outdir.c_str() );
+  rmdir( dir.c_str() );
+  return failures;
+}
+
+int main( int argc, char* argv[] )
+{
+  srand( 42 );
+  int failures = 0;
+  failures += checkPool( 1 );
+  failures += checkPool( 4 );
+  if ( argc>1 ) failures += checkBatch( argv[1] );
+  return failures==0 ? 0 : 1;
+}
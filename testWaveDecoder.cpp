@@ -1,11 +1,15 @@
 #include "DCT.h"
-#include "BandPassFilters.h"
+#include "BandPassFilterBank.h"
+#include "FIRFilter.h"
 #include "LowPassFilters.h"
 #include "WaveGenerator.h"
 #include "CordicQueueIntegrator.h"
+#include "EventLog.h"
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <complex>
 
 static int32_t map_constellation( double phase1, double phase2, uint32_t num_phases ) 
@@ -25,10 +29,34 @@ Steps:
 2. Use band pass filter to separate and recover each
 3. Recover phase from carrier
 4. Recover phase differential from wave 
+
+Each channel filter is the IIR band pass unless it is listed after -fir,
+as in -fir 13 for carrier and data; those use a linear phase FIR of
+-taps taps instead. The signal is generated and filtered in blocks of
+BLOCK samples so the FIR channels can run overlap-save.
+
+Lock changes, symbols, clock transitions and the data integrator
+samples go to the event log, testWaveDecoder.evt unless -log names
+another file; WavEventDump renders it.
 */
 
-int main()
+const unsigned BLOCK = 4096;
+
+int main( int argc, char* argv[] )
 {
+  const char* fir_channels = "";
+  unsigned taps = 255;
+  const char* log = "testWaveDecoder.evt";
+  for ( int j=1; j<argc; ++j ) {
+    if ( (strcmp( argv[j], "-fir" )==0) && (j+1<argc) ) fir_channels = argv[++j];
+    else if ( (strcmp( argv[j], "-taps" )==0) && (j+1<argc) ) taps = atoi( argv[++j] );
+    else if ( (strcmp( argv[j], "-log" )==0) && (j+1<argc) ) log = argv[++j];
+    else {
+      printf( "Usage: %s [-fir <channels 1-3>] [-taps N] [-log events]\n", argv[0] );
+      return 0;
+    }
+  }
+
   double fc1 = 100;  // Carrier
   double fc2 = 150;  // Clock
   double fc3 = 200;  // Data
@@ -40,6 +68,8 @@ int main()
   uint32_t transition_cycles = fs/fc1*5;
   
   printf( "Data cycles: %d  Transition cycles: %d\n", data_cycles, transition_cycles );
+  EventLog& events( EventLog::instance() );
+  if ( !events.open( log ) ) return 1;
   
   std::string message = "\0\0Hello World!\0";
   uint32_t msgpos = 0;
@@ -71,16 +101,28 @@ int main()
 			      });
  
   double bw  = (fc2-fc1)/2;
-  BandPassFilter bp1( fc1/fs, bw/fs, 4 );
-  BandPassFilter bp2( fc2/fs, bw/fs, 4 );
-  BandPassFilter bp3( fc3/fs, bw/fs, 4 );
-  
-  CordicQueueIntegrator it1slow( transition_cycles, fc1/fs );
-  CordicQueueIntegrator it2slow( transition_cycles, fc2/fs );
-  CordicQueueIntegrator it3slow( transition_cycles, fc3/fs );
+  BandPassFilterBank bank;
+  int bp1 = bank.add_channel( fc1/fs, bw/fs, 4 );
+  int bp2 = bank.add_channel( fc2/fs, bw/fs, 4 );
+  int bp3 = bank.add_channel( fc3/fs, bw/fs, 4 );
+  double fcs[3] = { fc1, fc2, fc3 };
+  FIRFilter* fir[3] = { NULL, NULL, NULL };
+  for ( int c=0; c<3; ++c ) {
+    if ( strchr( fir_channels, '1'+c )!=NULL ) {
+      fir[c] = new FIRFilter( fcs[c]/fs, bw/fs, taps );
+      printf( "Channel %d: FIR %u taps, delay %.1f samples\n", c+1, taps, fir[c]->delay() );
+    }
+  }
+  std::vector<double> signal( BLOCK ), data( BLOCK ), clk( BLOCK ), filtered[3];
+  for ( int c=0; c<3; ++c ) filtered[c].resize( BLOCK );
   
-  CordicQueueIntegrator it1fast( transition_cycles/2, fc1/fs );
-  CordicQueueIntegrator it2fast( transition_cycles/2, fc2/fs );
+  // Slow and fast windows on one mixer each
+  enum { SLOW, FAST };
+  std::vector<uint32_t> windows;
+  windows.push_back( transition_cycles );
+  windows.push_back( transition_cycles/2 );
+  MultiWindowIntegrator it1( windows, fc1/fs );
+  MultiWindowIntegrator it2( windows, fc2/fs );
     
   CordicIntegrator ic1( fc3 );
   CordicIntegrator ic3( fc3 );
@@ -91,28 +133,41 @@ int main()
   bool locked = false;
   
   double dt = 1/fs;
-  for ( unsigned j=0; j<1000*4*data_cycles; ++j ) 
+  uint32_t total = 1000*4*data_cycles;
+  for ( unsigned j=0; j<total; ++j ) 
   {
+    unsigned b = j % BLOCK;
+    if ( b==0 ) {
+      unsigned n = total-j < BLOCK ? total-j : BLOCK;
+      carrier.generate( &signal[0], n );
+      datawav.generate( &data[0], n );
+      clockwav.generate( &clk[0], n );
+      for ( unsigned k=0; k<n; ++k ) signal[k] = signal[k] + data[k] + clk[k];
+      for ( int c=0; c<3; ++c ) if ( fir[c]!=NULL ) fir[c]->process( &signal[0], &filtered[c][0], n );
+      for ( unsigned k=0; k<n; ++k ) {
+        bank.add( signal[k] );
+        if ( fir[0]==NULL ) filtered[0][k] = bank.value( bp1 );
+        if ( fir[1]==NULL ) filtered[1][k] = bank.value( bp2 );
+        if ( fir[2]==NULL ) filtered[2][k] = bank.value( bp3 );
+      }
+    }
     double t = j*dt;
-    double signal = carrier.step() + datawav.step() + clockwav.step();
-    double sig1 = bp1.add( signal );
-    double sig2 = bp2.add( signal );
-    double sig3 = bp3.add( signal );
-    it1slow.add( sig1 );
-    it2slow.add( sig2 );
-    it1fast.add( sig1 );
-    it2fast.add( sig2 );
+    double sig1 = filtered[0][b];
+    double sig2 = filtered[1][b];
+    double sig3 = filtered[2][b];
+    it1.add( sig1 );
+    it2.add( sig2 );
     ic3.add( sig3 );
     ic1.add( sig1 );
-    //printf( "Phase: %3.0f %3.0f   Level: %f %f \n", it1slow.phase()*180/M_PI, it2slow.phase()*180/M_PI, it1slow.level(), it2slow.level() );        
+    //printf( "Phase: %3.0f %3.0f   Level: %f %f \n", it1.phase( SLOW )*180/M_PI, it2.phase( SLOW )*180/M_PI, it1.level( SLOW ), it2.level( SLOW ) );        
   
     if ( j>transition_cycles ) {
-        double slow_lock = it2slow.level() + it1slow.level();
-        double fast_lock = it2fast.level() + it1fast.level();
+        double slow_lock = it2.level( SLOW ) + it1.level( SLOW );
+        double fast_lock = it2.level( FAST ) + it1.level( FAST );
         if ( !locked ) {
             if ( ( slow_lock>lock_high_threshold ) && (fast_lock >= slow_lock) ) { 
                     locked = true;
-                    printf( "LOCK-IN  Cycle: %3d  Phase: %3.0f %3.0f   Lock: %f %f\n", j , it1slow.phase()*180/M_PI, it2slow.phase()*180/M_PI, slow_lock, fast_lock );        
+                    events.log( EVENT_LOCK_IN, j, 0, it1.phase( SLOW )*180/M_PI, it2.phase( SLOW )*180/M_PI, slow_lock, fast_lock );
             }
         }
         else {
@@ -120,13 +175,13 @@ int main()
             // decide when it lost the lock
             if ( (slow_lock<lock_low_threshold) && (fast_lock<slow_lock) ) {
                 locked = false;
-                printf( "LOCK-OUT  Cycle: %3d  Phase: %3.0f %3.0f   Lock: %f %f\n", j , it1slow.phase()*180/M_PI, it2slow.phase()*180/M_PI, slow_lock, fast_lock );        
+                events.log( EVENT_LOCK_OUT, j, 0, it1.phase( SLOW )*180/M_PI, it2.phase( SLOW )*180/M_PI, slow_lock, fast_lock );
             }
         }
         
         if ( locked ) 
         {            
-            uint32_t ctid = map_constellation( it2slow.phase(), it1slow.phase(), 8 );        
+            uint32_t ctid = map_constellation( it2.phase( SLOW ), it1.phase( SLOW ), 8 );        
             uint32_t state = ( ctid >> 1 ) + 1;
             if ( (ctid&1)!=0 ) state = 0; 
             
@@ -135,15 +190,16 @@ int main()
                     uint32_t ctid = map_constellation( ic3.phase(), ic1.phase(), (1<<NBITS)*2 );
                     uint32_t symbol = ctid>>1;
                     if ( (ctid&1) == 0 ) { 
-                        printf( "    symbol: %d  %d  IC1: %f  %f  %f IC2: %f %f \n", symbol, state, ic1.phase()*180/M_PI, ic1.level(), it1fast.phase()*180/M_PI, ic3.phase()*180/M_PI, ic3.level() );
+                        events.log( EVENT_SYMBOL, symbol, state, ic1.phase()*180/M_PI, ic1.level(), it1.phase( FAST )*180/M_PI,
+                                    ic3.phase()*180/M_PI, ic3.level() );
                     }
                     else {
-                        printf( "    INVALID symbol: %d  %d  %f  %f\n", ctid, state, ic1.phase()*180/M_PI, ic3.phase()*180/M_PI );                        
+                        events.log( EVENT_INVALID_SYMBOL, ctid, state, ic1.phase()*180/M_PI, ic3.phase()*180/M_PI );
                     }
                 }
                 ic3.reset();
                 ic1.reset();
-                printf( "Clock transition: %d -> %d, cycle %d\n", last_state, state, j );
+                events.log( EVENT_TRANSITION, j, state, last_state );
                 last_state = state;
             }
         }
@@ -151,5 +207,6 @@ int main()
     
   }
 
+  for ( int c=0; c<3; ++c ) delete fir[c];
+  return events.close() ? 0 : 1;
 }
-
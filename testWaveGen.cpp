@@ -1,4 +1,4 @@
-#include "DCT.h"
+#include "Goertzel.h"
 #include "BandPassFilters.h"
 #include "LowPassFilters.h"
 #include "WaveGenerator.h"
@@ -33,8 +33,8 @@ int main()
   double Q = 1.0/sqrt(2.0);
   BiquadLowPassFilter bq( Q, 0.5*(fc1+fc2)/fs );
   BandPassFilter bp( (fc1+fc2)/fs, 1.5*(fc2-fc1)/fs, 4 );
-  DCTArray dct_bq( freqs );
-  DCTArray dct_bp( freqs );
+  GoertzelArray dct_bq( freqs );
+  GoertzelArray dct_bp( freqs );
   
   double dt = 1/fs;
   for ( unsigned j=0; j<100*4*data_cycles; ++j ) {